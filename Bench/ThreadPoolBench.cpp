@@ -0,0 +1,281 @@
+//compares the work stealing ThreadPool against the mutex/condition variable pool it replaced
+
+#include <iostream>
+#include <iomanip>
+#include <chrono>
+#include <cmath>
+#include <queue>
+#include <vector>
+#include <string>
+#include <functional>
+
+#include "../Engine/ThreadPool.hpp"
+
+//the previous ThreadPool's queue and workers, with a parallel_for on top so both pools can run the same loops
+class MutexThreadPool
+{
+	std::vector<std::thread> threads;
+
+	std::condition_variable condition;
+
+	//controlled by queue_mutex
+	std::queue<std::function<void()>> func_queue;
+
+	//controlled by queue_mutex
+	std::atomic_bool terminate_pool;
+
+	std::mutex queue_mutex;
+
+	void thread_func()
+	{
+		//the job we execute
+		std::function<void()> job_func;
+		while (true)
+		{
+			job_func = nullptr;
+			{
+				std::unique_lock<std::mutex> lock{ queue_mutex };
+
+				//wait for availablility of queue
+				condition.wait(lock, [this]() { return !func_queue.empty() || terminate_pool.load(); });
+
+				//if there are no more jobs to execute and we're told to quit, quit
+				if (func_queue.empty() && terminate_pool.load())
+				{
+					break;
+				}
+
+				//get from queue, and remove from queue
+				job_func = func_queue.front();
+				func_queue.pop();
+			}
+			//execute the job we got from the queue, if it exists
+			if (job_func != nullptr)
+			{
+				job_func();
+			}
+		}
+	}
+
+public:
+	MutexThreadPool()
+	{
+		//don't immediatly terminate all threads
+		terminate_pool.store(false);
+
+		//allocate threads, start them off, hardware_concurrency can be 0 if it's unknown
+		const size_t thread_count = std::max(1u, std::thread::hardware_concurrency()) - 1;
+		for (size_t i = 0; i < thread_count; i++)
+		{
+			threads.push_back(std::thread{ &MutexThreadPool::thread_func, this });
+		}
+	}
+
+	~MutexThreadPool()
+	{
+		//call for threads to finish once queue is empty
+		terminate_pool.store(true);
+
+		condition.notify_all();
+
+		//join all the threads
+		for (auto& thread : threads)
+		{
+			thread.join();
+		}
+	}
+
+	void add_work(const std::function<void()>& work)
+	{
+		{
+			std::unique_lock<std::mutex> lock(queue_mutex);
+			func_queue.push(work);
+		}
+		condition.notify_all();
+	}
+
+	size_t get_thread_count() const
+	{
+		return threads.size();
+	}
+
+	//calls func for every index in [0, count) on the pool and on the calling thread, returns once they're all done
+	void parallel_for(size_t count, const std::function<void(size_t)>& func)
+	{
+		struct Batch
+		{
+			std::atomic_size_t next{ 0 };
+			std::atomic_size_t done{ 0 };
+
+			std::mutex mutex;
+			std::condition_variable finished;
+		};
+
+		const auto batch = std::make_shared<Batch>();
+
+		const auto work = [batch, &func, count]()
+		{
+			size_t i;
+			while ((i = batch->next.fetch_add(1)) < count)
+			{
+				func(i);
+
+				if (batch->done.fetch_add(1) + 1 == count)
+				{
+					std::unique_lock<std::mutex> lock{ batch->mutex };
+					batch->finished.notify_all();
+				}
+			}
+		};
+
+		const size_t helpers = std::min(threads.size(), count > 0 ? count - 1 : 0);
+		for (size_t i = 0; i < helpers; i++)
+		{
+			add_work(work);
+		}
+
+		work();
+
+		std::unique_lock<std::mutex> lock{ batch->mutex };
+		batch->finished.wait(lock, [&batch, count]() { return batch->done.load() == count; });
+	}
+};
+
+constexpr size_t TINY_TASKS = 200000;
+constexpr size_t LOOP_SIZE = 1 << 20;
+constexpr int REPEATS = 5;
+
+//some arithmetic the compiler can't throw away
+static float work_item(size_t i)
+{
+	float x = static_cast<float>(i);
+	for (int j = 0; j < 16; j++)
+	{
+		x = std::sqrt(x * 1.0001f + 1.0f);
+	}
+
+	return x;
+}
+
+//best of a few runs in milliseconds
+template<typename F>
+static double time_best(const F& func)
+{
+	double best = 1e30;
+	for (int i = 0; i < REPEATS; i++)
+	{
+		const auto start = std::chrono::steady_clock::now();
+		func();
+		const auto end = std::chrono::steady_clock::now();
+
+		best = std::min(best, std::chrono::duration<double, std::milli>(end - start).count());
+	}
+
+	return best;
+}
+
+static void report(const std::string& name, double mutex_ms, double stealing_ms)
+{
+	std::cout << std::left << std::setw(28) << name << std::right << std::fixed << std::setprecision(2);
+
+	if (mutex_ms > 0.0)
+	{
+		std::cout << std::setw(12) << mutex_ms << " ms" << std::setw(12) << stealing_ms << " ms" << std::setw(10) << mutex_ms / stealing_ms << "x\n";
+	}
+	else
+	{
+		std::cout << std::setw(15) << "n/a" << std::setw(12) << stealing_ms << " ms\n";
+	}
+}
+
+int main()
+{
+	MutexThreadPool mutex_pool;
+	ThreadPool stealing_pool;
+
+	std::cout << "worker threads: " << stealing_pool.get_thread_count() << "\n\n";
+	std::cout << std::left << std::setw(28) << "benchmark"
+		<< std::right << std::setw(15) << "mutex pool" << std::setw(15) << "stealing pool" << std::setw(11) << "speedup" << "\n";
+
+	//lots of jobs that do nearly nothing, this is all scheduling overhead
+	{
+		std::atomic_size_t counter{ 0 };
+
+		//the old pool can't run jobs without workers, the caller has no way to help
+		const double mutex_ms = mutex_pool.get_thread_count() == 0 ? 0.0 : time_best([&mutex_pool, &counter]()
+			{
+				counter.store(0);
+				for (size_t i = 0; i < TINY_TASKS; i++)
+				{
+					mutex_pool.add_work([&counter]() { counter.fetch_add(1, std::memory_order_relaxed); });
+				}
+
+				while (counter.load() != TINY_TASKS)
+				{
+					std::this_thread::yield();
+				}
+			});
+
+		const double stealing_ms = time_best([&stealing_pool, &counter]()
+			{
+				counter.store(0);
+
+				TaskGroup group{ stealing_pool };
+				for (size_t i = 0; i < TINY_TASKS; i++)
+				{
+					std::atomic_size_t* count = &counter;
+					group.run([count]() { count->fetch_add(1, std::memory_order_relaxed); });
+				}
+				group.wait();
+			});
+
+		report("tiny tasks", mutex_ms, stealing_ms);
+	}
+
+	//a loop where every index is a job of its own in the old pool
+	{
+		std::vector<float> results(LOOP_SIZE);
+
+		const double mutex_ms = time_best([&mutex_pool, &results]()
+			{
+				mutex_pool.parallel_for(results.size(), [&results](size_t i) { results[i] = work_item(i); });
+			});
+
+		const double stealing_ms = time_best([&stealing_pool, &results]()
+			{
+				stealing_pool.parallel_for(results.size(), [&results](size_t i) { results[i] = work_item(i); });
+			});
+
+		report("parallel_for", mutex_ms, stealing_ms);
+	}
+
+	//jobs spawning jobs, only the stealing pool can wait on them without blocking a worker
+	{
+		std::vector<float> results(LOOP_SIZE);
+
+		const double serial_ms = time_best([&results]()
+			{
+				for (size_t i = 0; i < results.size(); i++)
+				{
+					results[i] = work_item(i);
+				}
+			});
+
+		const double stealing_ms = time_best([&stealing_pool, &results]()
+			{
+				constexpr size_t OUTER = 64;
+				stealing_pool.parallel_for(OUTER, [&stealing_pool, &results](size_t outer)
+					{
+						const size_t begin = results.size() / OUTER * outer;
+						stealing_pool.parallel_for(results.size() / OUTER, [&results, begin](size_t i) { results[begin + i] = work_item(begin + i); });
+					});
+			});
+
+		//the mutex pool has no nested version to compare against, so the baseline is a plain loop
+		report("nested parallel_for", 0.0, stealing_ms);
+
+		std::cout << "\nnested parallel_for against a serial loop of " << serial_ms << " ms: " << serial_ms / stealing_ms << "x\n";
+	}
+
+	return 0;
+}
@@ -0,0 +1,552 @@
+#include "MapFile.hpp"
+
+#include <stdexcept>
+#include <fstream>
+#include <sstream>
+#include <iomanip>
+#include <charconv>
+#include <cstring>
+#include <cstdio>
+
+#ifdef _WIN32
+#define WIN32_LEAN_AND_MEAN
+#define NOMINMAX
+#include <windows.h>
+#else
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#endif
+
+constexpr char MAP_FILE_MAGIC[4] = { 'S', 'E', 'C', 'B' };
+
+static uint64_t align_table(uint64_t offset)
+{
+	return (offset + 7) & ~static_cast<uint64_t>(7);
+}
+
+void MapData::add_texture(std::string_view name)
+{
+	textures.push_back(MapTextureRecord{ static_cast<uint32_t>(strings.size()), static_cast<uint32_t>(name.size()) });
+	strings.append(name);
+}
+
+MapView MapData::view() const
+{
+	MapView map;
+
+	map.vertices = vertices.data();
+	map.vertex_count = static_cast<uint32_t>(vertices.size());
+
+	map.sectors = sectors.data();
+	map.sector_count = static_cast<uint32_t>(sectors.size());
+
+	map.indices = indices.data();
+	map.neighbors = neighbors.data();
+	map.index_count = static_cast<uint32_t>(indices.size());
+
+	map.textures = textures.data();
+	map.texture_count = static_cast<uint32_t>(textures.size());
+	map.strings = strings.data();
+
+	map.has_player = has_player;
+	map.player_pos = player_pos;
+
+	return map;
+}
+
+MappedMap::MappedMap(const char* filename)
+{
+#ifdef _WIN32
+	file_handle = CreateFileA(filename, GENERIC_READ, FILE_SHARE_READ, nullptr, OPEN_EXISTING, FILE_ATTRIBUTE_NORMAL, nullptr);
+	if (INVALID_HANDLE_VALUE == file_handle)
+	{
+		file_handle = nullptr;
+		throw std::runtime_error("Failed to open map file");
+	}
+
+	LARGE_INTEGER file_size;
+	GetFileSizeEx(file_handle, &file_size);
+	size = static_cast<size_t>(file_size.QuadPart);
+
+	mapping_handle = CreateFileMappingA(file_handle, nullptr, PAGE_READONLY, 0, 0, nullptr);
+	if (nullptr == mapping_handle)
+	{
+		unmap();
+		throw std::runtime_error("Failed to map map file");
+	}
+
+	data = static_cast<const unsigned char*>(MapViewOfFile(mapping_handle, FILE_MAP_READ, 0, 0, 0));
+	if (nullptr == data)
+	{
+		unmap();
+		throw std::runtime_error("Failed to map map file");
+	}
+#else
+	const int fd = open(filename, O_RDONLY);
+	if (fd < 0)
+	{
+		throw std::runtime_error("Failed to open map file");
+	}
+
+	struct stat file_stat;
+	if (fstat(fd, &file_stat) != 0)
+	{
+		close(fd);
+		throw std::runtime_error("Failed to read map file size");
+	}
+	size = static_cast<size_t>(file_stat.st_size);
+
+	void* mapping = size ? mmap(nullptr, size, PROT_READ, MAP_PRIVATE, fd, 0) : MAP_FAILED;
+
+	//the mapping keeps the file alive on its own
+	close(fd);
+
+	if (MAP_FAILED == mapping)
+	{
+		throw std::runtime_error("Failed to map map file");
+	}
+
+	data = static_cast<const unsigned char*>(mapping);
+#endif
+
+	try
+	{
+		validate();
+	}
+	catch (...)
+	{
+		unmap();
+		throw;
+	}
+}
+
+MappedMap::~MappedMap()
+{
+	unmap();
+}
+
+MappedMap::MappedMap(MappedMap&& o) noexcept
+	: data(o.data), size(o.size),
+#ifdef _WIN32
+	file_handle(o.file_handle), mapping_handle(o.mapping_handle),
+#endif
+	map_view(o.map_view)
+{
+	o.data = nullptr;
+	o.size = 0;
+#ifdef _WIN32
+	o.file_handle = nullptr;
+	o.mapping_handle = nullptr;
+#endif
+}
+
+MappedMap& MappedMap::operator=(MappedMap&& o) noexcept
+{
+	if (&o == this)
+	{
+		return *this;
+	}
+
+	unmap();
+
+	data = o.data;
+	size = o.size;
+#ifdef _WIN32
+	file_handle = o.file_handle;
+	mapping_handle = o.mapping_handle;
+	o.file_handle = nullptr;
+	o.mapping_handle = nullptr;
+#endif
+	map_view = o.map_view;
+
+	o.data = nullptr;
+	o.size = 0;
+
+	return *this;
+}
+
+void MappedMap::unmap() noexcept
+{
+#ifdef _WIN32
+	if (data)
+	{
+		UnmapViewOfFile(data);
+	}
+	if (mapping_handle)
+	{
+		CloseHandle(mapping_handle);
+	}
+	if (file_handle)
+	{
+		CloseHandle(file_handle);
+	}
+	mapping_handle = nullptr;
+	file_handle = nullptr;
+#else
+	if (data)
+	{
+		munmap(const_cast<unsigned char*>(data), size);
+	}
+#endif
+	data = nullptr;
+	size = 0;
+}
+
+void MappedMap::validate()
+{
+	if (size < sizeof(MapHeader))
+	{
+		throw std::runtime_error("Map file is too small to be a binary map");
+	}
+
+	MapHeader header;
+	memcpy(&header, data, sizeof(MapHeader));
+
+	if (memcmp(header.magic, MAP_FILE_MAGIC, sizeof(MAP_FILE_MAGIC)) != 0)
+	{
+		throw std::runtime_error("Map file is not a binary map");
+	}
+
+	if (header.version != MAP_FILE_VERSION)
+	{
+		throw std::runtime_error("Binary map version " + std::to_string(header.version) + " is not supported");
+	}
+
+	//make sure every table lies inside the file before handing out pointers to it
+	const auto table = [this](uint64_t offset, uint64_t count, uint64_t element_size)
+	{
+		if ((offset & 7) != 0 || offset > size || count > (size - offset) / element_size)
+		{
+			throw std::runtime_error("Binary map table is out of bounds");
+		}
+
+		return data + offset;
+	};
+
+	map_view.vertices = reinterpret_cast<const glm::vec2*>(table(header.vertex_offset, header.vertex_count, sizeof(glm::vec2)));
+	map_view.vertex_count = header.vertex_count;
+
+	map_view.sectors = reinterpret_cast<const MapSectorRecord*>(table(header.sector_offset, header.sector_count, sizeof(MapSectorRecord)));
+	map_view.sector_count = header.sector_count;
+
+	map_view.indices = reinterpret_cast<const uint32_t*>(table(header.index_offset, header.index_count, sizeof(uint32_t)));
+	map_view.neighbors = reinterpret_cast<const int32_t*>(table(header.neighbor_offset, header.index_count, sizeof(int32_t)));
+	map_view.index_count = header.index_count;
+
+	map_view.textures = reinterpret_cast<const MapTextureRecord*>(table(header.texture_offset, header.texture_count, sizeof(MapTextureRecord)));
+	map_view.texture_count = header.texture_count;
+	map_view.strings = reinterpret_cast<const char*>(table(header.string_offset, header.string_size, 1));
+
+	map_view.has_player = (header.flags & 1) != 0;
+	map_view.player_pos = glm::vec2{ header.player_x, header.player_y };
+
+	//the tables are trusted after this, so check every cross reference once
+	for (uint32_t i = 0; i < map_view.sector_count; i++)
+	{
+		const auto& sector = map_view.sectors[i];
+
+		if (sector.count < 3 || sector.first > map_view.index_count || sector.count > map_view.index_count - sector.first)
+		{
+			throw std::runtime_error("Binary map sector " + std::to_string(i) + " has an invalid vertex range");
+		}
+	}
+
+	for (uint32_t i = 0; i < map_view.index_count; i++)
+	{
+		if (map_view.indices[i] >= map_view.vertex_count)
+		{
+			throw std::runtime_error("Binary map vertex index is out of range");
+		}
+
+		if (map_view.neighbors[i] >= static_cast<int64_t>(map_view.sector_count))
+		{
+			throw std::runtime_error("Binary map neighbor is out of range");
+		}
+	}
+
+	for (uint32_t i = 0; i < map_view.texture_count; i++)
+	{
+		const auto& texture = map_view.textures[i];
+
+		if (texture.offset > header.string_size || texture.length > header.string_size - texture.offset)
+		{
+			throw std::runtime_error("Binary map texture name is out of range");
+		}
+	}
+}
+
+MapData read_text_map(const char* filename)
+{
+	std::ifstream map_file{ filename };
+	if (!map_file.is_open())
+	{
+		throw std::runtime_error("Failed to open map file");
+	}
+
+	MapData map;
+
+	//read file line by line and process
+	std::string line;
+	while (std::getline(map_file, line))
+	{
+		std::stringstream line_stream{ line };
+
+		std::string prefix_identifier;
+		line_stream >> prefix_identifier;
+
+		if (prefix_identifier.compare("vertex") == 0)
+		{
+			glm::vec2 vec{ 0.0f, 0.0f };
+
+			line_stream >> vec.x;
+
+			while (line_stream >> vec.y)
+			{
+				map.vertices.push_back(vec);
+			}
+		}
+		else if (prefix_identifier.compare("player") == 0)
+		{
+			line_stream >> map.player_pos.x >> map.player_pos.y;
+
+			map.has_player = true;
+		}
+		else if (prefix_identifier.compare("sector") == 0)
+		{
+			MapSectorRecord sector;
+
+			//get height
+			line_stream >> sector.floor >> sector.ceil;
+
+			//get material types
+			line_stream >> sector.wall_type >> sector.ceil_type >> sector.floor_type;
+
+			std::vector<int64_t> integers;
+			{
+				int64_t get_integer;
+				while (line_stream >> get_integer)
+				{
+					integers.push_back(get_integer);
+				}
+			}
+
+			if (integers.size() < 6)
+			{
+				throw std::logic_error("Sector size must have at least 3 vertices & neighbors");
+			}
+
+			const size_t size = integers.size() / 2;
+
+			sector.first = static_cast<uint32_t>(map.indices.size());
+			sector.count = static_cast<uint32_t>(size);
+
+			for (size_t i = 0; i < size; i++)
+			{
+				if (integers[i] < 0 || static_cast<size_t>(integers[i]) >= map.vertices.size())
+				{
+					throw std::logic_error("Sector references a vertex that has not been declared");
+				}
+
+				map.indices.push_back(static_cast<uint32_t>(integers[i]));
+				map.neighbors.push_back(static_cast<int32_t>(integers[i + size]));
+			}
+
+			map.sectors.push_back(sector);
+		}
+		else if (prefix_identifier.compare("texture") == 0)
+		{
+			std::string texture_name;
+			line_stream >> std::quoted(texture_name);
+
+			map.add_texture(texture_name);
+		}
+	}
+
+	return map;
+}
+
+std::string format_text_map(const MapData& map)
+{
+	std::string text;
+
+	//a guess that's enough for most maps, so the string rarely grows
+	text.reserve(64 + map.textures.size() * 32 + map.vertices.size() * 24 + map.sectors.size() * 48 + map.indices.size() * 12);
+
+	const auto append_number = [&text](auto value)
+	{
+		char buffer[32];
+
+		const auto result = std::to_chars(buffer, buffer + sizeof(buffer), value);
+		text.append(buffer, result.ptr);
+	};
+
+	const MapView view = map.view();
+
+	for (size_t i = 0; i < map.textures.size(); i++)
+	{
+		text += "texture \"";
+
+		//the reader uses std::quoted, so quotes and backslashes in names are escaped
+		for (const char c : view.texture(i))
+		{
+			if (c == '"' || c == '\\')
+			{
+				text += '\\';
+			}
+
+			text += c;
+		}
+
+		text += "\"\n";
+	}
+
+	for (const auto& vertex : map.vertices)
+	{
+		text += "vertex ";
+		append_number(vertex.x);
+		text += ' ';
+		append_number(vertex.y);
+		text += '\n';
+	}
+
+	for (const auto& sector : map.sectors)
+	{
+		text += "sector ";
+		append_number(sector.floor);
+		text += ' ';
+		append_number(sector.ceil);
+		text += ' ';
+		append_number(sector.wall_type);
+		text += ' ';
+		append_number(sector.ceil_type);
+		text += ' ';
+		append_number(sector.floor_type);
+
+		for (uint32_t i = sector.first; i < sector.first + sector.count; i++)
+		{
+			text += ' ';
+			append_number(map.indices[i]);
+		}
+
+		for (uint32_t i = sector.first; i < sector.first + sector.count; i++)
+		{
+			text += ' ';
+			append_number(map.neighbors[i]);
+		}
+
+		text += '\n';
+	}
+
+	if (map.has_player)
+	{
+		text += "player ";
+		append_number(map.player_pos.x);
+		text += ' ';
+		append_number(map.player_pos.y);
+		text += '\n';
+	}
+
+	return text;
+}
+
+std::vector<unsigned char> serialize_binary_map(const MapData& map)
+{
+	if (map.indices.size() != map.neighbors.size())
+	{
+		throw std::logic_error("Every sector vertex needs a neighbor");
+	}
+
+	MapHeader header{};
+	memcpy(header.magic, MAP_FILE_MAGIC, sizeof(MAP_FILE_MAGIC));
+	header.version = MAP_FILE_VERSION;
+
+	header.vertex_count = static_cast<uint32_t>(map.vertices.size());
+	header.sector_count = static_cast<uint32_t>(map.sectors.size());
+	header.index_count = static_cast<uint32_t>(map.indices.size());
+	header.texture_count = static_cast<uint32_t>(map.textures.size());
+	header.string_size = static_cast<uint32_t>(map.strings.size());
+
+	header.flags = map.has_player ? 1 : 0;
+	header.player_x = map.player_pos.x;
+	header.player_y = map.player_pos.y;
+
+	//lay out the tables one after another
+	header.vertex_offset = align_table(sizeof(MapHeader));
+	header.sector_offset = align_table(header.vertex_offset + map.vertices.size() * sizeof(glm::vec2));
+	header.index_offset = align_table(header.sector_offset + map.sectors.size() * sizeof(MapSectorRecord));
+	header.neighbor_offset = align_table(header.index_offset + map.indices.size() * sizeof(uint32_t));
+	header.texture_offset = align_table(header.neighbor_offset + map.neighbors.size() * sizeof(int32_t));
+	header.string_offset = align_table(header.texture_offset + map.textures.size() * sizeof(MapTextureRecord));
+
+	//zero filled, so the padding between tables is already there
+	std::vector<unsigned char> data(header.string_offset + map.strings.size(), 0);
+
+	const auto write_table = [&data](uint64_t offset, const void* table, size_t table_size)
+	{
+		if (table_size > 0)
+		{
+			memcpy(data.data() + offset, table, table_size);
+		}
+	};
+
+	write_table(0, &header, sizeof(MapHeader));
+	write_table(header.vertex_offset, map.vertices.data(), map.vertices.size() * sizeof(glm::vec2));
+	write_table(header.sector_offset, map.sectors.data(), map.sectors.size() * sizeof(MapSectorRecord));
+	write_table(header.index_offset, map.indices.data(), map.indices.size() * sizeof(uint32_t));
+	write_table(header.neighbor_offset, map.neighbors.data(), map.neighbors.size() * sizeof(int32_t));
+	write_table(header.texture_offset, map.textures.data(), map.textures.size() * sizeof(MapTextureRecord));
+	write_table(header.string_offset, map.strings.data(), map.strings.size());
+
+	return data;
+}
+
+void write_text_map(const char* filename, const MapData& map)
+{
+	const auto text = format_text_map(map);
+
+	write_file_atomic(filename, text.data(), text.size());
+}
+
+void write_binary_map(const char* filename, const MapData& map)
+{
+	const auto data = serialize_binary_map(map);
+
+	write_file_atomic(filename, data.data(), data.size());
+}
+
+void write_file_atomic(const char* filename, const void* data, size_t size)
+{
+	const std::string temp_filename = std::string{ filename } + ".tmp";
+
+	{
+		std::ofstream file{ temp_filename, std::ios::binary | std::ios::trunc };
+		if (!file.is_open())
+		{
+			throw std::runtime_error("Failed to open map file for writing");
+		}
+
+		file.write(static_cast<const char*>(data), static_cast<std::streamsize>(size));
+		file.close();
+
+		if (!file)
+		{
+			std::remove(temp_filename.c_str());
+			throw std::runtime_error("Failed to write map file");
+		}
+	}
+
+#ifdef _WIN32
+	//rename doesn't replace existing files on windows
+	const bool renamed = MoveFileExA(temp_filename.c_str(), filename, MOVEFILE_REPLACE_EXISTING | MOVEFILE_WRITE_THROUGH) != 0;
+#else
+	const bool renamed = std::rename(temp_filename.c_str(), filename) == 0;
+#endif
+
+	if (!renamed)
+	{
+		std::remove(temp_filename.c_str());
+		throw std::runtime_error("Failed to replace map file");
+	}
+}
@@ -0,0 +1,145 @@
+#ifndef MAP_FILE_COMMON_HPP
+#define MAP_FILE_COMMON_HPP
+
+#include <cstdint>
+#include <cstddef>
+#include <vector>
+#include <string>
+#include <string_view>
+
+#include <glm/glm.hpp>
+
+//binary map layout (all tables are 8 byte aligned, native endianness):
+//MapHeader | vertices | sectors | vertex indices | neighbors | textures | texture strings
+//every sector owns the range [first, first + count) of both the index and the neighbor table
+
+constexpr uint32_t MAP_FILE_VERSION = 1;
+
+struct MapHeader
+{
+	char magic[4];
+	uint32_t version;
+
+	uint32_t vertex_count, sector_count, index_count, texture_count;
+	uint32_t string_size;
+
+	//bit 0 is set when the map has a player start
+	uint32_t flags;
+	float player_x, player_y;
+
+	uint64_t vertex_offset, sector_offset, index_offset, neighbor_offset, texture_offset, string_offset;
+};
+
+struct MapSectorRecord
+{
+	float floor, ceil;
+
+	uint32_t wall_type, ceil_type, floor_type;
+
+	uint32_t first, count;
+};
+
+struct MapTextureRecord
+{
+	uint32_t offset, length;
+};
+
+static_assert(sizeof(glm::vec2) == 2 * sizeof(float), "glm::vec2 must be tightly packed to be read from a map file");
+
+//non-owning view over map tables, either inside a mapped file or a MapData
+struct MapView
+{
+	const glm::vec2* vertices = nullptr;
+	uint32_t vertex_count = 0;
+
+	const MapSectorRecord* sectors = nullptr;
+	uint32_t sector_count = 0;
+
+	const uint32_t* indices = nullptr;
+	const int32_t* neighbors = nullptr;
+	uint32_t index_count = 0;
+
+	const MapTextureRecord* textures = nullptr;
+	uint32_t texture_count = 0;
+	const char* strings = nullptr;
+
+	bool has_player = false;
+	glm::vec2 player_pos{ 0.0f, 0.0f };
+
+	std::string_view texture(size_t i) const
+	{
+		return std::string_view{ strings + textures[i].offset, textures[i].length };
+	}
+};
+
+//owning map tables, used when parsing text maps and when writing binary maps
+struct MapData
+{
+	std::vector<glm::vec2> vertices;
+	std::vector<MapSectorRecord> sectors;
+	std::vector<uint32_t> indices;
+	std::vector<int32_t> neighbors;
+	std::vector<MapTextureRecord> textures;
+	std::string strings;
+
+	bool has_player = false;
+	glm::vec2 player_pos{ 0.0f, 0.0f };
+
+	void add_texture(std::string_view name);
+
+	MapView view() const;
+};
+
+//read-only memory mapping of a binary map file, validated on open
+class MappedMap
+{
+	const unsigned char* data = nullptr;
+	size_t size = 0;
+
+#ifdef _WIN32
+	void* file_handle = nullptr;
+	void* mapping_handle = nullptr;
+#endif
+
+	MapView map_view;
+
+	void validate();
+
+	void unmap() noexcept;
+
+public:
+	explicit MappedMap(const char* filename);
+
+	~MappedMap();
+
+	explicit MappedMap(MappedMap&& o) noexcept;
+
+	MappedMap& operator=(MappedMap&& o) noexcept;
+
+	explicit MappedMap(MappedMap&) = delete;
+
+	MappedMap& operator=(MappedMap&) = delete;
+
+	const MapView& view() const
+	{
+		return map_view;
+	}
+};
+
+//parse the line based text format (map.sec)
+MapData read_text_map(const char* filename);
+
+//the text format with every vertex on its own line before the sectors, numbers are formatted with to_chars so floats round trip exactly
+std::string format_text_map(const MapData& map);
+
+std::vector<unsigned char> serialize_binary_map(const MapData& map);
+
+//both write through write_file_atomic
+void write_text_map(const char* filename, const MapData& map);
+
+void write_binary_map(const char* filename, const MapData& map);
+
+//writes a temporary file next to filename and renames it over the old one, so a failed write never leaves half a map behind
+void write_file_atomic(const char* filename, const void* data, size_t size);
+
+#endif
@@ -0,0 +1,174 @@
+#include "StreamBuffer.hpp"
+
+#include <stdexcept>
+#include <algorithm>
+
+StreamBuffer::StreamBuffer(size_t bytes_per_frame)
+{
+	create(std::max<size_t>(bytes_per_frame, 256));
+}
+
+void StreamBuffer::create(size_t new_region_size)
+{
+	const GLbitfield map_flags = GL_MAP_WRITE_BIT | GL_MAP_PERSISTENT_BIT | GL_MAP_COHERENT_BIT;
+
+	region_size = new_region_size;
+
+	glCreateBuffers(1, &buffer);
+	glNamedBufferStorage(buffer, static_cast<GLsizeiptr>(region_size * FRAMES), nullptr, map_flags);
+	mapped = static_cast<unsigned char*>(glMapNamedBufferRange(buffer, 0, static_cast<GLsizeiptr>(region_size * FRAMES), map_flags));
+
+	if (nullptr == mapped)
+	{
+		throw std::runtime_error("Failed to map stream buffer");
+	}
+}
+
+void StreamBuffer::release()
+{
+	for (auto& fence : fences)
+	{
+		if (fence)
+		{
+			glDeleteSync(fence);
+			fence = nullptr;
+		}
+	}
+
+	if (buffer)
+	{
+		glUnmapNamedBuffer(buffer);
+		glDeleteBuffers(1, &buffer);
+	}
+
+	if (!retired_buffers.empty())
+	{
+		glDeleteBuffers(static_cast<GLsizei>(retired_buffers.size()), retired_buffers.data());
+		retired_buffers.clear();
+	}
+
+	buffer = 0;
+	mapped = nullptr;
+	region_size = 0;
+	region = 0;
+	offset = 0;
+}
+
+StreamBuffer::~StreamBuffer()
+{
+	release();
+}
+
+StreamBuffer::StreamBuffer(StreamBuffer&& o) noexcept
+	: buffer(o.buffer), mapped(o.mapped), region_size(o.region_size), region(o.region), offset(o.offset), fences(o.fences),
+	retired_buffers(std::move(o.retired_buffers))
+{
+	o.buffer = 0;
+	o.mapped = nullptr;
+	o.region_size = 0;
+	o.fences = {};
+}
+
+StreamBuffer& StreamBuffer::operator=(StreamBuffer&& o) noexcept
+{
+	if (&o == this)
+	{
+		return *this;
+	}
+
+	release();
+
+	buffer = o.buffer;
+	mapped = o.mapped;
+	region_size = o.region_size;
+	region = o.region;
+	offset = o.offset;
+	fences = o.fences;
+	retired_buffers = std::move(o.retired_buffers);
+
+	o.buffer = 0;
+	o.mapped = nullptr;
+	o.region_size = 0;
+	o.fences = {};
+
+	return *this;
+}
+
+void StreamBuffer::next_frame()
+{
+	if (!buffer)
+	{
+		throw std::runtime_error("Tried to use an empty StreamBuffer");
+	}
+
+	//the draws that used them are already submitted, gl frees them once they're done
+	if (!retired_buffers.empty())
+	{
+		glDeleteBuffers(static_cast<GLsizei>(retired_buffers.size()), retired_buffers.data());
+		retired_buffers.clear();
+	}
+
+	if (fences[region])
+	{
+		glDeleteSync(fences[region]);
+	}
+	fences[region] = glFenceSync(GL_SYNC_GPU_COMMANDS_COMPLETE, 0);
+
+	region = (region + 1) % FRAMES;
+	offset = 0;
+
+	GLsync& fence = fences[region];
+	if (fence)
+	{
+		GLenum status;
+		do
+		{
+			status = glClientWaitSync(fence, GL_SYNC_FLUSH_COMMANDS_BIT, 1000000000);
+		} while (status == GL_TIMEOUT_EXPIRED);
+
+		if (status == GL_WAIT_FAILED)
+		{
+			throw std::runtime_error("Failed to wait on stream buffer");
+		}
+
+		glDeleteSync(fence);
+		fence = nullptr;
+	}
+}
+
+StreamBuffer::Allocation StreamBuffer::allocate(size_t size, size_t alignment)
+{
+	if (!buffer)
+	{
+		throw std::runtime_error("Tried to use an empty StreamBuffer");
+	}
+
+	size_t start = (offset + alignment - 1) / alignment * alignment;
+
+	if (start + size > region_size)
+	{
+		//a new ring has no fences, so this frame starts over in its first region
+		glUnmapNamedBuffer(buffer);
+		retired_buffers.push_back(buffer);
+
+		for (auto& fence : fences)
+		{
+			if (fence)
+			{
+				glDeleteSync(fence);
+				fence = nullptr;
+			}
+		}
+
+		create(std::max(region_size * 2, size + alignment));
+
+		region = 0;
+		start = 0;
+	}
+
+	offset = start + size;
+
+	const size_t buffer_offset = region * region_size + start;
+
+	return Allocation{ mapped + buffer_offset, buffer, static_cast<GLintptr>(buffer_offset) };
+}
@@ -0,0 +1,87 @@
+#ifndef STREAM_BUFFER_COMMON_HPP
+#define STREAM_BUFFER_COMMON_HPP
+
+#include <array>
+#include <vector>
+#include <cstdint>
+#include <cstddef>
+#include <cstring>
+
+#include <glad/glad.h>
+
+//persistently mapped ring for data that's written every frame, needs GL 4.4 or ARB_buffer_storage
+//the buffer is split into one region per frame in flight and each region is fenced when the frame is done with it,
+//so writing is a pointer bump and only waits when the gpu is more than FRAMES frames behind
+class StreamBuffer
+{
+public:
+	static constexpr size_t FRAMES = 3;
+
+	struct Allocation
+	{
+		//write here, it's coherent so there's nothing to flush
+		unsigned char* data;
+
+		//bind buffer at offset to use it, the buffer changes when the ring grows
+		GLuint buffer;
+		GLintptr offset;
+	};
+
+private:
+	GLuint buffer = 0;
+	unsigned char* mapped = nullptr;
+
+	size_t region_size = 0;
+	size_t region = 0;
+	size_t offset = 0;
+
+	std::array<GLsync, FRAMES> fences{};
+
+	//replaced by a bigger ring this frame, deleted at the next frame once nothing can be drawing from them anymore
+	std::vector<GLuint> retired_buffers;
+
+	void create(size_t new_region_size);
+
+	void release();
+
+public:
+	explicit StreamBuffer(size_t bytes_per_frame);
+
+	explicit StreamBuffer() noexcept = default;
+
+	~StreamBuffer();
+
+	explicit StreamBuffer(StreamBuffer&& o) noexcept;
+
+	StreamBuffer& operator=(StreamBuffer&& o) noexcept;
+
+	explicit StreamBuffer(StreamBuffer&) = delete;
+
+	StreamBuffer& operator=(StreamBuffer&) = delete;
+
+	bool is_created() const
+	{
+		return buffer != 0;
+	}
+
+	//fences what was written since the last call and moves on to the next region, call once a frame before writing
+	void next_frame();
+
+	//space for size bytes in this frame's region, a frame that needs more than a region grows the ring
+	Allocation allocate(size_t size, size_t alignment = 4);
+
+	template<typename T>
+	Allocation write(const T* data, size_t count)
+	{
+		const Allocation allocation = allocate(sizeof(T) * count, alignof(T) < 4 ? 4 : alignof(T));
+
+		if (count > 0)
+		{
+			std::memcpy(allocation.data, data, sizeof(T) * count);
+		}
+
+		return allocation;
+	}
+};
+
+#endif
@@ -0,0 +1,170 @@
+#include "TextureCache.hpp"
+
+#include <stdexcept>
+#include <fstream>
+#include <cstring>
+
+constexpr char TEXTURE_CACHE_MAGIC[4] = { 'S', 'E', 'C', 'T' };
+
+static uint64_t align_data(uint64_t offset)
+{
+	return (offset + 7) & ~static_cast<uint64_t>(7);
+}
+
+size_t TextureCache::layer_size(uint32_t level) const
+{
+	const size_t blocks_x = (texture_level_extent(width, level) + 3) / 4;
+	const size_t blocks_y = (texture_level_extent(height, level) + 3) / 4;
+
+	return blocks_x * blocks_y * texture_block_size(format);
+}
+
+size_t TextureCache::level_offset(uint32_t level) const
+{
+	size_t offset = 0;
+	for (uint32_t i = 0; i < level; i++)
+	{
+		offset += level_size(i);
+	}
+
+	return offset;
+}
+
+void TextureCache::allocate()
+{
+	data.assign(level_offset(level_count), 0);
+}
+
+bool TextureCache::matches(const std::vector<std::string>& texture_names, uint32_t texture_width, uint32_t texture_height) const
+{
+	return names == texture_names && width == texture_width && height == texture_height;
+}
+
+TextureCache read_texture_cache(const char* filename)
+{
+	std::ifstream file{ filename, std::ios::binary };
+	if (!file.is_open())
+	{
+		throw std::runtime_error("Failed to open texture cache");
+	}
+
+	TextureCacheHeader header;
+	if (!file.read(reinterpret_cast<char*>(&header), sizeof(header)))
+	{
+		throw std::runtime_error("Texture cache is too small");
+	}
+
+	if (memcmp(header.magic, TEXTURE_CACHE_MAGIC, sizeof(TEXTURE_CACHE_MAGIC)) != 0)
+	{
+		throw std::runtime_error("File is not a texture cache");
+	}
+
+	if (header.version != TEXTURE_CACHE_VERSION)
+	{
+		throw std::runtime_error("Texture cache version " + std::to_string(header.version) + " is not supported");
+	}
+
+	if (header.format != static_cast<uint32_t>(TextureCacheFormat::BC1) && header.format != static_cast<uint32_t>(TextureCacheFormat::BC7))
+	{
+		throw std::runtime_error("Texture cache has an unknown block format");
+	}
+
+	if (header.width == 0 || header.height == 0 || header.level_count == 0 || header.level_count > full_level_count(header.width, header.height))
+	{
+		throw std::runtime_error("Texture cache has an invalid size");
+	}
+
+	TextureCache cache;
+	cache.format = static_cast<TextureCacheFormat>(header.format);
+	cache.width = header.width;
+	cache.height = header.height;
+	cache.layer_count = header.layer_count;
+	cache.level_count = header.level_count;
+
+	std::vector<TextureNameRecord> records(header.layer_count);
+	std::string strings(header.string_size, '\0');
+
+	file.read(reinterpret_cast<char*>(records.data()), static_cast<std::streamsize>(records.size() * sizeof(TextureNameRecord)));
+	file.read(strings.data(), static_cast<std::streamsize>(strings.size()));
+
+	if (!file)
+	{
+		throw std::runtime_error("Texture cache is truncated");
+	}
+
+	for (const auto& record : records)
+	{
+		if (static_cast<uint64_t>(record.offset) + record.length > strings.size())
+		{
+			throw std::runtime_error("Texture cache name is out of bounds");
+		}
+
+		cache.names.push_back(strings.substr(record.offset, record.length));
+	}
+
+	cache.allocate();
+
+	if (header.data_size != cache.data.size())
+	{
+		throw std::runtime_error("Texture cache data doesn't match its size");
+	}
+
+	file.seekg(static_cast<std::streamoff>(header.data_offset));
+	if (!file.read(reinterpret_cast<char*>(cache.data.data()), static_cast<std::streamsize>(cache.data.size())))
+	{
+		throw std::runtime_error("Texture cache is truncated");
+	}
+
+	return cache;
+}
+
+void write_texture_cache(const char* filename, const TextureCache& cache)
+{
+	if (cache.names.size() != cache.layer_count || cache.data.size() != cache.level_offset(cache.level_count))
+	{
+		throw std::logic_error("Texture cache needs a name for every layer and data for every level");
+	}
+
+	std::vector<TextureNameRecord> records;
+	std::string strings;
+	for (const auto& name : cache.names)
+	{
+		records.push_back(TextureNameRecord{ static_cast<uint32_t>(strings.size()), static_cast<uint32_t>(name.size()) });
+		strings.append(name);
+	}
+
+	TextureCacheHeader header{};
+	memcpy(header.magic, TEXTURE_CACHE_MAGIC, sizeof(TEXTURE_CACHE_MAGIC));
+	header.version = TEXTURE_CACHE_VERSION;
+
+	header.format = static_cast<uint32_t>(cache.format);
+	header.width = cache.width;
+	header.height = cache.height;
+	header.layer_count = cache.layer_count;
+	header.level_count = cache.level_count;
+	header.string_size = static_cast<uint32_t>(strings.size());
+
+	header.data_offset = align_data(sizeof(TextureCacheHeader) + records.size() * sizeof(TextureNameRecord) + strings.size());
+	header.data_size = cache.data.size();
+
+	std::ofstream file{ filename, std::ios::binary | std::ios::trunc };
+	if (!file.is_open())
+	{
+		throw std::runtime_error("Failed to open texture cache for writing");
+	}
+
+	file.write(reinterpret_cast<const char*>(&header), sizeof(header));
+	file.write(reinterpret_cast<const char*>(records.data()), static_cast<std::streamsize>(records.size() * sizeof(TextureNameRecord)));
+	file.write(strings.data(), static_cast<std::streamsize>(strings.size()));
+
+	//pad up to the block data
+	const std::vector<char> padding(header.data_offset - static_cast<uint64_t>(file.tellp()), '\0');
+	file.write(padding.data(), static_cast<std::streamsize>(padding.size()));
+
+	file.write(reinterpret_cast<const char*>(cache.data.data()), static_cast<std::streamsize>(cache.data.size()));
+
+	if (!file)
+	{
+		throw std::runtime_error("Failed to write texture cache");
+	}
+}
@@ -0,0 +1,110 @@
+#ifndef TEXTURE_CACHE_COMMON_HPP
+#define TEXTURE_CACHE_COMMON_HPP
+
+#include <cstdint>
+#include <cstddef>
+#include <vector>
+#include <string>
+#include <algorithm>
+
+//texture cache layout (native endianness):
+//TextureCacheHeader | name records | name strings | block data, 8 byte aligned
+//block data is stored level by level and every level holds all layers one after another,
+//so a whole level of the texture array uploads with one call
+
+constexpr uint32_t TEXTURE_CACHE_VERSION = 1;
+
+enum class TextureCacheFormat : uint32_t
+{
+	//8 bytes per 4x4 block, rgb with 565 endpoints
+	BC1 = 1,
+	//16 bytes per 4x4 block, always encoded with mode 6
+	BC7 = 2
+};
+
+struct TextureCacheHeader
+{
+	char magic[4];
+	uint32_t version;
+
+	uint32_t format;
+	uint32_t width, height;
+	uint32_t layer_count, level_count;
+
+	uint32_t string_size;
+
+	uint64_t data_offset, data_size;
+};
+
+struct TextureNameRecord
+{
+	uint32_t offset, length;
+};
+
+inline size_t texture_block_size(TextureCacheFormat format)
+{
+	return format == TextureCacheFormat::BC1 ? 8 : 16;
+}
+
+inline uint32_t texture_level_extent(uint32_t extent, uint32_t level)
+{
+	return std::max(1u, extent >> level);
+}
+
+//number of levels down to 1x1
+inline uint32_t full_level_count(uint32_t width, uint32_t height)
+{
+	uint32_t levels = 1;
+	while ((std::max(width, height) >> levels) > 0)
+	{
+		levels++;
+	}
+
+	return levels;
+}
+
+//block compressed layers of a texture array with their whole mip chain
+struct TextureCache
+{
+	TextureCacheFormat format = TextureCacheFormat::BC1;
+	uint32_t width = 0, height = 0;
+	uint32_t layer_count = 0, level_count = 0;
+
+	//source image of every layer, in order
+	std::vector<std::string> names;
+
+	std::vector<unsigned char> data;
+
+	//bytes of one layer at the given level
+	size_t layer_size(uint32_t level) const;
+
+	//bytes of all layers at the given level
+	size_t level_size(uint32_t level) const
+	{
+		return layer_size(level) * layer_count;
+	}
+
+	size_t level_offset(uint32_t level) const;
+
+	unsigned char* layer_data(uint32_t level, uint32_t layer)
+	{
+		return data.data() + level_offset(level) + layer_size(level) * layer;
+	}
+
+	const unsigned char* level_data(uint32_t level) const
+	{
+		return data.data() + level_offset(level);
+	}
+
+	//sizes the data for the current format, size and counts
+	void allocate();
+
+	//whether this cache was made from exactly these images at this size
+	bool matches(const std::vector<std::string>& texture_names, uint32_t texture_width, uint32_t texture_height) const;
+};
+
+TextureCache read_texture_cache(const char* filename);
+
+void write_texture_cache(const char* filename, const TextureCache& cache);
+
+#endif
@@ -0,0 +1,165 @@
+#ifndef VERTEX_WELDER_COMMON_HPP
+#define VERTEX_WELDER_COMMON_HPP
+
+#include <vector>
+#include <cstdint>
+#include <cstddef>
+#include <cstring>
+#include <type_traits>
+
+//64 bit hash over the raw bytes of an object
+inline uint64_t hash_bytes(const void* data, size_t size)
+{
+	const auto* bytes = static_cast<const unsigned char*>(data);
+
+	uint64_t hash = 0x9E3779B97F4A7C15ull ^ (size * 0xC2B2AE3D27D4EB4Full);
+
+	while (size >= sizeof(uint64_t))
+	{
+		uint64_t word;
+		memcpy(&word, bytes, sizeof(uint64_t));
+
+		hash = (hash ^ word) * 0xFF51AFD7ED558CCDull;
+		hash ^= hash >> 32;
+
+		bytes += sizeof(uint64_t);
+		size -= sizeof(uint64_t);
+	}
+
+	if (size > 0)
+	{
+		uint64_t word = 0;
+		memcpy(&word, bytes, size);
+
+		hash = (hash ^ word) * 0xFF51AFD7ED558CCDull;
+		hash ^= hash >> 32;
+	}
+
+	//final avalanche so the low bits used for the table index depend on every input bit
+	hash ^= hash >> 33;
+	hash *= 0xC4CEB9FE1A85EC53ull;
+	hash ^= hash >> 33;
+
+	return hash;
+}
+
+//deduplicates vertices into an output vector using an open addressing table with linear probing,
+//vertices are compared by their bytes so T must not contain padding (and 0.0f and -0.0f are different vertices)
+template<typename T>
+class VertexWelder
+{
+	static_assert(std::is_trivially_copyable<T>::value, "VertexWelder compares vertices byte by byte");
+
+	static constexpr uint32_t EMPTY = UINT32_MAX;
+
+	struct Slot
+	{
+		//upper bits of the hash, checked before comparing whole vertices
+		uint32_t hash;
+		uint32_t index;
+	};
+
+	std::vector<Slot> slots;
+	size_t mask = 0;
+
+	std::vector<T>* vertices;
+
+	void grow(size_t capacity)
+	{
+		size_t size = 16;
+		while (size < capacity + capacity / 2)
+		{
+			size *= 2;
+		}
+
+		if (size <= slots.size())
+		{
+			return;
+		}
+
+		std::vector<Slot> old_slots(size, Slot{ 0, EMPTY });
+		old_slots.swap(slots);
+		mask = size - 1;
+
+		//reinsert with the stored hashes, the vertices themselves don't need to be touched
+		for (const auto& slot : old_slots)
+		{
+			if (slot.index == EMPTY)
+			{
+				continue;
+			}
+
+			size_t i = slot_index(slot.hash);
+			while (slots[i].index != EMPTY)
+			{
+				i = (i + 1) & mask;
+			}
+
+			slots[i] = slot;
+		}
+	}
+
+	size_t slot_index(uint32_t hash) const
+	{
+		return static_cast<size_t>(hash) & mask;
+	}
+
+public:
+	//expected_vertices is how many unique vertices are going to be added, the table never rehashes below that
+	explicit VertexWelder(std::vector<T>& output, size_t expected_vertices = 0)
+		: vertices(&output)
+	{
+		grow(expected_vertices > output.size() ? expected_vertices : output.size());
+
+		//weld against anything already in the output
+		for (size_t i = 0; i < output.size(); i++)
+		{
+			const uint32_t hash = static_cast<uint32_t>(hash_bytes(&output[i], sizeof(T)) >> 32);
+
+			size_t slot = slot_index(hash);
+			while (slots[slot].index != EMPTY)
+			{
+				slot = (slot + 1) & mask;
+			}
+
+			slots[slot] = Slot{ hash, static_cast<uint32_t>(i) };
+		}
+	}
+
+	void reserve(size_t expected_vertices)
+	{
+		grow(expected_vertices);
+	}
+
+	//returns the index of the vertex in the output, adding it if it's new
+	uint32_t add(const T& vertex)
+	{
+		const uint32_t hash = static_cast<uint32_t>(hash_bytes(&vertex, sizeof(T)) >> 32);
+
+		size_t i = slot_index(hash);
+		while (slots[i].index != EMPTY)
+		{
+			if (slots[i].hash == hash && memcmp(&(*vertices)[slots[i].index], &vertex, sizeof(T)) == 0)
+			{
+				return slots[i].index;
+			}
+
+			i = (i + 1) & mask;
+		}
+
+		const uint32_t index = static_cast<uint32_t>(vertices->size());
+		vertices->push_back(vertex);
+
+		slots[i] = Slot{ hash, index };
+
+		//keep the table at most two thirds full
+		if (vertices->size() * 3 > slots.size() * 2)
+		{
+			grow(vertices->size() * 2);
+		}
+
+		return index;
+	}
+};
+
+#endif
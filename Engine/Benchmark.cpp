@@ -0,0 +1,248 @@
+#include "Benchmark.hpp"
+
+#include <stdexcept>
+#include <fstream>
+#include <sstream>
+#include <algorithm>
+#include <cmath>
+
+std::vector<CameraKey> read_camera_path(const std::string& filename)
+{
+	std::ifstream file{ filename };
+	if (!file.is_open())
+	{
+		throw std::runtime_error("Failed to open camera path " + filename);
+	}
+
+	std::vector<CameraKey> path;
+
+	std::string line;
+	while (std::getline(file, line))
+	{
+		//skip comments and empty lines
+		if (line.empty() || line[0] == '#')
+		{
+			continue;
+		}
+
+		std::istringstream line_stream{ line };
+
+		CameraKey key;
+		if (!(line_stream >> key.pos.x >> key.pos.y >> key.pos.z >> key.yaw >> key.pitch))
+		{
+			throw std::runtime_error("Bad line in camera path " + filename + ": " + line);
+		}
+
+		path.push_back(key);
+	}
+
+	if (path.empty())
+	{
+		throw std::runtime_error("Camera path " + filename + " is empty");
+	}
+
+	return path;
+}
+
+void write_camera_path(const std::string& filename, const std::vector<CameraKey>& path)
+{
+	std::ofstream file{ filename };
+	if (!file.is_open())
+	{
+		throw std::runtime_error("Failed to open camera path " + filename + " for writing");
+	}
+
+	file << "# x y z yaw pitch\n";
+
+	for (const auto& key : path)
+	{
+		file << key.pos.x << ' ' << key.pos.y << ' ' << key.pos.z << ' ' << key.yaw << ' ' << key.pitch << '\n';
+	}
+}
+
+CameraKey sample_camera_path(const std::vector<CameraKey>& path, float t)
+{
+	if (path.size() == 1)
+	{
+		return path[0];
+	}
+
+	const float position = std::clamp(t, 0.0f, 1.0f) * static_cast<float>(path.size() - 1);
+	const size_t first = std::min(static_cast<size_t>(position), path.size() - 2);
+	const float blend = position - static_cast<float>(first);
+
+	const auto& a = path[first];
+	const auto& b = path[first + 1];
+
+	//turn the short way around
+	float yaw_delta = std::fmod(b.yaw - a.yaw, 360.0f);
+	if (yaw_delta > 180.0f)
+	{
+		yaw_delta -= 360.0f;
+	}
+	else if (yaw_delta < -180.0f)
+	{
+		yaw_delta += 360.0f;
+	}
+
+	return CameraKey
+	{
+		glm::mix(a.pos, b.pos, blend),
+		a.yaw + yaw_delta * blend,
+		a.pitch + (b.pitch - a.pitch) * blend
+	};
+}
+
+GpuTimer::GpuTimer()
+{
+	glCreateQueries(GL_TIME_ELAPSED, static_cast<GLsizei>(queries.size()), queries.data());
+}
+
+GpuTimer::~GpuTimer()
+{
+	glDeleteQueries(static_cast<GLsizei>(queries.size()), queries.data());
+}
+
+void GpuTimer::begin(std::vector<double>& times)
+{
+	if (started - finished == QUERY_COUNT)
+	{
+		GLuint64 elapsed = 0;
+		glGetQueryObjectui64v(queries[finished % QUERY_COUNT], GL_QUERY_RESULT, &elapsed);
+
+		times.push_back(static_cast<double>(elapsed) / 1000000.0);
+		finished++;
+	}
+
+	glBeginQuery(GL_TIME_ELAPSED, queries[started % QUERY_COUNT]);
+}
+
+void GpuTimer::end()
+{
+	glEndQuery(GL_TIME_ELAPSED);
+
+	started++;
+}
+
+void GpuTimer::finish(std::vector<double>& times)
+{
+	while (finished < started)
+	{
+		GLuint64 elapsed = 0;
+		glGetQueryObjectui64v(queries[finished % QUERY_COUNT], GL_QUERY_RESULT, &elapsed);
+
+		times.push_back(static_cast<double>(elapsed) / 1000000.0);
+		finished++;
+	}
+}
+
+void write_screenshot(const std::string& filename, int32_t width, int32_t height, const std::vector<uint32_t>& pixels)
+{
+	std::ofstream file{ filename, std::ios::binary };
+	if (!file.is_open())
+	{
+		throw std::runtime_error("Failed to open screenshot " + filename);
+	}
+
+	file << "P6\n" << width << ' ' << height << "\n255\n";
+
+	std::vector<char> row(static_cast<size_t>(width) * 3);
+	for (int32_t y = 0; y < height; y++)
+	{
+		for (int32_t x = 0; x < width; x++)
+		{
+			const uint32_t pixel = pixels[static_cast<size_t>(y) * width + x];
+
+			row[x * 3] = static_cast<char>(pixel & 0xFF);
+			row[x * 3 + 1] = static_cast<char>((pixel >> 8) & 0xFF);
+			row[x * 3 + 2] = static_cast<char>((pixel >> 16) & 0xFF);
+		}
+
+		file.write(row.data(), static_cast<std::streamsize>(row.size()));
+	}
+}
+
+//nearest rank percentile of sorted times
+static double percentile(const std::vector<double>& sorted_times, double percent)
+{
+	if (sorted_times.empty())
+	{
+		return 0.0;
+	}
+
+	const double rank = std::ceil(percent / 100.0 * static_cast<double>(sorted_times.size()));
+	const size_t index = static_cast<size_t>(std::max(rank, 1.0)) - 1;
+
+	return sorted_times[std::min(index, sorted_times.size() - 1)];
+}
+
+static void write_stats(std::ofstream& file, const char* name, const std::vector<double>& times)
+{
+	std::vector<double> sorted_times = times;
+	std::sort(sorted_times.begin(), sorted_times.end());
+
+	double total = 0.0;
+	for (const auto time : times)
+	{
+		total += time;
+	}
+
+	file << "\t\"" << name << "\": {\n";
+	file << "\t\t\"mean\": " << (times.empty() ? 0.0 : total / static_cast<double>(times.size())) << ",\n";
+	file << "\t\t\"min\": " << (sorted_times.empty() ? 0.0 : sorted_times.front()) << ",\n";
+	file << "\t\t\"p50\": " << percentile(sorted_times, 50.0) << ",\n";
+	file << "\t\t\"p90\": " << percentile(sorted_times, 90.0) << ",\n";
+	file << "\t\t\"p95\": " << percentile(sorted_times, 95.0) << ",\n";
+	file << "\t\t\"p99\": " << percentile(sorted_times, 99.0) << ",\n";
+	file << "\t\t\"max\": " << (sorted_times.empty() ? 0.0 : sorted_times.back()) << ",\n";
+
+	file << "\t\t\"frames\": [";
+	for (size_t i = 0; i < times.size(); i++)
+	{
+		file << (i == 0 ? "" : ", ") << times[i];
+	}
+	file << "]\n";
+
+	file << "\t}";
+}
+
+//only quotes and backslashes can show up in the strings we write
+static std::string escape_json(const std::string& str)
+{
+	std::string escaped;
+	for (const auto c : str)
+	{
+		if (c == '"' || c == '\\')
+		{
+			escaped.push_back('\\');
+		}
+
+		escaped.push_back(c);
+	}
+
+	return escaped;
+}
+
+void write_benchmark_json(const std::string& filename, const BenchmarkSettings& settings, const std::string& renderer_name,
+	const std::vector<double>& cpu_times, const std::vector<double>& gpu_times, double total_seconds)
+{
+	std::ofstream file{ filename };
+	if (!file.is_open())
+	{
+		throw std::runtime_error("Failed to open benchmark output " + filename);
+	}
+
+	file << "{\n";
+	file << "\t\"renderer\": \"" << escape_json(renderer_name) << "\",\n";
+	file << "\t\"camera_path\": \"" << escape_json(settings.camera_path) << "\",\n";
+	file << "\t\"width\": " << settings.width << ",\n";
+	file << "\t\"height\": " << settings.height << ",\n";
+	file << "\t\"frames\": " << cpu_times.size() << ",\n";
+	file << "\t\"total_seconds\": " << total_seconds << ",\n";
+	file << "\t\"fps\": " << (total_seconds > 0.0 ? static_cast<double>(cpu_times.size()) / total_seconds : 0.0) << ",\n";
+
+	write_stats(file, "cpu_ms", cpu_times);
+	file << ",\n";
+	write_stats(file, "gpu_ms", gpu_times);
+	file << "\n}\n";
+}
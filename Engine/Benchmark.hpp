@@ -0,0 +1,75 @@
+#ifndef BENCHMARK_HPP
+#define BENCHMARK_HPP
+
+#include <vector>
+#include <string>
+#include <array>
+#include <cstdint>
+
+#include <glad/glad.h>
+
+#include <glm/glm.hpp>
+
+//one recorded camera position, paths are text files with a "x y z yaw pitch" line per key
+struct CameraKey
+{
+	glm::vec3 pos;
+	float yaw, pitch;
+};
+
+std::vector<CameraKey> read_camera_path(const std::string& filename);
+
+void write_camera_path(const std::string& filename, const std::vector<CameraKey>& path);
+
+//linearly interpolates the path, t goes from 0 at the first key to 1 at the last
+CameraKey sample_camera_path(const std::vector<CameraKey>& path, float t);
+
+struct BenchmarkSettings
+{
+	std::string camera_path;
+	std::string output = "bench.json";
+
+	uint32_t frames = 1000;
+	//frames rendered before measuring so driver warmup and shader compilation don't count
+	uint32_t warmup_frames = 30;
+
+	int32_t width = 1280, height = 720;
+
+	//the last frame is written here as a binary ppm when it isn't empty, to compare renderers
+	std::string screenshot;
+};
+
+//measures how long the gpu spends between begin and end, results are read a few frames later
+//so the cpu doesn't wait on the gpu every frame
+class GpuTimer
+{
+	static constexpr size_t QUERY_COUNT = 4;
+
+	std::array<GLuint, QUERY_COUNT> queries{};
+	size_t started = 0, finished = 0;
+
+public:
+	explicit GpuTimer();
+
+	~GpuTimer();
+
+	explicit GpuTimer(GpuTimer&) = delete;
+
+	GpuTimer& operator=(GpuTimer&) = delete;
+
+	//when all queries are in flight the oldest one is waited on first and its time in milliseconds appended to times
+	void begin(std::vector<double>& times);
+
+	void end();
+
+	//waits for every query still in flight
+	void finish(std::vector<double>& times);
+};
+
+//pixels are rgba8 with the top row first
+void write_screenshot(const std::string& filename, int32_t width, int32_t height, const std::vector<uint32_t>& pixels);
+
+void write_benchmark_json(const std::string& filename, const BenchmarkSettings& settings, const std::string& renderer_name,
+	const std::vector<double>& cpu_times, const std::vector<double>& gpu_times, double total_seconds);
+
+#endif
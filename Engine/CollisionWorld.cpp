@@ -0,0 +1,318 @@
+#include "CollisionWorld.hpp"
+
+#include <algorithm>
+#include <limits>
+#include <cmath>
+
+//about the size of the player, so a query touches a handful of cells
+constexpr float CELL_SIZE = 8.0f;
+
+//caps the memory of huge sectors, their cells just get bigger
+constexpr uint32_t MAX_GRID_SIZE = 64;
+
+//portal chains further than this from where a sweep starts are ignored
+constexpr size_t MAX_SWEEP_SECTORS = 64;
+
+static size_t next_edge(const Sector& sector, size_t edge)
+{
+	return edge + 1 == sector.vertices.size() ? 0 : edge + 1;
+}
+
+//earliest time in [0, 1] a circle moving from pos by motion touches the segment a b
+static bool sweep_circle_segment(glm::vec2 pos, glm::vec2 motion, float radius, glm::vec2 a, glm::vec2 b, CollisionHit& hit)
+{
+	bool found = false;
+	hit.time = std::numeric_limits<float>::max();
+
+	const glm::vec2 edge = b - a;
+	const float edge_length = glm::length(edge);
+
+	//the flat side, from whichever side the circle is on
+	if (edge_length > 0.0f)
+	{
+		glm::vec2 normal = glm::vec2{ edge.y, -edge.x } / edge_length;
+
+		float distance = glm::dot(pos - a, normal);
+		if (distance < 0.0f)
+		{
+			normal = -normal;
+			distance = -distance;
+		}
+
+		const float approach = glm::dot(motion, normal);
+		if (approach < 0.0f)
+		{
+			const float time = std::max((distance - radius) / -approach, 0.0f);
+
+			if (time <= 1.0f)
+			{
+				const glm::vec2 contact = pos + motion * time - normal * distance;
+				const float along = glm::dot(contact - a, edge) / (edge_length * edge_length);
+
+				if (along >= 0.0f && along <= 1.0f)
+				{
+					hit = CollisionHit{ time, normal };
+					found = true;
+				}
+			}
+		}
+	}
+
+	//the ends, solving |pos + motion * t - end| = radius
+	for (const auto& end : { a, b })
+	{
+		const glm::vec2 offset = pos - end;
+
+		const float qa = glm::dot(motion, motion);
+		const float qb = glm::dot(offset, motion);
+		const float qc = glm::dot(offset, offset) - radius * radius;
+
+		//moving away or not moving
+		if (qb >= 0.0f || qa == 0.0f)
+		{
+			continue;
+		}
+
+		float time = 0.0f;
+		if (qc > 0.0f)
+		{
+			const float discriminant = qb * qb - qa * qc;
+			if (discriminant < 0.0f)
+			{
+				continue;
+			}
+
+			time = (-qb - std::sqrt(discriminant)) / qa;
+		}
+
+		if (time <= 1.0f && time < hit.time)
+		{
+			const glm::vec2 away = pos + motion * time - end;
+			const float away_length = glm::length(away);
+
+			if (away_length > 0.0f)
+			{
+				hit = CollisionHit{ time, away / away_length };
+				found = true;
+			}
+		}
+	}
+
+	return found;
+}
+
+CollisionWorld::SectorGrid CollisionWorld::build_grid(const Sector& sector)
+{
+	SectorGrid grid;
+
+	glm::vec2 min{ std::numeric_limits<float>::max() };
+	glm::vec2 max{ std::numeric_limits<float>::lowest() };
+
+	for (const auto& vertex : sector.vertices)
+	{
+		min = glm::min(min, vertex);
+		max = glm::max(max, vertex);
+	}
+
+	if (sector.vertices.empty())
+	{
+		min = max = glm::vec2{ 0.0f };
+	}
+
+	const glm::vec2 extent = max - min;
+	const float cell_size = std::max({ CELL_SIZE, extent.x / MAX_GRID_SIZE, extent.y / MAX_GRID_SIZE });
+
+	grid.min = min;
+	grid.inv_cell_size = 1.0f / cell_size;
+	grid.width = std::max(static_cast<uint32_t>(std::ceil(extent.x / cell_size)), 1u);
+	grid.height = std::max(static_cast<uint32_t>(std::ceil(extent.y / cell_size)), 1u);
+
+	struct CellRange
+	{
+		uint32_t x0, y0, x1, y1;
+	};
+
+	const auto cell_range = [&grid](glm::vec2 a, glm::vec2 b)
+	{
+		const glm::vec2 low = (glm::min(a, b) - grid.min) * grid.inv_cell_size;
+		const glm::vec2 high = (glm::max(a, b) - grid.min) * grid.inv_cell_size;
+
+		return CellRange
+		{
+			std::min(static_cast<uint32_t>(std::max(low.x, 0.0f)), grid.width - 1),
+			std::min(static_cast<uint32_t>(std::max(low.y, 0.0f)), grid.height - 1),
+			std::min(static_cast<uint32_t>(std::max(high.x, 0.0f)), grid.width - 1),
+			std::min(static_cast<uint32_t>(std::max(high.y, 0.0f)), grid.height - 1)
+		};
+	};
+
+	//count then fill, edges go in every cell their bounding box covers
+	grid.cell_starts.assign(grid.width * grid.height + 1, 0);
+
+	for (size_t i = 0; i < sector.vertices.size(); i++)
+	{
+		const auto range = cell_range(sector.vertices[i], sector.vertices[next_edge(sector, i)]);
+
+		for (uint32_t y = range.y0; y <= range.y1; y++)
+		{
+			for (uint32_t x = range.x0; x <= range.x1; x++)
+			{
+				grid.cell_starts[y * grid.width + x + 1]++;
+			}
+		}
+	}
+
+	for (size_t c = 1; c < grid.cell_starts.size(); c++)
+	{
+		grid.cell_starts[c] += grid.cell_starts[c - 1];
+	}
+
+	grid.cell_edges.resize(grid.cell_starts.back());
+
+	std::vector<uint32_t> cell_fill(grid.cell_starts.begin(), grid.cell_starts.end() - 1);
+
+	for (size_t i = 0; i < sector.vertices.size(); i++)
+	{
+		const auto range = cell_range(sector.vertices[i], sector.vertices[next_edge(sector, i)]);
+
+		for (uint32_t y = range.y0; y <= range.y1; y++)
+		{
+			for (uint32_t x = range.x0; x <= range.x1; x++)
+			{
+				grid.cell_edges[cell_fill[y * grid.width + x]++] = static_cast<uint32_t>(i);
+			}
+		}
+	}
+
+	return grid;
+}
+
+void CollisionWorld::build(const std::vector<Sector>& sectors)
+{
+	grids.clear();
+	grids.reserve(sectors.size());
+
+	for (const auto& sector : sectors)
+	{
+		grids.push_back(build_grid(sector));
+	}
+}
+
+void CollisionWorld::update_sector(const std::vector<Sector>& sectors, uint32_t sector_index)
+{
+	if (grids.size() != sectors.size())
+	{
+		build(sectors);
+		return;
+	}
+
+	grids[sector_index] = build_grid(sectors[sector_index]);
+}
+
+void CollisionWorld::gather_edges(uint32_t sector_index, glm::vec2 min, glm::vec2 max, std::vector<uint32_t>& edges) const
+{
+	const auto& grid = grids[sector_index];
+
+	const glm::vec2 low = (min - grid.min) * grid.inv_cell_size;
+	const glm::vec2 high = (max - grid.min) * grid.inv_cell_size;
+
+	//the box misses the sector
+	if (high.x < 0.0f || high.y < 0.0f || low.x >= static_cast<float>(grid.width) || low.y >= static_cast<float>(grid.height))
+	{
+		return;
+	}
+
+	const uint32_t x0 = static_cast<uint32_t>(std::max(low.x, 0.0f));
+	const uint32_t y0 = static_cast<uint32_t>(std::max(low.y, 0.0f));
+	const uint32_t x1 = std::min(static_cast<uint32_t>(high.x), grid.width - 1);
+	const uint32_t y1 = std::min(static_cast<uint32_t>(high.y), grid.height - 1);
+
+	for (uint32_t y = y0; y <= y1; y++)
+	{
+		for (uint32_t x = x0; x <= x1; x++)
+		{
+			const uint32_t cell = y * grid.width + x;
+
+			edges.insert(edges.end(), grid.cell_edges.begin() + grid.cell_starts[cell], grid.cell_edges.begin() + grid.cell_starts[cell + 1]);
+		}
+	}
+}
+
+bool CollisionWorld::edge_blocks(const std::vector<Sector>& sectors, uint32_t sector_index, size_t edge, float bottom, float top)
+{
+	const auto& sector = sectors[sector_index];
+	const int32_t neighbor = sector.neighbors[edge];
+
+	if (neighbor < 0)
+	{
+		return true;
+	}
+
+	const auto& other = sectors[static_cast<size_t>(neighbor)];
+
+	const float ceil = std::max(sector.ceil, other.ceil);
+	const float floor = std::min(sector.floor, other.floor);
+
+	return ceil < top || floor > bottom;
+}
+
+bool CollisionWorld::sweep(const std::vector<Sector>& sectors, uint32_t start_sector, glm::vec2 pos, glm::vec2 motion, float radius,
+	float bottom, float top, CollisionHit& hit) const
+{
+	if (start_sector >= grids.size())
+	{
+		return false;
+	}
+
+	//everything the circle can touch on the way
+	const glm::vec2 min = glm::min(pos, pos + motion) - glm::vec2{ radius };
+	const glm::vec2 max = glm::max(pos, pos + motion) + glm::vec2{ radius };
+
+	std::vector<uint32_t> visited{ start_sector };
+	std::vector<uint32_t> edges;
+
+	bool found = false;
+	hit.time = std::numeric_limits<float>::max();
+
+	for (size_t v = 0; v < visited.size(); v++)
+	{
+		const uint32_t sector_index = visited[v];
+		const auto& sector = sectors[sector_index];
+
+		edges.clear();
+		gather_edges(sector_index, min, max, edges);
+
+		std::sort(edges.begin(), edges.end());
+		edges.erase(std::unique(edges.begin(), edges.end()), edges.end());
+
+		for (const auto edge : edges)
+		{
+			const glm::vec2 a = sector.vertices[edge];
+			const glm::vec2 b = sector.vertices[next_edge(sector, edge)];
+
+			if (!edge_blocks(sectors, sector_index, edge, bottom, top))
+			{
+				//the circle may reach into the sector behind the portal, its walls count too
+				const bool near = glm::min(a, b).x <= max.x && glm::min(a, b).y <= max.y && glm::max(a, b).x >= min.x && glm::max(a, b).y >= min.y;
+
+				const uint32_t neighbor = static_cast<uint32_t>(sector.neighbors[edge]);
+
+				if (near && visited.size() < MAX_SWEEP_SECTORS && std::find(visited.begin(), visited.end(), neighbor) == visited.end())
+				{
+					visited.push_back(neighbor);
+				}
+
+				continue;
+			}
+
+			CollisionHit edge_hit;
+			if (sweep_circle_segment(pos, motion, radius, a, b, edge_hit) && edge_hit.time < hit.time)
+			{
+				hit = edge_hit;
+				found = true;
+			}
+		}
+	}
+
+	return found;
+}
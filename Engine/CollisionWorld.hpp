@@ -0,0 +1,61 @@
+#ifndef COLLISION_WORLD_HPP
+#define COLLISION_WORLD_HPP
+
+#include <vector>
+#include <cstdint>
+
+#include <glm/glm.hpp>
+
+#include "Sector.hpp"
+
+//what a swept circle touched first
+struct CollisionHit
+{
+	//fraction of the motion done before touching
+	float time;
+
+	//points away from what was hit, towards the circle
+	glm::vec2 normal;
+};
+
+//a uniform grid over every sector's edges, so a query only tests the edges near it instead of the whole sector
+//walls always block, portals only block bodies that don't fit through the opening, and that's decided per query so moving floors never need a rebuild
+class CollisionWorld
+{
+	struct SectorGrid
+	{
+		glm::vec2 min;
+		float inv_cell_size;
+		uint32_t width, height;
+
+		//the edges of cell c are cell_edges[cell_starts[c]] to cell_edges[cell_starts[c + 1]]
+		std::vector<uint32_t> cell_starts;
+		std::vector<uint32_t> cell_edges;
+	};
+
+	std::vector<SectorGrid> grids;
+
+	static SectorGrid build_grid(const Sector& sector);
+
+	//appends the edges of sector_index whose cells overlap the box, edges can show up more than once
+	void gather_edges(uint32_t sector_index, glm::vec2 min, glm::vec2 max, std::vector<uint32_t>& edges) const;
+
+public:
+	explicit CollisionWorld() = default;
+
+	//the sectors aren't referenced, but build again when their vertices change
+	void build(const std::vector<Sector>& sectors);
+
+	//for when one sector's vertices changed
+	void update_sector(const std::vector<Sector>& sectors, uint32_t sector_index);
+
+	//whether a body spanning bottom to top can't pass through the edge
+	static bool edge_blocks(const std::vector<Sector>& sectors, uint32_t sector_index, size_t edge, float bottom, float top);
+
+	//sweeps a circle from pos along motion, through start_sector and every sector it can reach through a portal it comes near,
+	//returns false if nothing was hit
+	bool sweep(const std::vector<Sector>& sectors, uint32_t start_sector, glm::vec2 pos, glm::vec2 motion, float radius,
+		float bottom, float top, CollisionHit& hit) const;
+};
+
+#endif
@@ -0,0 +1,54 @@
+#include "ComputeShaderProgram.hpp"
+
+#include <stdexcept>
+
+ComputeShaderProgram::ComputeShaderProgram(std::string_view compute_shader_code)
+{
+	GLuint compute_shader = glCreateShader(GL_COMPUTE_SHADER);
+
+	{
+		const char* compute_shader_source = compute_shader_code.data();
+
+		glShaderSource(compute_shader, 1, reinterpret_cast<const GLchar* const*>(&compute_shader_source), nullptr);
+
+		glCompileShader(compute_shader);
+	}
+
+	//check if the compilation worked
+	{
+		GLint shader_compiled = GL_FALSE;
+		glGetShaderiv(compute_shader, GL_COMPILE_STATUS, &shader_compiled);
+		if (shader_compiled != GL_TRUE)
+		{
+			glDeleteShader(compute_shader);
+
+			throw std::runtime_error("Failed to compile compute shader");
+		}
+	}
+
+	program = glCreateProgram();
+
+	glAttachShader(program, compute_shader);
+
+	glLinkProgram(program);
+
+	//the shader isn't needed once it's linked in, whether that worked or not
+	glDeleteShader(compute_shader);
+
+	{
+		GLint program_compiled = GL_FALSE;
+		glGetProgramiv(program, GL_LINK_STATUS, &program_compiled);
+		if (program_compiled != GL_TRUE)
+		{
+			throw std::runtime_error("Failed to link compute shader program");
+		}
+	}
+}
+
+ComputeShaderProgram::~ComputeShaderProgram()
+{
+	if (program)
+	{
+		glDeleteProgram(program);
+	}
+}
@@ -0,0 +1,42 @@
+#ifndef COMPUTE_SHADER_PROGRAM_OPENGL_HPP
+#define COMPUTE_SHADER_PROGRAM_OPENGL_HPP
+
+#include <glad/glad.h>
+
+#include <string_view>
+
+class ComputeShaderProgram
+{
+public:
+	GLuint program = 0;
+
+	inline void use() const { glUseProgram(program); }
+
+	explicit ComputeShaderProgram(std::string_view compute_shader_code);
+
+	explicit ComputeShaderProgram() = default;
+
+	explicit ComputeShaderProgram(ComputeShaderProgram&& o) noexcept
+		: program(o.program)
+	{
+		o.program = 0;
+	}
+
+	ComputeShaderProgram& operator=(ComputeShaderProgram&& o) noexcept
+	{
+		if (&o == this)
+		{
+			return *this;
+		}
+
+		program = o.program;
+
+		o.program = 0;
+
+		return *this;
+	}
+
+	~ComputeShaderProgram();
+};
+
+#endif
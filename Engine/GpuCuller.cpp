@@ -0,0 +1,249 @@
+#include "GpuCuller.hpp"
+
+#include <stdexcept>
+#include <string>
+#include <algorithm>
+
+#include <SDL.h>
+
+#include <glm/gtc/type_ptr.hpp>
+
+#include "Profiler.hpp"
+
+//from ARB_indirect_parameters, glad only has 4.5
+#ifndef GL_PARAMETER_BUFFER_ARB
+#define GL_PARAMETER_BUFFER_ARB 0x80EE
+#endif
+
+constexpr GLuint CULL_GROUP_SIZE = 64;
+
+static const char* const cull_shader_code =
+	"#version 450 core\n"
+	"layout(local_size_x = 64) in;"
+	"struct GpuSector"
+	"{"
+	"	vec3 min_bounds;"
+	"	uint first_index;"
+	"	vec3 max_bounds;"
+	"	uint index_count;"
+	"};"
+	"struct DrawCommand"
+	"{"
+	"	uint count;"
+	"	uint instance_count;"
+	"	uint first_index;"
+	"	int base_vertex;"
+	"	uint base_instance;"
+	"};"
+	"layout(std430, binding = 0) readonly buffer Sectors { GpuSector sectors[]; };"
+	"layout(std430, binding = 1) writeonly buffer Commands { DrawCommand commands[]; };"
+	"layout(std430, binding = 2) buffer Count { uint draw_count; };"
+	"layout(location = 0) uniform vec4 planes[6];"
+	"layout(location = 6) uniform uint sector_count;"
+	"void main()"
+	"{"
+	"	uint index = gl_GlobalInvocationID.x;"
+	"	if (index >= sector_count) return;"
+	"	GpuSector sector = sectors[index];"
+	"	if (sector.index_count == 0) return;"
+	//the box is outside if its corner furthest along a plane's normal is still behind it
+	"	for (int i = 0; i < 6; i++)"
+	"	{"
+	"		vec3 corner = mix(sector.min_bounds, sector.max_bounds, greaterThan(planes[i].xyz, vec3(0.0)));"
+	"		if (dot(planes[i].xyz, corner) + planes[i].w < 0.0) return;"
+	"	}"
+	"	uint slot = atomicAdd(draw_count, 1u);"
+	"	commands[slot] = DrawCommand(sector.index_count, 1u, sector.first_index, 0, index);"
+	"}";
+
+GpuCuller::GpuSector GpuCuller::make_gpu_sector(const Sector& sector, const MeshRange& range)
+{
+	glm::vec2 min_corner{ 0.0f }, max_corner{ 0.0f };
+	if (!sector.vertices.empty())
+	{
+		min_corner = max_corner = sector.vertices[0];
+		for (const auto& vertex : sector.vertices)
+		{
+			min_corner = glm::min(min_corner, vertex);
+			max_corner = glm::max(max_corner, vertex);
+		}
+	}
+
+	return GpuSector
+	{
+		glm::vec3{ min_corner.x, std::min(sector.floor, sector.ceil), min_corner.y }, range.first,
+		glm::vec3{ max_corner.x, std::max(sector.floor, sector.ceil), max_corner.y }, range.count
+	};
+}
+
+GpuCuller::GpuCuller(const std::vector<Sector>& sectors, const std::vector<MeshRange>& sector_ranges)
+	: cull_shader(cull_shader_code), sector_count(static_cast<uint32_t>(sectors.size()))
+{
+	std::vector<GpuSector> gpu_sectors(sectors.size());
+	for (size_t i = 0; i < sectors.size(); i++)
+	{
+		gpu_sectors[i] = make_gpu_sector(sectors[i], sector_ranges[i]);
+	}
+
+	glCreateBuffers(1, &sector_buffer);
+	glCreateBuffers(1, &command_buffer);
+	glCreateBuffers(1, &count_buffer);
+
+	//empty maps still need storage to bind
+	glNamedBufferStorage(sector_buffer, std::max<size_t>(gpu_sectors.size(), 1) * sizeof(GpuSector), gpu_sectors.empty() ? nullptr : gpu_sectors.data(), GL_DYNAMIC_STORAGE_BIT);
+	glNamedBufferStorage(command_buffer, std::max<size_t>(gpu_sectors.size(), 1) * sizeof(DrawElementsIndirectCommand), nullptr, GL_DYNAMIC_STORAGE_BIT);
+	glNamedBufferStorage(count_buffer, sizeof(uint32_t), nullptr, GL_DYNAMIC_STORAGE_BIT);
+
+	GLint major = 0, minor = 0;
+	glGetIntegerv(GL_MAJOR_VERSION, &major);
+	glGetIntegerv(GL_MINOR_VERSION, &minor);
+
+	if (major > 4 || (major == 4 && minor >= 6))
+	{
+		multi_draw_indirect_count = reinterpret_cast<MultiDrawElementsIndirectCount>(SDL_GL_GetProcAddress("glMultiDrawElementsIndirectCount"));
+	}
+	else
+	{
+		GLint extension_count = 0;
+		glGetIntegerv(GL_NUM_EXTENSIONS, &extension_count);
+		for (GLint i = 0; i < extension_count; i++)
+		{
+			const std::string extension = reinterpret_cast<const char*>(glGetStringi(GL_EXTENSIONS, static_cast<GLuint>(i)));
+
+			if (extension == "GL_ARB_indirect_parameters")
+			{
+				multi_draw_indirect_count = reinterpret_cast<MultiDrawElementsIndirectCount>(SDL_GL_GetProcAddress("glMultiDrawElementsIndirectCountARB"));
+				break;
+			}
+		}
+	}
+}
+
+GpuCuller::~GpuCuller()
+{
+	if (sector_buffer)
+	{
+		glDeleteBuffers(1, &sector_buffer);
+		glDeleteBuffers(1, &command_buffer);
+		glDeleteBuffers(1, &count_buffer);
+	}
+}
+
+GpuCuller::GpuCuller(GpuCuller&& o) noexcept
+	: cull_shader(std::move(o.cull_shader)), sector_buffer(o.sector_buffer), command_buffer(o.command_buffer), count_buffer(o.count_buffer),
+	sector_count(o.sector_count), multi_draw_indirect_count(o.multi_draw_indirect_count)
+{
+	o.sector_buffer = 0;
+	o.command_buffer = 0;
+	o.count_buffer = 0;
+	o.sector_count = 0;
+}
+
+GpuCuller& GpuCuller::operator=(GpuCuller&& o) noexcept
+{
+	if (&o == this)
+	{
+		return *this;
+	}
+
+	if (sector_buffer)
+	{
+		glDeleteBuffers(1, &sector_buffer);
+		glDeleteBuffers(1, &command_buffer);
+		glDeleteBuffers(1, &count_buffer);
+	}
+
+	cull_shader = std::move(o.cull_shader);
+	sector_buffer = o.sector_buffer;
+	command_buffer = o.command_buffer;
+	count_buffer = o.count_buffer;
+	sector_count = o.sector_count;
+	multi_draw_indirect_count = o.multi_draw_indirect_count;
+
+	o.sector_buffer = 0;
+	o.command_buffer = 0;
+	o.count_buffer = 0;
+	o.sector_count = 0;
+
+	return *this;
+}
+
+void GpuCuller::update_sector(uint32_t sector_index, const Sector& sector, const MeshRange& range)
+{
+	if (sector_index >= sector_count)
+	{
+		throw std::runtime_error("Tried to update a sector the GpuCuller doesn't have");
+	}
+
+	const GpuSector gpu_sector = make_gpu_sector(sector, range);
+
+	glNamedBufferSubData(sector_buffer, sector_index * sizeof(GpuSector), sizeof(GpuSector), &gpu_sector);
+}
+
+void GpuCuller::cull(const glm::mat4& pv)
+{
+	if (!sector_buffer)
+	{
+		throw std::runtime_error("Tried to cull with an empty GpuCuller");
+	}
+
+	PROFILE_GPU_ZONE("GpuCuller::cull");
+
+	//planes from the rows of pv, points inside have a positive distance to all of them
+	const glm::vec4 row0{ pv[0][0], pv[1][0], pv[2][0], pv[3][0] };
+	const glm::vec4 row1{ pv[0][1], pv[1][1], pv[2][1], pv[3][1] };
+	const glm::vec4 row2{ pv[0][2], pv[1][2], pv[2][2], pv[3][2] };
+	const glm::vec4 row3{ pv[0][3], pv[1][3], pv[2][3], pv[3][3] };
+
+	const glm::vec4 planes[6]
+	{
+		row3 + row0, row3 - row0,
+		row3 + row1, row3 - row1,
+		row3 + row2, row3 - row2
+	};
+
+	const uint32_t zero = 0;
+	glClearNamedBufferData(count_buffer, GL_R32UI, GL_RED_INTEGER, GL_UNSIGNED_INT, &zero);
+
+	//without a draw count every command is drawn, so the ones nothing was appended to have to be empty
+	if (nullptr == multi_draw_indirect_count)
+	{
+		glClearNamedBufferData(command_buffer, GL_R32UI, GL_RED_INTEGER, GL_UNSIGNED_INT, &zero);
+	}
+
+	cull_shader.use();
+
+	glProgramUniform4fv(cull_shader.program, 0, 6, glm::value_ptr(planes[0]));
+	glProgramUniform1ui(cull_shader.program, 6, sector_count);
+
+	glBindBufferBase(GL_SHADER_STORAGE_BUFFER, 0, sector_buffer);
+	glBindBufferBase(GL_SHADER_STORAGE_BUFFER, 1, command_buffer);
+	glBindBufferBase(GL_SHADER_STORAGE_BUFFER, 2, count_buffer);
+
+	glDispatchCompute((sector_count + CULL_GROUP_SIZE - 1) / CULL_GROUP_SIZE, 1, 1);
+
+	glMemoryBarrier(GL_COMMAND_BARRIER_BIT);
+}
+
+void GpuCuller::draw(const Mesh& mesh)
+{
+	if (0 == sector_count)
+	{
+		return;
+	}
+
+	mesh.bind();
+
+	glBindBuffer(GL_DRAW_INDIRECT_BUFFER, command_buffer);
+
+	if (multi_draw_indirect_count)
+	{
+		glBindBuffer(GL_PARAMETER_BUFFER_ARB, count_buffer);
+
+		multi_draw_indirect_count(GL_TRIANGLES, GL_UNSIGNED_INT, nullptr, 0, static_cast<GLsizei>(sector_count), 0);
+	}
+	else
+	{
+		glMultiDrawElementsIndirect(GL_TRIANGLES, GL_UNSIGNED_INT, nullptr, static_cast<GLsizei>(sector_count), 0);
+	}
+}
@@ -0,0 +1,71 @@
+#ifndef GPU_CULLER_HPP
+#define GPU_CULLER_HPP
+
+#include <vector>
+#include <cstdint>
+
+#include <glad/glad.h>
+
+#include <glm/glm.hpp>
+
+#include "ComputeShaderProgram.hpp"
+
+#include "RenderData.hpp"
+
+#include "Sector.hpp"
+
+//tests every sector's bounding box against the view frustum in a compute shader
+//survivors are appended to an indirect command buffer on the gpu, so the cpu cost doesn't grow with the map
+class GpuCuller
+{
+	//matches the compute shader's std430 layout
+	struct GpuSector
+	{
+		glm::vec3 min_bounds;
+		uint32_t first_index;
+		glm::vec3 max_bounds;
+		uint32_t index_count;
+	};
+
+	static_assert(sizeof(GpuSector) == sizeof(float) * 8, "GpuSector must match std430");
+
+	static GpuSector make_gpu_sector(const Sector& sector, const MeshRange& range);
+
+	using MultiDrawElementsIndirectCount = void (APIENTRYP)(GLenum mode, GLenum type, const void* indirect, GLintptr drawcount, GLsizei maxdrawcount, GLsizei stride);
+
+	ComputeShaderProgram cull_shader;
+
+	GLuint sector_buffer = 0, command_buffer = 0, count_buffer = 0;
+
+	uint32_t sector_count = 0;
+
+	//from ARB_indirect_parameters or 4.6, without it the unused commands are zeroed and drawn too
+	MultiDrawElementsIndirectCount multi_draw_indirect_count = nullptr;
+
+public:
+	//ranges index the mesh the culled commands will be drawn from
+	explicit GpuCuller(const std::vector<Sector>& sectors, const std::vector<MeshRange>& sector_ranges);
+
+	explicit GpuCuller() = default;
+
+	~GpuCuller();
+
+	explicit GpuCuller(GpuCuller&& o) noexcept;
+
+	GpuCuller& operator=(GpuCuller&& o) noexcept;
+
+	explicit GpuCuller(GpuCuller&) = delete;
+
+	GpuCuller& operator=(GpuCuller&) = delete;
+
+	//new bounds and index range for one sector, after it was remeshed
+	void update_sector(uint32_t sector_index, const Sector& sector, const MeshRange& range);
+
+	//fills the command buffer with the sectors inside the frustum of pv
+	void cull(const glm::mat4& pv);
+
+	//draws what the last cull() left behind
+	void draw(const Mesh& mesh);
+};
+
+#endif
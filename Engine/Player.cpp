@@ -2,10 +2,18 @@
 
 #include <cmath>
 #include <algorithm>
-#include <array>
 
 #include <glm/gtc/matrix_transform.hpp>
 
+//half the width of the old bounding box
+constexpr float PLAYER_RADIUS = 1.0f;
+
+//gap kept between the player and walls
+constexpr float SKIN_WIDTH = 0.001f;
+
+//enough for a corner and the wall after it
+constexpr size_t MAX_SLIDES = 3;
+
 void Player::update_vectors()
 {
 	front = glm::normalize(glm::vec3
@@ -27,7 +35,7 @@ void Player::update_vectors()
 }
 
 Player::Player(uint32_t sector, glm::vec3 pos, glm::vec3 world_up, float yaw, float pitch)
-	: position(pos), velocity(glm::vec3{ 0.0f }), front(glm::vec3{ 0.0f }), world_up(world_up), sector(sector), yaw(yaw), pitch(pitch)
+	: position(pos), velocity(glm::vec3{ 0.0f }), front(glm::vec3{ 0.0f }), world_up(world_up), sector(sector), prev_position(pos), prev_sector(sector), yaw(yaw), pitch(pitch)
 {
 	update_vectors();
 }
@@ -43,6 +51,8 @@ Player& Player::operator=(Player&& player) noexcept
 	velocity = std::move(player.velocity);
 	front = std::move(player.front);
 	sector = std::move(player.sector);
+	prev_position = std::move(player.prev_position);
+	prev_sector = std::move(player.prev_sector);
 	pitch = std::move(player.pitch);
 	yaw = std::move(player.yaw);
 
@@ -51,9 +61,36 @@ Player& Player::operator=(Player&& player) noexcept
 	return *this;
 }
 
-glm::mat4 Player::get_view_matrix() const
+void Player::set_view(uint32_t sector, glm::vec3 pos, float yaw, float pitch)
 {
-	return glm::lookAt(position, position + front, world_up);
+	this->sector = sector;
+	position = pos;
+	prev_sector = sector;
+	prev_position = pos;
+	velocity = glm::vec3{ 0.0f };
+	this->yaw = yaw;
+	this->pitch = pitch;
+
+	update_vectors();
+}
+
+uint32_t Player::get_render_sector(const std::vector<Sector>& sectors, float alpha) const
+{
+	if (sector == prev_sector || sector >= sectors.size())
+	{
+		return sector;
+	}
+
+	const glm::vec3 pos = get_render_pos(alpha);
+
+	return point_in_sector(sectors[sector], glm::vec2{ pos.x, pos.z }) ? sector : prev_sector;
+}
+
+glm::mat4 Player::get_view_matrix(float alpha) const
+{
+	const glm::vec3 pos = get_render_pos(alpha);
+
+	return glm::lookAt(pos, pos + front, world_up);
 }
 
 void Player::move(MoveDir dir, const double deltatime)
@@ -84,7 +121,7 @@ void Player::move(MoveDir dir, const double deltatime)
 	velocity.z = velocity.z * (1 - 0.2f) + move_dir.y * 0.2f;
 }
 
-void Player::collision(const std::vector<Sector>& sectors, const double deltatime)
+void Player::collision(const std::vector<Sector>& sectors, const CollisionWorld& collision_world, const SectorIndex& sector_index, const double deltatime)
 {
 	const auto& sect = sectors[sector];
 
@@ -106,73 +143,73 @@ void Player::collision(const std::vector<Sector>& sectors, const double deltatim
 
 	position.y += velocity.y;
 
-	const std::array<glm::vec2, 4> bounding_box_corners
-	{
-		glm::vec2{ position.x + velocity.x - 1.0f, position.z + velocity.z - 1.0f },
-		glm::vec2{ position.x + velocity.x - 1.0f, position.z + velocity.z + 1.0f },
-		glm::vec2{ position.x + velocity.x + 1.0f, position.z + velocity.z + 1.0f },
-		glm::vec2{ position.x + velocity.x + 1.0f, position.z + velocity.z - 1.0f }
-	};
-
-	//vertical check
-	for (size_t i = 0; i < sect.vertices.size(); i++)
-	{
-		const auto& vert1 = sect.vertices[i];
+	//vertical check, slide along whatever the swept circle hits first until the motion is used up
+	const float bottom = position.y - (ducking ? get_duck_height() : get_eye_height());
 
-		size_t ref = 0;
-		if (i == sect.vertices.size() - 1)
-		{
-			ref = 0;
-		}
-		else
+	glm::vec2 pos2d{ position.x, position.z };
+	glm::vec2 motion{ velocity.x, velocity.z };
+
+	for (size_t slide = 0; slide < MAX_SLIDES; slide++)
+	{
+		if (glm::dot(motion, motion) == 0.0f)
 		{
-			ref = i + 1;
+			break;
 		}
-		const auto& vert2 = sect.vertices[ref];
 
-		for (const auto& bounding_box_corner : bounding_box_corners)
+		CollisionHit hit;
+		if (!collision_world.sweep(sectors, sector, pos2d, motion, PLAYER_RADIUS, bottom, position.y, hit))
 		{
-			const auto side = [](const glm::vec2& a, const glm::vec2& b, const glm::vec2& p)
-			{
-				const glm::vec2 b_a = b - a;
-				const glm::vec2 p_a = p - a;
+			pos2d += motion;
+			break;
+		}
 
-				return b_a.x * p_a.y - b_a.y * p_a.x;
+		//stop just short of the wall so the next sweep doesn't start touching it
+		const float length = glm::length(motion);
+		const float time = std::max(hit.time - SKIN_WIDTH / length, 0.0f);
 
-			}(vert1, vert2, bounding_box_corner);
+		pos2d += motion * time;
 
-			if (side > 0.0f)
-			{
-				const float ceil = sect.neighbors[i] < 0 ? std::numeric_limits<float>::min() : std::max(sect.ceil, sectors[sect.neighbors[i]].ceil);
-				const float floor = sect.neighbors[i] < 0 ? std::numeric_limits<float>::max() : std::min(sect.floor, sectors[sect.neighbors[i]].floor);
+		//bump into wall, slide against wall
+		motion *= 1.0f - time;
+		motion -= hit.normal * glm::dot(motion, hit.normal);
 
-				if (ceil < position.y
-					|| floor > position.y - (ducking ? get_duck_height() : get_eye_height()))
-				{
-					//bump into wall, slide against wall
+		glm::vec2 velocity2d{ velocity.x, velocity.z };
+		const float into_wall = glm::dot(velocity2d, hit.normal);
+		if (into_wall < 0.0f)
+		{
+			velocity2d -= hit.normal * into_wall;
 
-					//calculate normal of line
-					const auto normal = glm::normalize(glm::vec2{ vert2.y - vert1.y, -(vert2.x - vert1.x) });
+			velocity.x = velocity2d.x;
+			velocity.z = velocity2d.y;
+		}
+	}
 
-					const auto inv_normal = -normal * glm::length(glm::vec2{ velocity.x, velocity.z } * normal);
+	position.x = pos2d.x;
+	position.z = pos2d.y;
 
-					const auto wall_dir = glm::vec2{ velocity.x, velocity.z } - inv_normal;
+	//usually still in the same sector or one next to it, a long move can cross several so look it up then
+	if (!point_in_sector(sectors[sector], pos2d))
+	{
+		const auto& current = sectors[sector];
 
-					velocity.x = wall_dir.x;
-					velocity.z = wall_dir.y;
-				}
-			}
+		const auto neighbor = std::find_if(current.neighbors.begin(), current.neighbors.end(), [&sectors, &pos2d](int32_t neighbor)
+			{
+				return neighbor >= 0 && point_in_sector(sectors[static_cast<size_t>(neighbor)], pos2d);
+			});
 
-			if (sect.neighbors[i] >= 0 && side > 0.0f)
+		if (neighbor != current.neighbors.end())
+		{
+			sector = static_cast<uint32_t>(*neighbor);
+		}
+		else
+		{
+			const int32_t found = sector_index.find_sector(pos2d);
+			if (found >= 0)
 			{
-				sector = sect.neighbors[i];
-				break;
+				sector = static_cast<uint32_t>(found);
 			}
 		}
 	}
-
-	position.x += velocity.x;
-	position.z += velocity.z;
 }
 
 void Player::mouse_move(float xoffset, float yoffset)
@@ -7,6 +7,10 @@
 
 #include "Sector.hpp"
 
+#include "SectorIndex.hpp"
+
+#include "CollisionWorld.hpp"
+
 class Player
 {
 	void update_vectors();
@@ -19,6 +23,10 @@ class Player
 
 	uint32_t sector;
 
+	//where the last simulation step started, rendering interpolates from here
+	glm::vec3 prev_position;
+	uint32_t prev_sector;
+
 	float yaw, pitch;
 
 public:
@@ -31,7 +39,46 @@ public:
 		return position;
 	}
 
-	glm::mat4 get_view_matrix() const;
+	uint32_t get_sector() const
+	{
+		return sector;
+	}
+
+	glm::vec2 get_front2d() const
+	{
+		return front2d;
+	}
+
+	float get_pitch() const
+	{
+		return pitch;
+	}
+
+	float get_yaw() const
+	{
+		return yaw;
+	}
+
+	//puts the player somewhere without any movement or collision, used to replay camera paths
+	void set_view(uint32_t sector, glm::vec3 pos, float yaw, float pitch);
+
+	//alpha is how far rendering is between the last two simulation steps
+	glm::vec3 get_render_pos(float alpha) const
+	{
+		return glm::mix(prev_position, position, alpha);
+	}
+
+	//the sector get_render_pos is in, which is the previous one until the interpolation crosses into the current one
+	uint32_t get_render_sector(const std::vector<Sector>& sectors, float alpha) const;
+
+	glm::mat4 get_view_matrix(float alpha = 1.0f) const;
+
+	//call before every simulation step
+	void begin_step()
+	{
+		prev_position = position;
+		prev_sector = sector;
+	}
 
 	enum class MoveDir
 	{
@@ -42,6 +89,7 @@ public:
 		RIGHT = 1<<4
 	};
 
+	//both are meant to be called once per simulation step with its fixed length, the damping doesn't scale with deltatime
 	void move(MoveDir dir, const double deltatime);
 
 	void set_crouch(bool crouch)
@@ -49,7 +97,7 @@ public:
 		ducking = crouch;
 	}
 
-	void collision(const std::vector<Sector>& sectors, const double deltatime);
+	void collision(const std::vector<Sector>& sectors, const CollisionWorld& collision_world, const SectorIndex& sector_index, const double deltatime);
 
 	void mouse_move(float xoffset, float yoffset);
 
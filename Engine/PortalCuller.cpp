@@ -0,0 +1,191 @@
+#include "PortalCuller.hpp"
+
+#include <cmath>
+#include <algorithm>
+
+//a sector seen through many different portals is only expanded this many times through them,
+//then once more with the whole view so nothing behind it goes missing
+constexpr uint32_t MAX_SECTOR_VISITS = 16;
+
+//when the eye is this close to a portal we don't narrow the view through it,
+//this also covers the player's bounding box crossing a portal before the eye does
+constexpr float NEAR_PORTAL_DISTANCE = 2.0f;
+
+static float cross2d(const glm::vec2& a, const glm::vec2& b)
+{
+	return a.x * b.y - a.y * b.x;
+}
+
+static glm::vec2 rotate2d(const glm::vec2& v, float angle)
+{
+	const float c = std::cos(angle);
+	const float s = std::sin(angle);
+
+	return glm::vec2{ v.x * c - v.y * s, v.x * s + v.y * c };
+}
+
+//keep the part of the segment where the side values are positive
+static bool clip_segment(float side_a, float side_b, glm::vec2& a, glm::vec2& b)
+{
+	if (side_a < 0.0f && side_b < 0.0f)
+	{
+		return false;
+	}
+
+	if (side_a < 0.0f)
+	{
+		a = a + (b - a) * (side_a / (side_a - side_b));
+	}
+	else if (side_b < 0.0f)
+	{
+		b = a + (b - a) * (side_a / (side_a - side_b));
+	}
+
+	return true;
+}
+
+ViewWedge PortalCuller::make_view_wedge(glm::vec2 front2d, float pitch_degrees, float fovy_degrees, float aspect)
+{
+	const float tan_half_y = std::tan(glm::radians(fovy_degrees * 0.5f));
+	const float tan_half_x = tan_half_y * aspect;
+
+	//tilting the camera spreads the top (or bottom) corners of the screen out when seen from above
+	const float pitch = glm::radians(std::abs(pitch_degrees));
+	const float forward_extent = std::cos(pitch) - std::sin(pitch) * tan_half_y;
+
+	//a couple degrees of slack so sectors on the screen edges don't pop
+	const float half_angle = std::atan2(tan_half_x, forward_extent) + glm::radians(2.0f);
+
+	if (forward_extent <= 0.0f || half_angle >= glm::radians(89.0f))
+	{
+		return ViewWedge{ true, glm::vec2{ 0.0f }, glm::vec2{ 0.0f } };
+	}
+
+	return ViewWedge{ false, rotate2d(front2d, -half_angle), rotate2d(front2d, half_angle) };
+}
+
+void PortalCuller::find_visible_sectors(const std::vector<Sector>& sectors, uint32_t start_sector, glm::vec2 eye, const ViewWedge& view, std::vector<uint32_t>& visible_sectors)
+{
+	visible_sectors.clear();
+
+	if (start_sector >= sectors.size())
+	{
+		return;
+	}
+
+	//stamps avoid clearing per sector state every frame
+	stamp++;
+	if (visible_stamps.size() != sectors.size() || stamp == 0)
+	{
+		visible_stamps.assign(sectors.size(), 0);
+		visit_counts.assign(sectors.size(), 0);
+		stamp = 1;
+	}
+
+	stack.clear();
+	stack.push_back(PortalWindow{ start_sector, -1, view });
+
+	while (!stack.empty())
+	{
+		const PortalWindow window = stack.back();
+		stack.pop_back();
+
+		if (visible_stamps[window.sector] != stamp)
+		{
+			visible_stamps[window.sector] = stamp;
+			visit_counts[window.sector] = 0;
+
+			visible_sectors.push_back(window.sector);
+		}
+
+		const uint32_t visits = visit_counts[window.sector]++;
+		if (visits > MAX_SECTOR_VISITS)
+		{
+			continue;
+		}
+
+		//every window is inside the view, so the last expansion covers all the ones that are skipped after it
+		const bool last_visit = visits == MAX_SECTOR_VISITS;
+		const ViewWedge& window_wedge = last_visit ? view : window.wedge;
+		const int64_t from_sector = last_visit ? -1 : window.from_sector;
+
+		const auto& sector = sectors[window.sector];
+
+		for (size_t i = 0; i < sector.vertices.size(); i++)
+		{
+			const int32_t neighbor = sector.neighbors[i];
+
+			if (neighbor < 0 || neighbor == from_sector)
+			{
+				continue;
+			}
+
+			//nothing can be seen through a portal that has no opening
+			const auto& neighbor_sector = sectors[static_cast<size_t>(neighbor)];
+			if (std::min(sector.ceil, neighbor_sector.ceil) <= std::max(sector.floor, neighbor_sector.floor))
+			{
+				continue;
+			}
+
+			glm::vec2 a = sector.vertices[i] - eye;
+			glm::vec2 b = sector.vertices[i == sector.vertices.size() - 1 ? 0 : i + 1] - eye;
+
+			const glm::vec2 edge = b - a;
+			const float edge_length = glm::length(edge);
+			if (edge_length <= 0.0f)
+			{
+				continue;
+			}
+
+			//signed distance from the portal's line to the eye, negative is the inside of the sector
+			const float distance = cross2d(edge, -a) / edge_length;
+			if (distance > NEAR_PORTAL_DISTANCE)
+			{
+				continue;
+			}
+
+			if (distance > -NEAR_PORTAL_DISTANCE)
+			{
+				//right on top of the portal, anything we see now can be seen through it
+				const float t = glm::dot(-a, edge) / (edge_length * edge_length);
+				const float margin = NEAR_PORTAL_DISTANCE / edge_length;
+
+				if (t > -margin && t < 1.0f + margin)
+				{
+					stack.push_back(PortalWindow{ static_cast<uint32_t>(neighbor), window.sector, window_wedge });
+					continue;
+				}
+
+				if (distance >= 0.0f)
+				{
+					continue;
+				}
+			}
+
+			//narrow the view down to the part of the portal that is inside it
+			if (!window_wedge.full)
+			{
+				if (!clip_segment(cross2d(window_wedge.right, a), cross2d(window_wedge.right, b), a, b))
+				{
+					continue;
+				}
+
+				if (!clip_segment(cross2d(a, window_wedge.left), cross2d(b, window_wedge.left), a, b))
+				{
+					continue;
+				}
+			}
+
+			const float winding = cross2d(a, b);
+			if (std::abs(winding) <= 1e-6f * glm::length(a) * glm::length(b))
+			{
+				//portal is seen edge on
+				continue;
+			}
+
+			const ViewWedge wedge = winding > 0.0f ? ViewWedge{ false, a, b } : ViewWedge{ false, b, a };
+
+			stack.push_back(PortalWindow{ static_cast<uint32_t>(neighbor), window.sector, wedge });
+		}
+	}
+}
@@ -0,0 +1,44 @@
+#ifndef PORTAL_CULLER_HPP
+#define PORTAL_CULLER_HPP
+
+#include <vector>
+#include <cstdint>
+
+#include <glm/glm.hpp>
+
+#include "Sector.hpp"
+
+//2d view cone seen from above, everything between the right and left rays is visible
+struct ViewWedge
+{
+	//covers every direction, used when the camera looks (nearly) straight up or down
+	bool full;
+
+	glm::vec2 right, left;
+};
+
+class PortalCuller
+{
+	struct PortalWindow
+	{
+		uint32_t sector;
+		int64_t from_sector;
+		ViewWedge wedge;
+	};
+
+	std::vector<PortalWindow> stack;
+
+	//how often each sector has been entered this traversal, and a stamp to know if it is already listed
+	std::vector<uint32_t> visit_counts;
+	std::vector<uint32_t> visible_stamps;
+	uint32_t stamp = 0;
+
+public:
+	//fills visible_sectors with every sector that can be seen through the portal graph, starting at start_sector
+	void find_visible_sectors(const std::vector<Sector>& sectors, uint32_t start_sector, glm::vec2 eye, const ViewWedge& view, std::vector<uint32_t>& visible_sectors);
+
+	//horizontal cone of a perspective camera, conservative for any pitch
+	static ViewWedge make_view_wedge(glm::vec2 front2d, float pitch_degrees, float fovy_degrees, float aspect);
+};
+
+#endif
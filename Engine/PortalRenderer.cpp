@@ -0,0 +1,260 @@
+#include "PortalRenderer.hpp"
+
+#include <stdexcept>
+#include <string>
+#include <algorithm>
+#include <cmath>
+#include <limits>
+
+#include "ThreadPool.hpp"
+#include "Profiler.hpp"
+
+//rays are allowed to hit a wall slightly past its ends so columns through a corner don't fall between two walls
+constexpr float EDGE_EPSILON = 1e-4f;
+
+//walls closer than this are pushed back, like the gl renderer's near plane
+constexpr float MIN_DISTANCE = 0.1f;
+
+static float cross2d(glm::vec2 a, glm::vec2 b)
+{
+	return a.x * b.y - a.y * b.x;
+}
+
+//the first row whose center is at or below y
+static int32_t row_at(float y, int32_t min_row, int32_t max_row)
+{
+	//clamp before converting, walls right in front of the camera project far outside of int range
+	const float row = std::ceil(y - 0.5f);
+
+	return static_cast<int32_t>(std::clamp(row, static_cast<float>(min_row), static_cast<float>(max_row)));
+}
+
+PortalRenderer::PortalRenderer(ThreadPool& thread_pool)
+	: thread_pool(thread_pool)
+{
+}
+
+void PortalRenderer::resize(int32_t new_width, int32_t new_height)
+{
+	if (new_width <= 0 || new_height <= 0)
+	{
+		throw std::runtime_error("Portal renderer size must be positive");
+	}
+
+	width = new_width;
+	height = new_height;
+
+	color_buffer.assign(static_cast<size_t>(width) * height, clear_color);
+}
+
+void PortalRenderer::load_textures(const std::vector<const char*>& texture_filenames, const size_t texture_width, const size_t texture_height)
+{
+	textures.load(thread_pool, texture_filenames, texture_width, texture_height);
+}
+
+void PortalRenderer::set_clear_color(const glm::vec3& color)
+{
+	clear_color = pack_srgb(color);
+}
+
+void PortalRenderer::draw(const std::vector<Sector>& sectors, uint32_t start_sector, const glm::vec3& view_pos, glm::vec2 front2d, float pitch)
+{
+	PROFILE_ZONE("PortalRenderer::draw");
+
+	if (start_sector >= sectors.size())
+	{
+		std::fill(color_buffer.begin(), color_buffer.end(), clear_color);
+		return;
+	}
+
+	ColumnView view;
+	view.pos = view_pos;
+	view.front = front2d;
+	//cross(front, up) like the view matrix
+	view.right = glm::vec2{ -front2d.y, front2d.x };
+	view.focal = static_cast<float>(height) * 0.5f;
+	view.horizon = static_cast<float>(height) * 0.5f + std::tan(glm::radians(pitch)) * view.focal;
+
+	const size_t strip_count = static_cast<size_t>((width + STRIP_WIDTH - 1) / STRIP_WIDTH);
+
+	thread_pool.parallel_for(strip_count, [&](size_t strip)
+		{
+			const int32_t first_x = static_cast<int32_t>(strip) * STRIP_WIDTH;
+			const int32_t end_x = std::min(first_x + STRIP_WIDTH, width);
+
+			for (int32_t x = first_x; x < end_x; x++)
+			{
+				draw_column(sectors, start_sector, view, x);
+			}
+		}, 1);
+}
+
+void PortalRenderer::draw_column(const std::vector<Sector>& sectors, uint32_t start_sector, const ColumnView& view, int32_t x)
+{
+	//the ray's forward part is one, so the distance along it is the perpendicular distance and there's no fisheye
+	const float camera_x = (static_cast<float>(x) + 0.5f - static_cast<float>(width) * 0.5f) / view.focal;
+	const glm::vec2 ray = view.front + view.right * camera_x;
+	const glm::vec2 origin{ view.pos.x, view.pos.z };
+
+	//the rows still visible through every portal so far
+	int32_t top = 0;
+	int32_t bottom = height;
+
+	uint32_t sector_index = start_sector;
+
+	for (uint32_t depth = 0; depth < MAX_PORTAL_DEPTH; depth++)
+	{
+		const Sector& sector = sectors[sector_index];
+
+		//sectors are convex, so the ray leaves through the wall it hits furthest along
+		float exit_distance = -std::numeric_limits<float>::max();
+		float exit_pos = 0.0f;
+		size_t exit_edge = sector.vertices.size();
+
+		for (size_t i = 0; i < sector.vertices.size(); i++)
+		{
+			const glm::vec2 v1 = sector.vertices[i];
+			const glm::vec2 v2 = sector.vertices[i + 1 == sector.vertices.size() ? 0 : i + 1];
+
+			const glm::vec2 edge = v2 - v1;
+			const float denominator = cross2d(ray, edge);
+			if (denominator == 0.0f)
+			{
+				continue;
+			}
+
+			const glm::vec2 to_v1 = v1 - origin;
+			const float distance = cross2d(to_v1, edge) / denominator;
+			const float pos = cross2d(to_v1, ray) / denominator;
+
+			if (pos >= -EDGE_EPSILON && pos <= 1.0f + EDGE_EPSILON && distance > exit_distance)
+			{
+				exit_distance = distance;
+				exit_pos = std::clamp(pos, 0.0f, 1.0f);
+				exit_edge = i;
+			}
+		}
+
+		if (exit_edge == sector.vertices.size() || exit_distance <= 0.0f)
+		{
+			break;
+		}
+
+		const float distance = std::max(exit_distance, MIN_DISTANCE);
+		const float scale = view.focal / distance;
+
+		const int32_t ceil_end = row_at(view.horizon - (sector.ceil - view.pos.y) * scale, top, bottom);
+		const int32_t floor_start = row_at(view.horizon - (sector.floor - view.pos.y) * scale, ceil_end, bottom);
+
+		draw_flat(view, ray, x, top, ceil_end, sector.ceil, distance, clamp_layer(sector.ceil_type), -1.0f);
+		draw_flat(view, ray, x, floor_start, bottom, sector.floor, distance, clamp_layer(sector.floor_type), 1.0f);
+
+		const int32_t neighbor = sector.neighbors[exit_edge];
+		if (neighbor < 0 || static_cast<size_t>(neighbor) >= sectors.size())
+		{
+			draw_wall(view, sector, exit_edge, distance, exit_pos, ray, x, ceil_end, floor_start);
+			return;
+		}
+
+		//steps up and down into the neighbor use this sector's wall texture like the mesh does
+		const Sector& neighbor_sector = sectors[neighbor];
+
+		int32_t portal_top = ceil_end;
+		if (neighbor_sector.ceil < sector.ceil)
+		{
+			portal_top = row_at(view.horizon - (neighbor_sector.ceil - view.pos.y) * scale, ceil_end, floor_start);
+			draw_wall(view, sector, exit_edge, distance, exit_pos, ray, x, ceil_end, portal_top);
+		}
+
+		int32_t portal_bottom = floor_start;
+		if (neighbor_sector.floor > sector.floor)
+		{
+			portal_bottom = row_at(view.horizon - (neighbor_sector.floor - view.pos.y) * scale, portal_top, floor_start);
+			draw_wall(view, sector, exit_edge, distance, exit_pos, ray, x, portal_bottom, floor_start);
+		}
+
+		top = portal_top;
+		bottom = portal_bottom;
+
+		if (top >= bottom)
+		{
+			return;
+		}
+
+		sector_index = static_cast<uint32_t>(neighbor);
+	}
+
+	//ran out of portals or lost the ray in a broken sector
+	fill_column(x, top, bottom);
+}
+
+void PortalRenderer::draw_flat(const ColumnView& view, glm::vec2 ray, int32_t x, int32_t first_row, int32_t end_row, float plane_height, float max_distance,
+	uint32_t layer, float normal_y)
+{
+	const float height_above = (plane_height - view.pos.y) * view.focal;
+
+	for (int32_t y = first_row; y < end_row; y++)
+	{
+		//distance to where this row's ray meets the plane, rounding can push rows past the wall or over the horizon
+		const float rows_from_horizon = view.horizon - (static_cast<float>(y) + 0.5f);
+		float distance = rows_from_horizon != 0.0f ? height_above / rows_from_horizon : max_distance;
+		if (!(distance > 0.0f) || distance > max_distance)
+		{
+			distance = max_distance;
+		}
+
+		const glm::vec2 point = glm::vec2{ view.pos.x, view.pos.z } + ray * distance;
+
+		//the same attributes the sector mesh interpolates
+		const glm::vec3 frag_pos{ point.x, plane_height, point.y };
+		const glm::vec3 normal{ point.x, normal_y, point.y };
+
+		const glm::vec3 texel = textures.sample(layer, point / 8.0f);
+
+		color_buffer[static_cast<size_t>(y) * width + x] = pack_srgb(shade_fragment(texel, normal, frag_pos, view.pos));
+	}
+}
+
+void PortalRenderer::draw_wall(const ColumnView& view, const Sector& sector, size_t edge, float distance, float edge_pos, glm::vec2 ray, int32_t x,
+	int32_t first_row, int32_t end_row)
+{
+	const glm::vec2& v1 = sector.vertices[edge];
+	const glm::vec2& v2 = sector.vertices[edge + 1 == sector.vertices.size() ? 0 : edge + 1];
+
+	//the mesh gives every wall vertex this u, and it's interpolated linearly along the wall
+	const float u1 = ((v1.x + v1.y) * (v1.x - v1.y)) / 64.0f / 8.0f;
+	const float u2 = ((v2.x + v2.y) * (v2.x - v2.y)) / 64.0f / 8.0f;
+	const float u = u1 + (u2 - u1) * edge_pos;
+
+	const glm::vec2 point = glm::vec2{ view.pos.x, view.pos.z } + ray * distance;
+	const glm::vec3 normal{ (v2.y - v1.y), 0.0f, -(v2.x - v1.x) };
+
+	const uint32_t layer = clamp_layer(sector.wall_type);
+
+	//world height steps by the same amount every row
+	const float height_step = distance / view.focal;
+
+	for (int32_t y = first_row; y < end_row; y++)
+	{
+		const float frag_height = view.pos.y + (view.horizon - (static_cast<float>(y) + 0.5f)) * height_step;
+
+		const glm::vec3 frag_pos{ point.x, frag_height, point.y };
+
+		const glm::vec3 texel = textures.sample(layer, glm::vec2{ u, frag_height / 8.0f });
+
+		color_buffer[static_cast<size_t>(y) * width + x] = pack_srgb(shade_fragment(texel, normal, frag_pos, view.pos));
+	}
+}
+
+void PortalRenderer::fill_column(int32_t x, int32_t first_row, int32_t end_row)
+{
+	for (int32_t y = first_row; y < end_row; y++)
+	{
+		color_buffer[static_cast<size_t>(y) * width + x] = clear_color;
+	}
+}
+
+uint32_t PortalRenderer::clamp_layer(uint32_t layer) const
+{
+	return std::min<uint32_t>(layer, static_cast<uint32_t>(std::max<size_t>(textures.get_layer_count(), 1) - 1));
+}
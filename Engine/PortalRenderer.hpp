@@ -0,0 +1,99 @@
+#ifndef PORTAL_RENDERER_HPP
+#define PORTAL_RENDERER_HPP
+
+#include <vector>
+#include <cstdint>
+
+#include <glm/glm.hpp>
+
+#include "Sector.hpp"
+
+#include "SoftwareShading.hpp"
+
+class ThreadPool;
+
+//build engine style renderer, every screen column casts a ray from the player's sector and walks the portals front to back
+//each sector draws its ceiling, floor and steps between the column's clip window, then narrows the window for the next one
+//columns are independent, so strips of them are handed to the thread pool
+class PortalRenderer
+{
+public:
+	//columns given to a worker at a time, 16 rgba8 pixels fill a cache line so strips don't share lines
+	static constexpr int32_t STRIP_WIDTH = 16;
+
+	//how many portals a column can pass through, stops broken maps from looping forever
+	static constexpr uint32_t MAX_PORTAL_DEPTH = 256;
+
+private:
+	//the camera projected the same way as the gl renderer, 90 degree vertical fov with pitch turned into a y shear
+	struct ColumnView
+	{
+		glm::vec3 pos;
+		glm::vec2 front, right;
+
+		//pixels per unit at a distance of one
+		float focal;
+
+		//screen row of the eye's height
+		float horizon;
+	};
+
+	ThreadPool& thread_pool;
+
+	int32_t width = 0, height = 0;
+
+	//rgba8 in srgb, top row first
+	std::vector<uint32_t> color_buffer;
+
+	uint32_t clear_color = 0;
+
+	SoftwareTextureArray textures;
+
+	void draw_column(const std::vector<Sector>& sectors, uint32_t start_sector, const ColumnView& view, int32_t x);
+
+	//rows [first_row, end_row) of a floor or ceiling at the given height
+	void draw_flat(const ColumnView& view, glm::vec2 ray, int32_t x, int32_t first_row, int32_t end_row, float plane_height, float max_distance,
+		uint32_t layer, float normal_y);
+
+	//rows [first_row, end_row) of the wall hit at distance along ray, edge_pos is how far along the wall from v1 to v2
+	void draw_wall(const ColumnView& view, const Sector& sector, size_t edge, float distance, float edge_pos, glm::vec2 ray, int32_t x,
+		int32_t first_row, int32_t end_row);
+
+	void fill_column(int32_t x, int32_t first_row, int32_t end_row);
+
+	uint32_t clamp_layer(uint32_t layer) const;
+
+public:
+	explicit PortalRenderer(ThreadPool& thread_pool);
+
+	explicit PortalRenderer(PortalRenderer&) = delete;
+
+	PortalRenderer& operator=(PortalRenderer&) = delete;
+
+	void resize(int32_t width, int32_t height);
+
+	void load_textures(const std::vector<const char*>& texture_filenames, const size_t texture_width, const size_t texture_height);
+
+	//color is linear like glClearColor with GL_FRAMEBUFFER_SRGB
+	void set_clear_color(const glm::vec3& color);
+
+	//pitch is in degrees like the Player's, an invalid start sector only clears
+	void draw(const std::vector<Sector>& sectors, uint32_t start_sector, const glm::vec3& view_pos, glm::vec2 front2d, float pitch);
+
+	const std::vector<uint32_t>& get_pixels() const
+	{
+		return color_buffer;
+	}
+
+	int32_t get_width() const
+	{
+		return width;
+	}
+
+	int32_t get_height() const
+	{
+		return height;
+	}
+};
+
+#endif
@@ -0,0 +1,429 @@
+#include "Profiler.hpp"
+
+#ifdef SECTOR_PROFILER
+
+#include <stdexcept>
+#include <fstream>
+#include <atomic>
+#include <cstring>
+#include <algorithm>
+
+//highest frame time the graph shows, in milliseconds
+constexpr float GRAPH_SCALE_MS = 50.0f;
+
+//size of the graph on screen in pixels
+constexpr int32_t GRAPH_WIDTH = 480;
+constexpr int32_t GRAPH_HEIGHT = 160;
+constexpr int32_t GRAPH_MARGIN = 8;
+
+thread_local uint32_t ProfileZone::current_depth = 0;
+
+Profiler::Profiler()
+	: epoch(std::chrono::steady_clock::now())
+{
+	frame_zones.reserve(256);
+}
+
+Profiler& Profiler::get()
+{
+	static Profiler profiler;
+
+	return profiler;
+}
+
+int64_t Profiler::now() const
+{
+	return std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::steady_clock::now() - epoch).count();
+}
+
+uint32_t Profiler::thread_index()
+{
+	static std::atomic<uint32_t> thread_count{ 0 };
+	static thread_local const uint32_t index = thread_count.fetch_add(1);
+
+	return index;
+}
+
+void Profiler::init_gpu()
+{
+	for (auto& frame : gpu_frames)
+	{
+		glCreateQueries(GL_TIMESTAMP, static_cast<GLsizei>(frame.queries.size()), frame.queries.data());
+	}
+
+	//line the gpu clock up with ours
+	GLint64 gpu_now = 0;
+	glGetInteger64v(GL_TIMESTAMP, &gpu_now);
+	gpu_offset = now() - static_cast<int64_t>(gpu_now);
+
+	//the graph is drawn entirely in the fragment shader over one quad made from gl_VertexID
+	constexpr const char* vertex_shader_code =
+		"#version 430 core\n"
+		"layout(location = 0) uniform vec4 rect;"
+		"layout(location = 1) uniform vec2 screenSize;"
+		"void main()"
+		"{"
+		"	vec2 corner = vec2(gl_VertexID & 1, gl_VertexID >> 1);"
+		"	vec2 pixel = rect.xy + corner * rect.zw;"
+		"	gl_Position = vec4(pixel / screenSize * 2.0f - 1.0f, 0.0f, 1.0f);"
+		"}";
+
+	const std::string fragment_shader_code =
+		"#version 430 core\n"
+		"#define GRAPH_FRAMES " + std::to_string(GRAPH_FRAMES) + "\n"
+		"#define GRAPH_STAGES " + std::to_string(GRAPH_STAGES) + "\n"
+		"layout(binding = 0) uniform sampler2D graph;"
+		"layout(location = 0) uniform vec4 rect;"
+		"layout(location = 2) uniform int oldestColumn;"
+		"layout(location = 3) uniform float scaleMs;"
+		"layout(location = 0) out vec4 outColor;"
+		"const vec3 stageColors[4] = vec3[](vec3(0.2f, 0.8f, 0.2f), vec3(0.9f, 0.8f, 0.2f), vec3(0.9f, 0.4f, 0.1f), vec3(0.3f, 0.5f, 1.0f));"
+		"void main()"
+		"{"
+		"	vec2 position = (gl_FragCoord.xy - rect.xy) / rect.zw;"
+		"	int column = (oldestColumn + int(position.x * GRAPH_FRAMES)) % GRAPH_FRAMES;"
+		"	float ms = position.y * scaleMs;"
+		"	float pixelMs = scaleMs / rect.w;"
+		"	float cpu = texelFetch(graph, ivec2(column, 0), 0).r;"
+		"	float gpu = texelFetch(graph, ivec2(column, 1), 0).r;"
+		"	vec4 color = vec4(0.0f, 0.0f, 0.0f, 0.5f);"
+		"	if (ms < cpu)"
+		"	{"
+		"		color = vec4(0.6f, 0.6f, 0.6f, 0.9f);"
+		"		float stageBottom = 0.0f;"
+		"		for (int i = 0; i < GRAPH_STAGES; i++)"
+		"		{"
+		"			float stage = texelFetch(graph, ivec2(column, 2 + i), 0).r;"
+		"			if (ms >= stageBottom && ms < stageBottom + stage)"
+		"			{"
+		"				color = vec4(stageColors[i], 0.9f);"
+		"			}"
+		"			stageBottom += stage;"
+		"		}"
+		"	}"
+		"	if (gpu > 0.0f && abs(ms - gpu) < pixelMs)"
+		"	{"
+		"		color = vec4(1.0f, 0.2f, 1.0f, 1.0f);"
+		"	}"
+		"	if (abs(ms - 16.667f) < pixelMs * 0.5f || abs(ms - 33.333f) < pixelMs * 0.5f)"
+		"	{"
+		"		color = vec4(1.0f, 1.0f, 1.0f, 0.8f);"
+		"	}"
+		"	outColor = color;"
+		"}";
+
+	overlay_shader.emplace(vertex_shader_code, fragment_shader_code);
+
+	//core profile needs a vao bound even without any attributes
+	glCreateVertexArrays(1, &overlay_vao);
+
+	glCreateTextures(GL_TEXTURE_2D, 1, &graph_texture);
+	glTextureStorage2D(graph_texture, 1, GL_R32F, static_cast<GLsizei>(GRAPH_FRAMES), static_cast<GLsizei>(GRAPH_ROWS));
+
+	gpu_ready = true;
+}
+
+void Profiler::destroy_gpu()
+{
+	if (!gpu_ready)
+	{
+		return;
+	}
+
+	for (auto& frame : gpu_frames)
+	{
+		glDeleteQueries(static_cast<GLsizei>(frame.queries.size()), frame.queries.data());
+		frame.pending = false;
+	}
+
+	overlay_shader.reset();
+	glDeleteVertexArrays(1, &overlay_vao);
+	glDeleteTextures(1, &graph_texture);
+
+	overlay_vao = 0;
+	graph_texture = 0;
+
+	gpu_ready = false;
+}
+
+void Profiler::begin_frame()
+{
+	{
+		std::unique_lock<std::mutex> lock{ zone_mutex };
+
+		in_frame = true;
+		frame_start = now();
+		render_thread = thread_index();
+	}
+
+	if (gpu_ready)
+	{
+		auto& frame = gpu_frames[gpu_frame];
+		if (frame.pending)
+		{
+			collect_gpu_frame(frame);
+		}
+
+		frame.zone_count = 0;
+		frame.graph_column = graph_column;
+
+		begin_gpu_zone("Frame");
+	}
+}
+
+void Profiler::end_frame()
+{
+	if (gpu_ready)
+	{
+		auto& frame = gpu_frames[gpu_frame];
+
+		end_gpu_zone(0);
+		frame.pending = true;
+
+		gpu_frame = (gpu_frame + 1) % GPU_FRAME_LATENCY;
+	}
+
+	std::unique_lock<std::mutex> lock{ zone_mutex };
+
+	const int64_t frame_end = now();
+
+	//the gpu time shows up a few frames later
+	graph[graph_column] = static_cast<float>(frame_end - frame_start) / 1000000.0f;
+	graph[GRAPH_FRAMES + graph_column] = 0.0f;
+
+	for (size_t stage = 0; stage < GRAPH_STAGES; stage++)
+	{
+		graph[(2 + stage) * GRAPH_FRAMES + graph_column] = 0.0f;
+	}
+
+	for (const auto& zone : frame_zones)
+	{
+		if (zone.thread != render_thread || zone.depth != 0)
+		{
+			continue;
+		}
+
+		const size_t stage = stage_slot(zone.name);
+		if (stage < GRAPH_STAGES)
+		{
+			graph[(2 + stage) * GRAPH_FRAMES + graph_column] += static_cast<float>(zone.end - zone.start) / 1000000.0f;
+		}
+	}
+
+	graph_column = (graph_column + 1) % GRAPH_FRAMES;
+
+	if (capturing)
+	{
+		trace_zones.insert(trace_zones.end(), frame_zones.begin(), frame_zones.end());
+	}
+
+	frame_zones.clear();
+
+	in_frame = false;
+}
+
+size_t Profiler::stage_slot(const char* name)
+{
+	for (size_t i = 0; i < GRAPH_STAGES; i++)
+	{
+		if (stage_names[i] == nullptr)
+		{
+			stage_names[i] = name;
+			return i;
+		}
+
+		if (stage_names[i] == name || strcmp(stage_names[i], name) == 0)
+		{
+			return i;
+		}
+	}
+
+	//out of colors, it just counts towards the grey part of the bar
+	return GRAPH_STAGES;
+}
+
+void Profiler::add_zone(const char* name, uint32_t depth, int64_t start, int64_t end)
+{
+	std::unique_lock<std::mutex> lock{ zone_mutex };
+
+	//outside of frames nobody would ever clear the zones
+	if (!in_frame && !capturing)
+	{
+		return;
+	}
+
+	const CpuZone zone{ name, thread_index(), depth, start, end };
+
+	if (in_frame)
+	{
+		frame_zones.push_back(zone);
+	}
+	else
+	{
+		trace_zones.push_back(zone);
+	}
+}
+
+size_t Profiler::begin_gpu_zone(const char* name)
+{
+	if (!gpu_ready || !in_frame || thread_index() != render_thread)
+	{
+		return INVALID_GPU_ZONE;
+	}
+
+	auto& frame = gpu_frames[gpu_frame];
+	if (frame.zone_count >= MAX_GPU_ZONES)
+	{
+		return INVALID_GPU_ZONE;
+	}
+
+	const size_t zone = frame.zone_count++;
+
+	frame.names[zone] = name;
+	glQueryCounter(frame.queries[zone * 2], GL_TIMESTAMP);
+
+	return zone;
+}
+
+void Profiler::end_gpu_zone(size_t zone)
+{
+	if (zone == INVALID_GPU_ZONE)
+	{
+		return;
+	}
+
+	glQueryCounter(gpu_frames[gpu_frame].queries[zone * 2 + 1], GL_TIMESTAMP);
+}
+
+void Profiler::collect_gpu_frame(GpuFrame& frame)
+{
+	frame.pending = false;
+
+	if (frame.zone_count == 0)
+	{
+		return;
+	}
+
+	std::array<GLuint64, MAX_GPU_ZONES * 2> timestamps{};
+	for (size_t i = 0; i < frame.zone_count * 2; i++)
+	{
+		glGetQueryObjectui64v(frame.queries[i], GL_QUERY_RESULT, &timestamps[i]);
+	}
+
+	graph[GRAPH_FRAMES + frame.graph_column] = static_cast<float>(timestamps[1] - timestamps[0]) / 1000000.0f;
+
+	if (capturing)
+	{
+		for (size_t i = 0; i < frame.zone_count; i++)
+		{
+			trace_gpu_zones.push_back(GpuZone
+				{
+					frame.names[i],
+					static_cast<int64_t>(timestamps[i * 2]) + gpu_offset,
+					static_cast<int64_t>(timestamps[i * 2 + 1]) + gpu_offset
+				});
+		}
+	}
+}
+
+void Profiler::start_trace()
+{
+	std::unique_lock<std::mutex> lock{ zone_mutex };
+
+	trace_zones.clear();
+	trace_gpu_zones.clear();
+
+	capturing = true;
+}
+
+void Profiler::stop_trace(const std::string& filename)
+{
+	std::unique_lock<std::mutex> lock{ zone_mutex };
+
+	capturing = false;
+
+	std::ofstream file{ filename };
+	if (!file.is_open())
+	{
+		throw std::runtime_error("Failed to open trace file " + filename);
+	}
+
+	uint32_t thread_count = 0;
+	for (const auto& zone : trace_zones)
+	{
+		thread_count = std::max(thread_count, zone.thread + 1);
+	}
+
+	//chrome trace timestamps are in microseconds
+	file << "{\"displayTimeUnit\":\"ms\",\"traceEvents\":[\n";
+	file << "{\"name\":\"process_name\",\"ph\":\"M\",\"pid\":0,\"args\":{\"name\":\"CPU\"}},\n";
+	file << "{\"name\":\"process_name\",\"ph\":\"M\",\"pid\":1,\"args\":{\"name\":\"GPU\"}}";
+
+	for (uint32_t thread = 0; thread < thread_count; thread++)
+	{
+		file << ",\n{\"name\":\"thread_name\",\"ph\":\"M\",\"pid\":0,\"tid\":" << thread
+			<< ",\"args\":{\"name\":\"" << (thread == render_thread ? "Render thread" : "Thread " + std::to_string(thread)) << "\"}}";
+	}
+
+	for (const auto& zone : trace_zones)
+	{
+		file << ",\n{\"name\":\"" << zone.name << "\",\"cat\":\"cpu\",\"ph\":\"X\",\"pid\":0,\"tid\":" << zone.thread
+			<< ",\"ts\":" << static_cast<double>(zone.start) / 1000.0
+			<< ",\"dur\":" << static_cast<double>(zone.end - zone.start) / 1000.0 << "}";
+	}
+
+	for (const auto& zone : trace_gpu_zones)
+	{
+		file << ",\n{\"name\":\"" << zone.name << "\",\"cat\":\"gpu\",\"ph\":\"X\",\"pid\":1,\"tid\":0"
+			<< ",\"ts\":" << static_cast<double>(zone.start) / 1000.0
+			<< ",\"dur\":" << static_cast<double>(zone.end - zone.start) / 1000.0 << "}";
+	}
+
+	file << "\n]}\n";
+
+	trace_zones.clear();
+	trace_gpu_zones.clear();
+}
+
+void Profiler::toggle_overlay()
+{
+	show_overlay = !show_overlay;
+}
+
+void Profiler::draw_overlay(int32_t width, int32_t height)
+{
+	if (!show_overlay || !gpu_ready)
+	{
+		return;
+	}
+
+	{
+		std::unique_lock<std::mutex> lock{ zone_mutex };
+
+		glTextureSubImage2D(graph_texture, 0, 0, 0, static_cast<GLsizei>(GRAPH_FRAMES), static_cast<GLsizei>(GRAPH_ROWS), GL_RED, GL_FLOAT, graph.data());
+	}
+
+	glDisable(GL_DEPTH_TEST);
+	glEnable(GL_BLEND);
+	glBlendFunc(GL_SRC_ALPHA, GL_ONE_MINUS_SRC_ALPHA);
+
+	overlay_shader->use();
+
+	const float rect_x = static_cast<float>(GRAPH_MARGIN);
+	const float rect_y = static_cast<float>(height - GRAPH_HEIGHT - GRAPH_MARGIN);
+
+	glProgramUniform4f(overlay_shader->program, 0, rect_x, rect_y, static_cast<float>(GRAPH_WIDTH), static_cast<float>(GRAPH_HEIGHT));
+	glProgramUniform2f(overlay_shader->program, 1, static_cast<float>(width), static_cast<float>(height));
+	glProgramUniform1i(overlay_shader->program, 2, static_cast<GLint>(graph_column));
+	glProgramUniform1f(overlay_shader->program, 3, GRAPH_SCALE_MS);
+
+	glBindTextureUnit(0, graph_texture);
+	glBindVertexArray(overlay_vao);
+
+	glDrawArrays(GL_TRIANGLE_STRIP, 0, 4);
+
+	glDisable(GL_BLEND);
+	glEnable(GL_DEPTH_TEST);
+}
+
+#endif
@@ -0,0 +1,214 @@
+#ifndef PROFILER_HPP
+#define PROFILER_HPP
+
+//zones are recorded in debug builds, release builds only get them when compiled with SECTOR_ENABLE_PROFILER
+#if !defined(NDEBUG) || defined(SECTOR_ENABLE_PROFILER)
+#define SECTOR_PROFILER
+#endif
+
+#ifdef SECTOR_PROFILER
+
+#include <vector>
+#include <string>
+#include <array>
+#include <mutex>
+#include <chrono>
+#include <optional>
+#include <cstdint>
+
+#include <glad/glad.h>
+
+#include "RasterShaderProgram.hpp"
+
+//collects cpu zones from any thread and gpu zones from the render thread,
+//keeps a rolling frame time graph and can capture everything into a chrome trace (chrome://tracing or ui.perfetto.dev)
+class Profiler
+{
+public:
+	//frames kept for the on screen graph
+	static constexpr size_t GRAPH_FRAMES = 240;
+
+	//top level zones on the render thread that get their own color in the graph
+	static constexpr size_t GRAPH_STAGES = 4;
+
+	static constexpr size_t INVALID_GPU_ZONE = SIZE_MAX;
+
+private:
+	//gpu results are read back this many frames later so reading them never stalls
+	static constexpr size_t GPU_FRAME_LATENCY = 4;
+
+	static constexpr size_t MAX_GPU_ZONES = 32;
+
+	//times are in nanoseconds since the profiler was created
+	struct CpuZone
+	{
+		const char* name;
+		uint32_t thread;
+		uint32_t depth;
+		int64_t start, end;
+	};
+
+	struct GpuZone
+	{
+		const char* name;
+		int64_t start, end;
+	};
+
+	//zone 0 of every gpu frame covers the whole frame
+	struct GpuFrame
+	{
+		std::array<GLuint, MAX_GPU_ZONES * 2> queries{};
+		std::array<const char*, MAX_GPU_ZONES> names{};
+		size_t zone_count = 0;
+
+		size_t graph_column = 0;
+		bool pending = false;
+	};
+
+	std::chrono::steady_clock::time_point epoch;
+
+	//guards everything cpu zones touch
+	std::mutex zone_mutex;
+
+	std::vector<CpuZone> frame_zones;
+
+	bool in_frame = false;
+	int64_t frame_start = 0;
+	uint32_t render_thread = 0;
+
+	bool capturing = false;
+	std::vector<CpuZone> trace_zones;
+	std::vector<GpuZone> trace_gpu_zones;
+
+	std::array<const char*, GRAPH_STAGES> stage_names{};
+
+	//rows of the graph texture: cpu frame time, gpu frame time, then one per stage
+	static constexpr size_t GRAPH_ROWS = 2 + GRAPH_STAGES;
+	std::array<float, GRAPH_FRAMES * GRAPH_ROWS> graph{};
+	size_t graph_column = 0;
+
+	std::array<GpuFrame, GPU_FRAME_LATENCY> gpu_frames;
+	size_t gpu_frame = 0;
+	bool gpu_ready = false;
+
+	//cpu time minus gpu time, to put gpu zones on the same timeline as cpu zones
+	int64_t gpu_offset = 0;
+
+	bool show_overlay = false;
+	//optional so the static profiler never touches OpenGL after the context is gone
+	std::optional<RasterShaderProgram> overlay_shader;
+	GLuint overlay_vao = 0;
+	GLuint graph_texture = 0;
+
+	explicit Profiler();
+
+	void collect_gpu_frame(GpuFrame& frame);
+
+	size_t stage_slot(const char* name);
+
+public:
+	static Profiler& get();
+
+	explicit Profiler(Profiler&) = delete;
+
+	Profiler& operator=(Profiler&) = delete;
+
+	int64_t now() const;
+
+	//small number identifying the calling thread in traces
+	static uint32_t thread_index();
+
+	//these need the OpenGL context to be current
+	void init_gpu();
+
+	void destroy_gpu();
+
+	void begin_frame();
+
+	void end_frame();
+
+	void add_zone(const char* name, uint32_t depth, int64_t start, int64_t end);
+
+	//gpu zones can only be used on the render thread between begin_frame and end_frame
+	size_t begin_gpu_zone(const char* name);
+
+	void end_gpu_zone(size_t zone);
+
+	void start_trace();
+
+	//writes everything recorded since start_trace
+	void stop_trace(const std::string& filename);
+
+	bool is_tracing() const
+	{
+		return capturing;
+	}
+
+	void toggle_overlay();
+
+	void draw_overlay(int32_t width, int32_t height);
+};
+
+class ProfileZone
+{
+	const char* name;
+	int64_t start;
+	uint32_t depth;
+
+	static thread_local uint32_t current_depth;
+
+public:
+	explicit ProfileZone(const char* name)
+		: name(name), start(Profiler::get().now()), depth(current_depth++)
+	{
+	}
+
+	~ProfileZone()
+	{
+		current_depth--;
+
+		Profiler::get().add_zone(name, depth, start, Profiler::get().now());
+	}
+
+	explicit ProfileZone(ProfileZone&) = delete;
+
+	ProfileZone& operator=(ProfileZone&) = delete;
+};
+
+class GpuProfileZone
+{
+	size_t zone;
+
+public:
+	explicit GpuProfileZone(const char* name)
+		: zone(Profiler::get().begin_gpu_zone(name))
+	{
+	}
+
+	~GpuProfileZone()
+	{
+		Profiler::get().end_gpu_zone(zone);
+	}
+
+	explicit GpuProfileZone(GpuProfileZone&) = delete;
+
+	GpuProfileZone& operator=(GpuProfileZone&) = delete;
+};
+
+#define PROFILE_CONCAT_INNER(a, b) a##b
+#define PROFILE_CONCAT(a, b) PROFILE_CONCAT_INNER(a, b)
+
+//times the rest of the enclosing scope, name must be a string literal
+#define PROFILE_ZONE(name) ProfileZone PROFILE_CONCAT(profile_zone_, __LINE__){ name }
+
+#define PROFILE_GPU_ZONE(name) GpuProfileZone PROFILE_CONCAT(gpu_profile_zone_, __LINE__){ name }
+
+#else
+
+#define PROFILE_ZONE(name)
+
+#define PROFILE_GPU_ZONE(name)
+
+#endif
+
+#endif
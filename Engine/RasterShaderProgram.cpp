@@ -72,5 +72,9 @@ RasterShaderProgram::RasterShaderProgram(std::string_view vertex_shader_code, st
 
 RasterShaderProgram::~RasterShaderProgram()
 {
-	glDeleteProgram(program);
+	//the software renderer never loads OpenGL, so don't call into it for empty programs
+	if (program)
+	{
+		glDeleteProgram(program);
+	}
 }
\ No newline at end of file
@@ -11,7 +11,7 @@
 class RasterShaderProgram
 {
 public:
-	GLuint program;
+	GLuint program = 0;
 
 	inline void use() const { glUseProgram(program); }
 
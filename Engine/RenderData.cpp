@@ -3,41 +3,255 @@
 #include <stdexcept>
 #include <string>
 #include <cstring>
+#include <array>
+#include <algorithm>
+#include <cmath>
+#include <mutex>
 
 #include "stb_image.h"
 
+#include "ThreadPool.hpp"
+#include "Profiler.hpp"
+#include "TextureCache.hpp"
+
+//from EXT_texture_sRGB, glad only has the core formats
+#ifndef GL_COMPRESSED_SRGB_S3TC_DXT1_EXT
+#define GL_COMPRESSED_SRGB_S3TC_DXT1_EXT 0x8C4C
+#endif
+
+//layers that can be waiting on the gpu in the upload ring at once
+constexpr size_t UPLOAD_SLOTS = 3;
+
+//commands the stream starts with room for every frame, it grows if a frame needs more
+constexpr size_t INITIAL_DRAW_COMMANDS = 1024;
+
+//placeholder color of layers that haven't been uploaded yet
+constexpr std::array<unsigned char, 3> PLACEHOLDER_COLOR{ 128, 128, 128 };
+
+struct DecodedLayer
+{
+	size_t layer;
+
+	//from stbi_load, null if decoding failed
+	unsigned char* pixels;
+
+	std::string error;
+};
+
+struct TextureStream
+{
+	ThreadPool* thread_pool;
+
+	//copied since the caller's strings don't live as long as the decode jobs
+	std::vector<std::string> filenames;
+	size_t width, height;
+	size_t layer_size;
+
+	//filled by the decode jobs
+	std::mutex decoded_mutex;
+	std::vector<DecodedLayer> decoded;
+
+	//only touched by the gl thread, layers waiting on a free upload slot
+	std::vector<DecodedLayer> ready;
+	size_t remaining;
+
+	//persistently mapped pixel unpack buffer split into UPLOAD_SLOTS layers
+	GLuint pixel_buffer = 0;
+	unsigned char* mapped = nullptr;
+	std::array<GLsync, UPLOAD_SLOTS> fences{};
+	size_t next_slot = 0;
+
+	TaskGroup decode_group;
+
+	explicit TextureStream(ThreadPool& thread_pool)
+		: thread_pool(&thread_pool), decode_group(thread_pool)
+	{
+	}
+
+	~TextureStream()
+	{
+		//the jobs write into this, so they have to be finished before anything goes away
+		decode_group.wait();
+
+		for (auto& layer : ready)
+		{
+			stbi_image_free(layer.pixels);
+		}
+
+		for (auto& layer : decoded)
+		{
+			stbi_image_free(layer.pixels);
+		}
+
+		for (auto fence : fences)
+		{
+			if (fence)
+			{
+				glDeleteSync(fence);
+			}
+		}
+
+		if (pixel_buffer)
+		{
+			glUnmapNamedBuffer(pixel_buffer);
+			glDeleteBuffers(1, &pixel_buffer);
+		}
+	}
+
+	explicit TextureStream(TextureStream&) = delete;
+
+	TextureStream& operator=(TextureStream&) = delete;
+
+	void decode(size_t layer)
+	{
+		PROFILE_ZONE("stbi_load");
+
+		DecodedLayer result{ layer, nullptr, "" };
+
+		int texture_width, texture_height, nr_channels;
+		result.pixels = stbi_load(filenames[layer].c_str(), &texture_width, &texture_height, &nr_channels, 3);
+
+		if (nullptr == result.pixels)
+		{
+			result.error = "Failed to load texture from file " + filenames[layer];
+		}
+		else if (texture_width != static_cast<int>(width) || texture_height != static_cast<int>(height))
+		{
+			stbi_image_free(result.pixels);
+			result.pixels = nullptr;
+
+			result.error = "texture " + filenames[layer] + " is not of size (" + std::to_string(width) + " x " + std::to_string(height) + ")";
+		}
+
+		std::unique_lock<std::mutex> lock{ decoded_mutex };
+
+		decoded.push_back(std::move(result));
+	}
+};
+
+static uint32_t pack_snorm10(float value)
+{
+	return static_cast<uint32_t>(static_cast<int32_t>(std::lround(std::clamp(value, -1.0f, 1.0f) * 511.0f))) & 0x3FF;
+}
+
+uint32_t pack_normal(const glm::vec3& normal)
+{
+	//sector floors and ceilings have the normal (x, 1, z) or (x, -1, z), which can't be stored normalized,
+	//walls have y = 0 and are the same along the whole wall, so normalizing them doesn't change the lighting
+	if (normal.y != 0.0f)
+	{
+		const uint32_t sign = normal.y > 0.0f ? 1u : 3u;
+
+		return pack_snorm10(0.0f) | (pack_snorm10(normal.y > 0.0f ? 1.0f : -1.0f) << 10) | (pack_snorm10(0.0f) << 20) | (sign << 30);
+	}
+
+	const float length = std::sqrt(normal.x * normal.x + normal.z * normal.z);
+	const glm::vec3 normalized = length > 0.0f ? normal / length : glm::vec3{ 0.0f };
+
+	return pack_snorm10(normalized.x) | (pack_snorm10(normalized.y) << 10) | (pack_snorm10(normalized.z) << 20);
+}
+
+PackedVertex pack_vertex(const Vertex& vertex)
+{
+	PackedVertex packed;
+	packed.pos = vertex.pos;
+	packed.tex_coord = vertex.tex_coord;
+	packed.normal = pack_normal(vertex.normal);
+	packed.tex_index = static_cast<uint16_t>(std::clamp(std::lround(vertex.tex_index), 0l, 65535l));
+	packed.padding = 0;
+
+	return packed;
+}
+
+//a new buffer with the same contents, copied on the gpu without going through system memory
+static GLuint duplicate_buffer(GLuint buffer, GLenum usage)
+{
+	GLint buffer_size = 0;
+	glGetNamedBufferParameteriv(buffer, GL_BUFFER_SIZE, &buffer_size);
+
+	GLuint copy = 0;
+	glCreateBuffers(1, &copy);
+	glNamedBufferData(copy, buffer_size, nullptr, usage);
+
+	if (buffer_size > 0)
+	{
+		glCopyNamedBufferSubData(buffer, copy, 0, 0, buffer_size);
+	}
+
+	return copy;
+}
+
 Mesh::Mesh(const std::vector<Vertex>& vertices, const std::vector<uint32_t>& indices)
 {
+	std::vector<PackedVertex> packed_vertices(vertices.size());
+	std::transform(vertices.begin(), vertices.end(), packed_vertices.begin(), pack_vertex);
+
 	glCreateVertexArrays(1, &vao);
 	glCreateBuffers(1, &vbo_vertices);
 	glCreateBuffers(1, &ebo);
 
-	glVertexArrayElementBuffer(vao, ebo);
 	glNamedBufferData(ebo, indices.size() * sizeof(uint32_t), indices.data(), GL_STATIC_DRAW);
+	glNamedBufferData(vbo_vertices, packed_vertices.size() * sizeof(PackedVertex), packed_vertices.data(), GL_STATIC_DRAW);
 
-	glVertexArrayVertexBuffer(vao, 0, vbo_vertices, 0, sizeof(Vertex));
-	glNamedBufferData(vbo_vertices, vertices.size() * sizeof(Vertex), vertices.data(), GL_STATIC_DRAW);
+	setup_vertex_array();
+
+	size = static_cast<GLsizei>(indices.size());
+}
+
+static GpuSectorData make_gpu_sector_data(const Sector& sector)
+{
+	return GpuSectorData{ sector.floor, sector.ceil, sector.wall_type, sector.ceil_type, sector.floor_type };
+}
+
+Mesh::Mesh(const std::vector<PulledVertex>& vertices, const std::vector<uint32_t>& indices, const std::vector<Sector>& sectors)
+{
+	std::vector<GpuSectorData> sector_data(sectors.size());
+	std::transform(sectors.begin(), sectors.end(), sector_data.begin(), make_gpu_sector_data);
+
+	glCreateVertexArrays(1, &vao);
+	glCreateBuffers(1, &vbo_vertices);
+	glCreateBuffers(1, &ebo);
+	glCreateBuffers(1, &sector_buffer);
+
+	//storage buffers can't be bound empty
+	glNamedBufferData(ebo, indices.size() * sizeof(uint32_t), indices.data(), GL_STATIC_DRAW);
+	glNamedBufferData(vbo_vertices, std::max<size_t>(vertices.size(), 1) * sizeof(PulledVertex), vertices.empty() ? nullptr : vertices.data(), GL_STATIC_DRAW);
+	glNamedBufferData(sector_buffer, std::max<size_t>(sector_data.size(), 1) * sizeof(GpuSectorData), sector_data.empty() ? nullptr : sector_data.data(), GL_DYNAMIC_DRAW);
+
+	glVertexArrayElementBuffer(vao, ebo);
+
+	size = static_cast<GLsizei>(indices.size());
+}
+
+void Mesh::setup_vertex_array()
+{
+	glVertexArrayElementBuffer(vao, ebo);
+
+	glVertexArrayVertexBuffer(vao, 0, vbo_vertices, 0, sizeof(PackedVertex));
 
 	glVertexArrayAttribBinding(vao, 0, 0);
 	glEnableVertexArrayAttrib(vao, 0);
-	glVertexArrayAttribFormat(vao, 0, 3, GL_FLOAT, GL_FALSE, offsetof(Vertex, pos));
+	glVertexArrayAttribFormat(vao, 0, 3, GL_FLOAT, GL_FALSE, offsetof(PackedVertex, pos));
 
 	glVertexArrayAttribBinding(vao, 1, 0);
 	glEnableVertexArrayAttrib(vao, 1);
-	glVertexArrayAttribFormat(vao, 1, 2, GL_FLOAT, GL_FALSE, offsetof(Vertex, tex_coord));
+	glVertexArrayAttribFormat(vao, 1, 2, GL_FLOAT, GL_FALSE, offsetof(PackedVertex, tex_coord));
 
 	glVertexArrayAttribBinding(vao, 2, 0);
 	glEnableVertexArrayAttrib(vao, 2);
-	glVertexArrayAttribFormat(vao, 2, 1, GL_FLOAT, GL_FALSE, offsetof(Vertex, tex_index));
+	glVertexArrayAttribIFormat(vao, 2, 1, GL_UNSIGNED_SHORT, offsetof(PackedVertex, tex_index));
 
 	glVertexArrayAttribBinding(vao, 3, 0);
 	glEnableVertexArrayAttrib(vao, 3);
-	glVertexArrayAttribFormat(vao, 3, 3, GL_FLOAT, GL_FALSE, offsetof(Vertex, normal));
-
-	size = static_cast<GLsizei>(indices.size());
+	glVertexArrayAttribFormat(vao, 3, 4, GL_INT_2_10_10_10_REV, GL_TRUE, offsetof(PackedVertex, normal));
 }
 
 Mesh::~Mesh()
+{
+	release();
+}
+
+void Mesh::release()
 {
 	if (vao)
 	{
@@ -45,13 +259,25 @@ Mesh::~Mesh()
 		glDeleteBuffers(1, &vbo_vertices);
 		glDeleteVertexArrays(1, &vao);
 	}
+
+	if (sector_buffer)
+	{
+		glDeleteBuffers(1, &sector_buffer);
+	}
+
+	vao = 0;
+	vbo_vertices = 0;
+	sector_buffer = 0;
+	ebo = 0;
+	size = 0;
 }
 
 Mesh::Mesh(Mesh&& o) noexcept
-	: vao(o.vao), ebo(o.ebo), vbo_vertices(o.vbo_vertices), size(o.size)
+	: vao(o.vao), ebo(o.ebo), vbo_vertices(o.vbo_vertices), sector_buffer(o.sector_buffer), size(o.size)
 {
 	o.vao = 0;
 	o.vbo_vertices = 0;
+	o.sector_buffer = 0;
 	o.ebo = 0;
 	o.size = 0;
 }
@@ -63,181 +289,259 @@ Mesh& Mesh::operator=(Mesh&& o) noexcept
 		return *this;
 	}
 
+	release();
+
 	vao = o.vao;
 	vbo_vertices = o.vbo_vertices;
+	sector_buffer = o.sector_buffer;
 	ebo = o.ebo;
 	size = o.size;
 
 	o.vao = 0;
 	o.vbo_vertices = 0;
+	o.sector_buffer = 0;
 	o.ebo = 0;
 	o.size = 0;
 
 	return *this;
 }
 
-Mesh::Mesh(Mesh& other)
+Mesh::Mesh(const Mesh& other)
 {
-	std::vector<Vertex> vertices;
-	std::vector<uint32_t> indices;
+	copy_from(other);
+}
 
-	if (other.vao)
+Mesh& Mesh::operator=(const Mesh& other)
+{
+	if (&other == this)
 	{
-		GLint vbo_size = 0;
-		glGetNamedBufferParameteriv(other.vbo_vertices, GL_BUFFER_SIZE, &vbo_size);
+		return *this;
+	}
+
+	release();
 
-		vertices.resize(static_cast<size_t>(vbo_size));
+	copy_from(other);
 
-		GLvoid* buffer_ptr = glMapNamedBuffer(other.vbo_vertices, GL_READ_ONLY);
-		memcpy(vertices.data(), buffer_ptr, vertices.size());
-		glUnmapNamedBuffer(other.vbo_vertices);
+	return *this;
+}
+
+void Mesh::copy_from(const Mesh& other)
+{
+	if (!other.vao)
+	{
+		return;
+	}
 
-		indices.resize(static_cast<size_t>(other.size));
+	//copied as bytes, so it works for either vertex format
+	vbo_vertices = duplicate_buffer(other.vbo_vertices, GL_STATIC_DRAW);
+	ebo = duplicate_buffer(other.ebo, GL_STATIC_DRAW);
 
-		buffer_ptr = glMapNamedBuffer(other.ebo, GL_READ_ONLY);
-		memcpy(indices.data(), buffer_ptr, indices.size());
-		glUnmapNamedBuffer(other.ebo);
+	glCreateVertexArrays(1, &vao);
 
-		//create objects using data
-		glCreateVertexArrays(1, &vao);
-		glCreateBuffers(1, &vbo_vertices);
-		glCreateBuffers(1, &ebo);
+	if (other.sector_buffer)
+	{
+		sector_buffer = duplicate_buffer(other.sector_buffer, GL_DYNAMIC_DRAW);
 
 		glVertexArrayElementBuffer(vao, ebo);
-		glNamedBufferData(ebo, indices.size() * sizeof(uint32_t), indices.data(), GL_STATIC_DRAW);
+	}
+	else
+	{
+		setup_vertex_array();
+	}
 
-		glVertexArrayVertexBuffer(vao, 0, vbo_vertices, 0, sizeof(Vertex));
-		glNamedBufferData(vbo_vertices, vertices.size() * sizeof(Vertex), vertices.data(), GL_STATIC_DRAW);
+	size = other.size;
+}
 
-		glVertexArrayAttribBinding(vao, 0, 0);
-		glEnableVertexArrayAttrib(vao, 0);
-		glVertexArrayAttribFormat(vao, 0, 3, GL_FLOAT, GL_FALSE, offsetof(Vertex, pos));
+void Mesh::bind() const
+{
+	if (vao)
+	{
+		glBindVertexArray(vao);
 
-		glVertexArrayAttribBinding(vao, 1, 0);
-		glEnableVertexArrayAttrib(vao, 1);
-		glVertexArrayAttribFormat(vao, 1, 2, GL_FLOAT, GL_FALSE, offsetof(Vertex, tex_coord));
+		if (sector_buffer)
+		{
+			glBindBufferBase(GL_SHADER_STORAGE_BUFFER, 0, vbo_vertices);
+			glBindBufferBase(GL_SHADER_STORAGE_BUFFER, 1, sector_buffer);
+		}
+	}
+	else
+	{
+		throw std::runtime_error("Tried to bind blank VAO");
+	}
+}
 
-		glVertexArrayAttribBinding(vao, 2, 0);
-		glEnableVertexArrayAttrib(vao, 2);
-		glVertexArrayAttribFormat(vao, 2, 1, GL_FLOAT, GL_FALSE, offsetof(Vertex, tex_index));
+void Mesh::draw() const
+{
+	if (vao)
+	{
+		bind();
 
-		size = static_cast<GLsizei>(indices.size());
+		glDrawElements(GL_TRIANGLES, size, GL_UNSIGNED_INT, nullptr);
 	}
 	else
 	{
-		vao = 0;
-		vbo_vertices = 0;
-		ebo = 0;
-		size = 0;
+		throw std::runtime_error("Tried to draw with blank VAO");
 	}
 }
 
-Mesh& Mesh::operator=(Mesh& other)
+void Mesh::draw_indirect(const DrawCommandBuffer& commands) const
 {
-	if (&other == this)
+	if (vao)
 	{
-		return *this;
-	}
+		bind();
 
-	std::vector<Vertex> vertices;
-	std::vector<uint32_t> indices;
+		commands.bind();
 
-	if (other.vao)
+		glMultiDrawElementsIndirect(GL_TRIANGLES, GL_UNSIGNED_INT, reinterpret_cast<const void*>(commands.get_offset()), commands.get_count(), 0);
+	}
+	else
 	{
-		GLint vbo_size = 0;
-		glGetNamedBufferParameteriv(other.vbo_vertices, GL_BUFFER_SIZE, &vbo_size);
+		throw std::runtime_error("Tried to draw with blank VAO");
+	}
+}
 
-		vertices.resize(static_cast<size_t>(vbo_size));
+void Mesh::update_vertices(size_t first_vertex, const std::vector<Vertex>& vertices)
+{
+	if (!vao || sector_buffer)
+	{
+		throw std::runtime_error("Tried to update the vertices of a mesh without PackedVertex");
+	}
 
-		GLvoid* buffer_ptr = glMapNamedBuffer(other.vbo_vertices, GL_READ_ONLY);
-		memcpy(vertices.data(), buffer_ptr, vertices.size());
-		glUnmapNamedBuffer(other.vbo_vertices);
+	std::vector<PackedVertex> packed_vertices(vertices.size());
+	std::transform(vertices.begin(), vertices.end(), packed_vertices.begin(), pack_vertex);
 
-		indices.resize(static_cast<size_t>(other.size));
+	glNamedBufferSubData(vbo_vertices, first_vertex * sizeof(PackedVertex), packed_vertices.size() * sizeof(PackedVertex), packed_vertices.data());
+}
 
-		buffer_ptr = glMapNamedBuffer(other.ebo, GL_READ_ONLY);
-		memcpy(indices.data(), buffer_ptr, indices.size());
-		glUnmapNamedBuffer(other.ebo);
+void Mesh::update_vertices(size_t first_vertex, const std::vector<PulledVertex>& vertices)
+{
+	if (!sector_buffer)
+	{
+		throw std::runtime_error("Tried to update the vertices of a mesh without PulledVertex");
+	}
 
-		//create objects using data
-		glCreateVertexArrays(1, &vao);
-		glCreateBuffers(1, &vbo_vertices);
-		glCreateBuffers(1, &ebo);
+	glNamedBufferSubData(vbo_vertices, first_vertex * sizeof(PulledVertex), vertices.size() * sizeof(PulledVertex), vertices.data());
+}
 
-		glVertexArrayElementBuffer(vao, ebo);
-		glNamedBufferData(ebo, indices.size() * sizeof(uint32_t), indices.data(), GL_STATIC_DRAW);
+void Mesh::update_indices(size_t first_index, const std::vector<uint32_t>& indices)
+{
+	if (!vao)
+	{
+		throw std::runtime_error("Tried to update blank mesh");
+	}
 
-		glVertexArrayVertexBuffer(vao, 0, vbo_vertices, 0, sizeof(Vertex));
-		glNamedBufferData(vbo_vertices, vertices.size() * sizeof(Vertex), vertices.data(), GL_STATIC_DRAW);
+	glNamedBufferSubData(ebo, first_index * sizeof(uint32_t), indices.size() * sizeof(uint32_t), indices.data());
+}
 
-		glVertexArrayAttribBinding(vao, 0, 0);
-		glEnableVertexArrayAttrib(vao, 0);
-		glVertexArrayAttribFormat(vao, 0, 3, GL_FLOAT, GL_FALSE, offsetof(Vertex, pos));
+void Mesh::update_sector(size_t sector_index, const Sector& sector)
+{
+	if (!sector_buffer)
+	{
+		throw std::runtime_error("Tried to update the sectors of a mesh without PulledVertex");
+	}
 
-		glVertexArrayAttribBinding(vao, 1, 0);
-		glEnableVertexArrayAttrib(vao, 1);
-		glVertexArrayAttribFormat(vao, 1, 2, GL_FLOAT, GL_FALSE, offsetof(Vertex, tex_coord));
+	const GpuSectorData data = make_gpu_sector_data(sector);
 
-		glVertexArrayAttribBinding(vao, 2, 0);
-		glEnableVertexArrayAttrib(vao, 2);
-		glVertexArrayAttribFormat(vao, 2, 1, GL_FLOAT, GL_FALSE, offsetof(Vertex, tex_index));
+	glNamedBufferSubData(sector_buffer, sector_index * sizeof(GpuSectorData), sizeof(GpuSectorData), &data);
+}
 
-		size = static_cast<GLsizei>(indices.size());
-	}
-	else
+void DrawCommandBuffer::upload(const std::vector<DrawElementsIndirectCommand>& commands)
+{
+	if (!stream.is_created())
 	{
-		vao = 0;
-		vbo_vertices = 0;
-		ebo = 0;
-		size = 0;
+		stream = StreamBuffer{ std::max<size_t>(commands.size(), INITIAL_DRAW_COMMANDS) * sizeof(DrawElementsIndirectCommand) };
 	}
 
-	return *this;
+	stream.next_frame();
+
+	const auto allocation = stream.write(commands.data(), commands.size());
+
+	buffer = allocation.buffer;
+	offset = allocation.offset;
+	count = static_cast<GLsizei>(commands.size());
 }
 
-void Mesh::draw()
+void DrawCommandBuffer::bind() const
 {
-	if (vao)
+	if (buffer)
 	{
-		glBindVertexArray(vao);
-
-		glDrawElements(GL_TRIANGLES, size, GL_UNSIGNED_INT, nullptr);
+		glBindBuffer(GL_DRAW_INDIRECT_BUFFER, buffer);
 	}
 	else
 	{
-		throw std::runtime_error("Tried to draw with blank VAO");
+		throw std::runtime_error("Tried to bind empty DrawCommandBuffer");
 	}
 }
 
-TextureArray2d::TextureArray2d(const std::vector<const char*>& texture_filenames, const size_t texture_width, const size_t texture_height)
+TextureArray2d::TextureArray2d(const std::vector<const char*>& texture_filenames, const size_t texture_width, const size_t texture_height, ThreadPool& thread_pool)
+	: stream(std::make_unique<TextureStream>(thread_pool))
 {
+	stream->filenames.assign(texture_filenames.begin(), texture_filenames.end());
+	stream->width = texture_width;
+	stream->height = texture_height;
+	stream->layer_size = texture_width * texture_height * 3;
+	stream->remaining = texture_filenames.size();
+
 	glCreateTextures(GL_TEXTURE_2D_ARRAY, 1, &texture_array);
 
 	//allocate storage
 	glTextureStorage3D(texture_array, 4, GL_SRGB8, static_cast<GLsizei>(texture_width), static_cast<GLsizei>(texture_height), static_cast<GLsizei>(texture_filenames.size()));
 
-	for (size_t i = 0; i < texture_filenames.size(); i++)
+	for (GLint level = 0; level < 4; level++)
 	{
-		int width, height, nr_channels;
-		unsigned char* texture = stbi_load(texture_filenames[i], &width, &height, &nr_channels, 3);
+		glClearTexImage(texture_array, level, GL_RGB, GL_UNSIGNED_BYTE, PLACEHOLDER_COLOR.data());
+	}
 
-		if (width != static_cast<int>(texture_width) || height != static_cast<int>(texture_height))
-		{
-			throw std::runtime_error("texture loaded is not of size (" + std::to_string(texture_width) + " x " + std::to_string(texture_height) + ")");
-		}
+	glTextureParameteri(texture_array, GL_TEXTURE_WRAP_S, GL_REPEAT);
+	glTextureParameteri(texture_array, GL_TEXTURE_WRAP_T, GL_REPEAT);
+	glTextureParameteri(texture_array, GL_TEXTURE_MIN_FILTER, GL_LINEAR);
+	glTextureParameteri(texture_array, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
 
-		if (nullptr == texture)
-		{
-			throw std::runtime_error("Failed to load texture from file");
-		}
+	if (texture_filenames.empty())
+	{
+		stream.reset();
+		return;
+	}
 
-		//store image
-		glTextureSubImage3D(texture_array, 0, 0, 0, static_cast<GLint>(i), static_cast<GLsizei>(texture_width), static_cast<GLsizei>(texture_height), 1, GL_RGB, GL_UNSIGNED_BYTE, texture);
+	//decoded layers get copied in here and uploaded from it, the decodes run in the background so the gl thread never waits on one
+	const GLbitfield map_flags = GL_MAP_WRITE_BIT | GL_MAP_PERSISTENT_BIT | GL_MAP_COHERENT_BIT;
 
-		stbi_image_free(texture);
+	glCreateBuffers(1, &stream->pixel_buffer);
+	glNamedBufferStorage(stream->pixel_buffer, static_cast<GLsizeiptr>(stream->layer_size * UPLOAD_SLOTS), nullptr, map_flags);
+	stream->mapped = static_cast<unsigned char*>(glMapNamedBufferRange(stream->pixel_buffer, 0, static_cast<GLsizeiptr>(stream->layer_size * UPLOAD_SLOTS), map_flags));
+
+	if (nullptr == stream->mapped)
+	{
+		throw std::runtime_error("Failed to map texture upload buffer");
 	}
 
-	glGenerateTextureMipmap(texture_array);
+	TextureStream* texture_stream = stream.get();
+	for (size_t i = 0; i < texture_filenames.size(); i++)
+	{
+		stream->decode_group.run_background([texture_stream, i]()
+			{
+				texture_stream->decode(i);
+			});
+	}
+}
+
+TextureArray2d::TextureArray2d(const TextureCache& cache)
+{
+	const GLenum internal_format = cache.format == TextureCacheFormat::BC1 ? GL_COMPRESSED_SRGB_S3TC_DXT1_EXT : GL_COMPRESSED_SRGB_ALPHA_BPTC_UNORM;
+
+	glCreateTextures(GL_TEXTURE_2D_ARRAY, 1, &texture_array);
+
+	glTextureStorage3D(texture_array, static_cast<GLsizei>(cache.level_count), internal_format, static_cast<GLsizei>(cache.width), static_cast<GLsizei>(cache.height), static_cast<GLsizei>(cache.layer_count));
+
+	//every level has all the layers next to each other
+	for (uint32_t level = 0; level < cache.level_count; level++)
+	{
+		const GLsizei level_width = static_cast<GLsizei>(texture_level_extent(cache.width, level));
+		const GLsizei level_height = static_cast<GLsizei>(texture_level_extent(cache.height, level));
+
+		glCompressedTextureSubImage3D(texture_array, static_cast<GLint>(level), 0, 0, 0, level_width, level_height, static_cast<GLsizei>(cache.layer_count),
+			internal_format, static_cast<GLsizei>(cache.level_size(level)), cache.level_data(level));
+	}
 
 	glTextureParameteri(texture_array, GL_TEXTURE_WRAP_S, GL_REPEAT);
 	glTextureParameteri(texture_array, GL_TEXTURE_WRAP_T, GL_REPEAT);
@@ -245,6 +549,31 @@ TextureArray2d::TextureArray2d(const std::vector<const char*>& texture_filenames
 	glTextureParameteri(texture_array, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
 }
 
+bool TextureArray2d::supports_format(TextureCacheFormat format)
+{
+	//bc7 is core since 4.2
+	if (format == TextureCacheFormat::BC7)
+	{
+		return true;
+	}
+
+	bool has_s3tc = false, has_srgb = false;
+
+	GLint extension_count = 0;
+	glGetIntegerv(GL_NUM_EXTENSIONS, &extension_count);
+	for (GLint i = 0; i < extension_count; i++)
+	{
+		const std::string extension = reinterpret_cast<const char*>(glGetStringi(GL_EXTENSIONS, static_cast<GLuint>(i)));
+
+		has_s3tc = has_s3tc || extension == "GL_EXT_texture_compression_s3tc";
+		has_srgb = has_srgb || extension == "GL_EXT_texture_sRGB" || extension == "GL_EXT_texture_compression_s3tc_srgb";
+	}
+
+	return has_s3tc && has_srgb;
+}
+
+TextureArray2d::TextureArray2d() noexcept = default;
+
 TextureArray2d::~TextureArray2d()
 {
 	if (texture_array)
@@ -254,7 +583,7 @@ TextureArray2d::~TextureArray2d()
 }
 
 TextureArray2d::TextureArray2d(TextureArray2d&& o) noexcept
-	: texture_array(o.texture_array)
+	: texture_array(o.texture_array), stream(std::move(o.stream))
 {
 	o.texture_array = 0;
 }
@@ -267,12 +596,108 @@ TextureArray2d& TextureArray2d::operator=(TextureArray2d&& o) noexcept
 	}
 
 	texture_array = o.texture_array;
+	stream = std::move(o.stream);
 
 	o.texture_array = 0;
 
 	return *this;
 }
 
+void TextureArray2d::update()
+{
+	if (stream)
+	{
+		upload_layers(false);
+	}
+}
+
+void TextureArray2d::finish_loading()
+{
+	while (stream)
+	{
+		stream->decode_group.wait();
+
+		upload_layers(true);
+	}
+}
+
+void TextureArray2d::upload_layers(bool wait)
+{
+	PROFILE_ZONE("TextureArray2d::upload_layers");
+
+	//without workers the decodes only ever run here, one per frame
+	if (!wait && stream->thread_pool->get_thread_count() == 0)
+	{
+		stream->thread_pool->run_background_job();
+	}
+
+	{
+		std::unique_lock<std::mutex> lock{ stream->decoded_mutex };
+
+		stream->ready.insert(stream->ready.end(), stream->decoded.begin(), stream->decoded.end());
+		stream->decoded.clear();
+	}
+
+	size_t uploaded = 0;
+	for (; uploaded < stream->ready.size(); uploaded++)
+	{
+		auto& layer = stream->ready[uploaded];
+		if (!layer.error.empty())
+		{
+			throw std::runtime_error(layer.error);
+		}
+
+		//the slot is free again once the gpu is done copying out of it
+		GLsync& fence = stream->fences[stream->next_slot];
+		if (fence)
+		{
+			GLenum status;
+			do
+			{
+				status = glClientWaitSync(fence, wait ? GL_SYNC_FLUSH_COMMANDS_BIT : 0, wait ? 1000000000 : 0);
+			} while (wait && status == GL_TIMEOUT_EXPIRED);
+
+			if (status == GL_WAIT_FAILED)
+			{
+				throw std::runtime_error("Failed to wait on texture upload");
+			}
+
+			if (status == GL_TIMEOUT_EXPIRED)
+			{
+				break;
+			}
+
+			glDeleteSync(fence);
+			fence = nullptr;
+		}
+
+		const size_t offset = stream->next_slot * stream->layer_size;
+		memcpy(stream->mapped + offset, layer.pixels, stream->layer_size);
+
+		stbi_image_free(layer.pixels);
+		layer.pixels = nullptr;
+
+		glBindBuffer(GL_PIXEL_UNPACK_BUFFER, stream->pixel_buffer);
+		glTextureSubImage3D(texture_array, 0, 0, 0, static_cast<GLint>(layer.layer), static_cast<GLsizei>(stream->width), static_cast<GLsizei>(stream->height), 1, GL_RGB, GL_UNSIGNED_BYTE, reinterpret_cast<const void*>(offset));
+		glBindBuffer(GL_PIXEL_UNPACK_BUFFER, 0);
+
+		fence = glFenceSync(GL_SYNC_GPU_COMMANDS_COMPLETE, 0);
+
+		stream->next_slot = (stream->next_slot + 1) % UPLOAD_SLOTS;
+		stream->remaining--;
+	}
+
+	stream->ready.erase(stream->ready.begin(), stream->ready.begin() + static_cast<std::ptrdiff_t>(uploaded));
+
+	//the lower levels keep the placeholder until every layer is in
+	if (stream->remaining == 0)
+	{
+		glGenerateTextureMipmap(texture_array);
+
+		stream.reset();
+	}
+}
+
 void TextureArray2d::bind(uint32_t texture_unit)
 {
 	if (texture_array)
@@ -284,3 +709,81 @@ void TextureArray2d::bind(uint32_t texture_unit)
 		throw std::runtime_error("Tried to bind invalid TextureArray2d");
 	}
 }
+
+Framebuffer::Framebuffer(int32_t width, int32_t height)
+{
+	glCreateFramebuffers(1, &framebuffer);
+	glCreateRenderbuffers(1, &color_renderbuffer);
+	glCreateRenderbuffers(1, &depth_renderbuffer);
+
+	//srgb like the default framebuffer so the output looks the same
+	glNamedRenderbufferStorage(color_renderbuffer, GL_SRGB8_ALPHA8, width, height);
+	glNamedRenderbufferStorage(depth_renderbuffer, GL_DEPTH_COMPONENT24, width, height);
+
+	glNamedFramebufferRenderbuffer(framebuffer, GL_COLOR_ATTACHMENT0, GL_RENDERBUFFER, color_renderbuffer);
+	glNamedFramebufferRenderbuffer(framebuffer, GL_DEPTH_ATTACHMENT, GL_RENDERBUFFER, depth_renderbuffer);
+
+	if (glCheckNamedFramebufferStatus(framebuffer, GL_FRAMEBUFFER) != GL_FRAMEBUFFER_COMPLETE)
+	{
+		throw std::runtime_error("Framebuffer is incomplete");
+	}
+}
+
+void Framebuffer::release()
+{
+	if (framebuffer)
+	{
+		glDeleteFramebuffers(1, &framebuffer);
+		glDeleteRenderbuffers(1, &color_renderbuffer);
+		glDeleteRenderbuffers(1, &depth_renderbuffer);
+	}
+
+	framebuffer = 0;
+	color_renderbuffer = 0;
+	depth_renderbuffer = 0;
+}
+
+Framebuffer::~Framebuffer()
+{
+	release();
+}
+
+Framebuffer::Framebuffer(Framebuffer&& o) noexcept
+	: framebuffer(o.framebuffer), color_renderbuffer(o.color_renderbuffer), depth_renderbuffer(o.depth_renderbuffer)
+{
+	o.framebuffer = 0;
+	o.color_renderbuffer = 0;
+	o.depth_renderbuffer = 0;
+}
+
+Framebuffer& Framebuffer::operator=(Framebuffer&& o) noexcept
+{
+	if (&o == this)
+	{
+		return *this;
+	}
+
+	release();
+
+	framebuffer = o.framebuffer;
+	color_renderbuffer = o.color_renderbuffer;
+	depth_renderbuffer = o.depth_renderbuffer;
+
+	o.framebuffer = 0;
+	o.color_renderbuffer = 0;
+	o.depth_renderbuffer = 0;
+
+	return *this;
+}
+
+void Framebuffer::bind()
+{
+	if (framebuffer)
+	{
+		glBindFramebuffer(GL_FRAMEBUFFER, framebuffer);
+	}
+	else
+	{
+		throw std::runtime_error("Tried to bind invalid Framebuffer");
+	}
+}
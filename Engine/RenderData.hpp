@@ -2,13 +2,16 @@
 #define RENDER_DATA_OPENGL_HPP
 
 #include <vector>
+#include <memory>
+#include <cstdint>
 
 #include <glad/glad.h>
 
 #include <glm/glm.hpp>
 
-#define GLM_ENABLE_EXPERIMENTAL
-#include <glm/gtx/hash.hpp>
+#include "Sector.hpp"
+
+#include "StreamBuffer.hpp"
 
 struct Vertex
 {
@@ -23,30 +26,153 @@ struct Vertex
 	}
 };
 
-namespace std
+//what Mesh keeps on the gpu, Vertex stays the format geometry is built and welded in
+struct PackedVertex
 {
-	template<> struct hash<Vertex>
-	{
-		size_t operator()(Vertex const& vertex) const
-		{
-			return (((hash<glm::vec3>()(vertex.pos) ^
-				(hash<glm::vec2>()(vertex.tex_coord) << 1)) >> 1) ^
-				(hash<float>()(vertex.tex_index) << 1) >> 1) ^
-				(hash<glm::vec3>()(vertex.normal));
-		}
-	};
+	glm::vec3 pos;
+
+	//full floats, floor coordinates grow with the map and wall u grows with its square, halves would smear the texels
+	glm::vec2 tex_coord;
+
+	//GL_INT_2_10_10_10_REV, w is 1 or -1 on floors and ceilings, whose normal is rebuilt from the position in the shader
+	uint32_t normal;
+
+	uint16_t tex_index;
+	uint16_t padding;
+};
+
+static_assert(sizeof(PackedVertex) == sizeof(float) * 7, "PackedVertex must be tightly packed");
+
+PackedVertex pack_vertex(const Vertex& vertex);
+
+//GL_INT_2_10_10_10_REV, normals with a y are floors or ceilings and store its sign in w
+uint32_t pack_normal(const glm::vec3& normal);
+
+//what a vertex pulling Mesh keeps on the gpu, the vertex shader reads it by gl_VertexID
+//heights, texture coordinates and materials are looked up in the sectors, so they're stored once per sector instead of per vertex
+struct PulledVertex
+{
+	glm::vec2 pos;
+
+	//sector whose materials the face uses
+	uint32_t sector;
+
+	//from make_height_ref, clamped between the owning sector's floor and ceiling
+	uint32_t height;
+
+	//from pack_normal, w is 1 on floors, -1 on ceilings and 0 on walls
+	uint32_t normal;
+};
+
+static_assert(sizeof(PulledVertex) == sizeof(float) * 5, "PulledVertex must be tightly packed");
+
+//which sector's floor or ceiling a PulledVertex sits at
+inline uint32_t make_height_ref(uint32_t sector, bool ceil)
+{
+	return (sector << 1) | (ceil ? 1u : 0u);
 }
 
+//per sector data of a vertex pulling Mesh, matches the vertex shader's std430 layout
+struct GpuSectorData
+{
+	float floor, ceil;
+
+	uint32_t wall_type, ceil_type, floor_type;
+};
+
+static_assert(sizeof(GpuSectorData) == sizeof(float) * 5, "GpuSectorData must match std430");
+
+enum class VertexFetch
+{
+	//PackedVertex attributes read through the vertex array
+	ATTRIBUTES,
+	//the vertex shader reads PulledVertex and the sectors' heights and materials from storage buffers
+	PULLED
+};
+
+//range of indices in a mesh's index buffer
+struct MeshRange
+{
+	uint32_t first, count;
+};
+
+//layout glMultiDrawElementsIndirect reads from GL_DRAW_INDIRECT_BUFFER
+struct DrawElementsIndirectCommand
+{
+	uint32_t count;
+	uint32_t instance_count;
+	uint32_t first_index;
+	int32_t base_vertex;
+	uint32_t base_instance;
+};
+
+static_assert(sizeof(DrawElementsIndirectCommand) == sizeof(uint32_t) * 5, "DrawElementsIndirectCommand must be tightly packed");
+
+//vertices are welded byte by byte, so there must not be any padding
+static_assert(sizeof(Vertex) == sizeof(float) * 9, "Vertex must be tightly packed");
+
+//indirect draw commands refilled every frame, written straight into a persistently mapped ring
+class DrawCommandBuffer
+{
+	StreamBuffer stream;
+
+	//where the last upload went
+	GLuint buffer = 0;
+	GLintptr offset = 0;
+
+	GLsizei count = 0;
+
+public:
+	explicit DrawCommandBuffer() noexcept = default;
+
+	explicit DrawCommandBuffer(DrawCommandBuffer&& o) noexcept = default;
+
+	DrawCommandBuffer& operator=(DrawCommandBuffer&& o) noexcept = default;
+
+	explicit DrawCommandBuffer(DrawCommandBuffer&) = delete;
+
+	DrawCommandBuffer& operator=(DrawCommandBuffer&) = delete;
+
+	//once a frame, only waits if the gpu is still reading the commands of StreamBuffer::FRAMES frames ago
+	void upload(const std::vector<DrawElementsIndirectCommand>& commands);
+
+	void bind() const;
+
+	//of the first command in the bound GL_DRAW_INDIRECT_BUFFER
+	GLintptr get_offset() const
+	{
+		return offset;
+	}
+
+	GLsizei get_count() const
+	{
+		return count;
+	}
+};
+
 class Mesh
 {
-	GLuint vao, ebo;
-	//first VBO is vertices + texture coords + texture indices
-	GLuint vbo_vertices;
-	GLsizei size;
+	GLuint vao = 0, ebo = 0;
+	//PackedVertex, or PulledVertex read as a storage buffer
+	GLuint vbo_vertices = 0;
+	//GpuSectorData, only when the vertices are pulled
+	GLuint sector_buffer = 0;
+	GLsizei size = 0;
+
+	//points the vao at the buffers and describes PackedVertex
+	void setup_vertex_array();
+
+	//duplicates the other mesh's buffers on the gpu, expects this one to be empty
+	void copy_from(const Mesh& other);
+
+	void release();
 
 public:
 	explicit Mesh(const std::vector<Vertex>& vertices, const std::vector<uint32_t>& indices);
 
+	//the vao only holds the index buffer, binding also binds the vertices and sectors to storage buffer bindings 0 and 1
+	explicit Mesh(const std::vector<PulledVertex>& vertices, const std::vector<uint32_t>& indices, const std::vector<Sector>& sectors);
+
 	explicit Mesh() = default;
 
 	~Mesh();
@@ -55,21 +181,59 @@ public:
 
 	Mesh& operator=(Mesh&& o) noexcept;
 
-	explicit Mesh(Mesh& other);
+	//deep copies, the buffers are copied on the gpu
+	explicit Mesh(const Mesh& other);
+
+	Mesh& operator=(const Mesh& other);
+
+	//for callers that issue their own draws
+	void bind() const;
+
+	void draw() const;
+
+	//one glMultiDrawElementsIndirect over every command in the buffer
+	void draw_indirect(const DrawCommandBuffer& commands) const;
+
+	//overwrite part of the buffers in place, the ranges must already exist
+	void update_vertices(size_t first_vertex, const std::vector<Vertex>& vertices);
 
-	Mesh& operator=(Mesh& other);
+	void update_vertices(size_t first_vertex, const std::vector<PulledVertex>& vertices);
 
-	void draw();
+	void update_indices(size_t first_index, const std::vector<uint32_t>& indices);
+
+	//new heights and materials for a pulled mesh's sector
+	void update_sector(size_t sector_index, const Sector& sector);
 };
 
+class ThreadPool;
+
+struct TextureStream;
+
+struct TextureCache;
+
+enum class TextureCacheFormat : uint32_t;
+
+//layers start out grey and are filled in by update() as the thread pool decodes them
 class TextureArray2d
 {
-	GLuint texture_array;
+	GLuint texture_array = 0;
+
+	//decode and upload state, gone once every layer is uploaded
+	std::unique_ptr<TextureStream> stream;
+
+	void upload_layers(bool wait);
 
 public:
-	explicit TextureArray2d(const std::vector<const char*>& texture_filenames, const size_t texture_width, const size_t texture_height);
+	explicit TextureArray2d(const std::vector<const char*>& texture_filenames, const size_t texture_width, const size_t texture_height, ThreadPool& thread_pool);
+
+	//uploads block compressed layers and their mip chains straight from a cache, nothing is decoded or generated
+	explicit TextureArray2d(const TextureCache& cache);
 
-	explicit TextureArray2d() noexcept = default;
+	//whether the driver can sample the cache's block format
+	static bool supports_format(TextureCacheFormat format);
+
+	//defined where TextureStream is complete
+	explicit TextureArray2d() noexcept;
 
 	~TextureArray2d();
 
@@ -81,7 +245,44 @@ public:
 
 	TextureArray2d& operator=(TextureArray2d&) = delete;
 
+	//uploads whatever finished decoding since the last call without waiting on anything, call once a frame
+	void update();
+
+	//blocks until every layer is decoded and uploaded
+	void finish_loading();
+
+	bool is_loaded() const
+	{
+		return stream == nullptr;
+	}
+
 	void bind(uint32_t texture_unit);
 };
 
+//offscreen render target with a color and a depth attachment
+class Framebuffer
+{
+	GLuint framebuffer = 0;
+	GLuint color_renderbuffer = 0, depth_renderbuffer = 0;
+
+	void release();
+
+public:
+	explicit Framebuffer(int32_t width, int32_t height);
+
+	explicit Framebuffer() noexcept = default;
+
+	~Framebuffer();
+
+	explicit Framebuffer(Framebuffer&& o) noexcept;
+
+	Framebuffer& operator=(Framebuffer&& o) noexcept;
+
+	explicit Framebuffer(Framebuffer&) = delete;
+
+	Framebuffer& operator=(Framebuffer&) = delete;
+
+	void bind();
+};
+
 #endif
\ No newline at end of file
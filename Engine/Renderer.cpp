@@ -2,10 +2,11 @@
 
 #include <stdexcept>
 #include <iostream>
-#include <fstream>
 #include <string>
-#include <sstream>
-#include <iomanip>
+#include <filesystem>
+#include <algorithm>
+#include <optional>
+#include <numeric>
 
 #include <glm/glm.hpp>
 #include <glm/gtc/matrix_transform.hpp>
@@ -13,6 +14,10 @@
 
 #include "stb_image.h"
 
+#include "MapFile.hpp"
+#include "TextureCache.hpp"
+#include "SectorGeometry.hpp"
+
 #ifndef NDEBUG
 void APIENTRY opengl_debug_output(GLenum source,
 	GLenum type,
@@ -62,43 +67,438 @@ void APIENTRY opengl_debug_output(GLenum source,
 }
 #endif
 
-Renderer::Renderer()
+//seconds between two recorded camera keys
+constexpr double RECORD_INTERVAL = 0.1;
+
+//the simulation always advances in steps this long, however fast frames are drawn, benchmarks take one per frame
+constexpr double SIMULATION_STEP = 1.0 / 60.0;
+
+//after a stall the simulation falls behind instead of spending even longer catching up
+constexpr int MAX_SIMULATION_STEPS = 8;
+
+Renderer::Renderer(const std::string& map_filename, bool headless, RenderBackend backend)
+	: backend(backend), software(backend != RenderBackend::OPENGL), headless(headless), map_filename(map_filename)
 {
 	//initialize our Window and OpenGL
 	init_window_renderer();
 
 	set_sdl_settings();
 
-	set_opengl_settings();
+	if (backend == RenderBackend::SOFTWARE)
+	{
+		software_rasterizer = std::make_unique<SoftwareRasterizer>(thread_pool);
+		software_rasterizer->set_clear_color(glm::vec3{ 0.0f, 0.6f, 0.6f });
+		resize_software();
+	}
+	else if (backend == RenderBackend::PORTAL)
+	{
+		portal_renderer = std::make_unique<PortalRenderer>(thread_pool);
+		portal_renderer->set_clear_color(glm::vec3{ 0.0f, 0.6f, 0.6f });
+		resize_software();
+	}
+	else
+	{
+		set_opengl_settings();
+	}
 
 	//initialize our objects
 	init_game_objects();
 
+#ifdef SECTOR_PROFILER
+	if (!software)
+	{
+		Profiler::get().init_gpu();
+	}
+#endif
+
 	is_running = true;
 }
 
 Renderer::~Renderer()
 {
+#ifdef SECTOR_PROFILER
+	Profiler::get().destroy_gpu();
+#endif
+
 	destroy_window_renderer();
 }
 
+void Renderer::record_camera_path(const std::string& filename)
+{
+	record_filename = filename;
+	recorded_path.clear();
+	record_timer = 0.0;
+}
+
+void Renderer::set_culling(CullingMode new_culling)
+{
+	if (new_culling == CullingMode::FRUSTUM && software)
+	{
+		throw std::runtime_error("Frustum culling needs the gl renderer");
+	}
+
+	culling = new_culling;
+}
+
+void Renderer::set_vertex_fetch(VertexFetch new_vertex_fetch)
+{
+	if (software)
+	{
+		throw std::runtime_error("Vertex pulling needs the gl renderer");
+	}
+
+	if (new_vertex_fetch == vertex_fetch)
+	{
+		return;
+	}
+
+	vertex_fetch = new_vertex_fetch;
+
+	build_map_mesh();
+}
+
+void Renderer::set_sector(uint32_t index, const Sector& sector)
+{
+	if (index >= sectors.size())
+	{
+		throw std::runtime_error("Tried to set sector " + std::to_string(index) + " of a map with " + std::to_string(sectors.size()));
+	}
+
+	const bool moved = sector.vertices != sectors[index].vertices;
+
+	//the old neighbors lose their portal steps if the links changed
+	if (!software)
+	{
+		map_mesh.mark_dirty(sectors, index);
+	}
+
+	sectors[index] = sector;
+
+	if (!software)
+	{
+		map_mesh.mark_dirty(sectors, index);
+	}
+
+	//the portal renderer reads the sectors directly
+	if (backend == RenderBackend::SOFTWARE)
+	{
+		map_geometry_dirty = true;
+	}
+
+	if (moved)
+	{
+		sector_index.build(sectors);
+		collision_world.update_sector(sectors, index);
+	}
+}
+
+void Renderer::add_mover(const SectorMover& mover)
+{
+	movers.add(sectors, mover);
+
+	//the software mesh needs its slots before anything moves
+	if (backend == RenderBackend::SOFTWARE && map_slots.empty())
+	{
+		map_geometry_dirty = true;
+	}
+}
+
+void Renderer::update_movers(double step)
+{
+	if (movers.empty())
+	{
+		return;
+	}
+
+	const auto& moved = movers.update(sectors, step);
+
+	for (const auto sector : moved)
+	{
+		if (backend == RenderBackend::SOFTWARE)
+		{
+			mark_sector_moved(sector);
+		}
+		else if (!software && map_mesh.heights_changed(sectors, sector))
+		{
+			//the bounds still have to follow, update_map_mesh() does that for remeshed sectors
+			gpu_culler.update_sector(sector, sectors[sector], map_mesh.get_sector_ranges()[sector]);
+		}
+	}
+}
+
+void Renderer::mark_sector_moved(uint32_t index)
+{
+	moved_flags.resize(sectors.size(), 0);
+
+	auto mark = [this](uint32_t sector)
+	{
+		if (!moved_flags[sector])
+		{
+			moved_flags[sector] = 1;
+			moved_sectors.push_back(sector);
+		}
+	};
+
+	mark(index);
+
+	for (const auto neighbor : sectors[index].neighbors)
+	{
+		if (neighbor >= 0)
+		{
+			mark(static_cast<uint32_t>(neighbor));
+		}
+	}
+}
+
+void Renderer::capture_trace(const std::string& filename)
+{
+	trace_filename = filename;
+
+#ifdef SECTOR_PROFILER
+	Profiler::get().start_trace();
+#else
+	std::cerr << "Tracing is compiled out of this build, configure with -Dprofiler=true to enable it\n";
+#endif
+}
+
+void Renderer::toggle_trace()
+{
+#ifdef SECTOR_PROFILER
+	auto& profiler = Profiler::get();
+	if (profiler.is_tracing())
+	{
+		profiler.stop_trace(trace_filename);
+
+		std::cout << "Trace written to " << trace_filename << '\n';
+	}
+	else
+	{
+		profiler.start_trace();
+
+		std::cout << "Tracing started\n";
+	}
+#endif
+}
+
 void Renderer::run()
 {
 	while (is_running)
 	{
+#ifdef SECTOR_PROFILER
+		Profiler::get().begin_frame();
+#endif
+
 		//calculate delta time
 		const auto current_time = SDL_GetPerformanceCounter();
 		delta_time = (double)((current_time - prev_time) / (double)SDL_GetPerformanceFrequency());
 		prev_time = current_time;
 
 		//sdl events
-		get_events();
+		{
+			PROFILE_ZONE("get_events");
+
+			get_events();
+		}
+
+		{
+			PROFILE_ZONE("handle_events");
+
+			handle_events();
+
+			if (!record_filename.empty())
+			{
+				record_frame();
+			}
+		}
 
-		handle_events();
+		texture_array.update();
 
 		//draw frame
 		draw();
+
+#ifdef SECTOR_PROFILER
+		Profiler::get().end_frame();
+#endif
+	}
+
+	if (!record_filename.empty())
+	{
+		write_camera_path(record_filename, recorded_path);
+	}
+
+#ifdef SECTOR_PROFILER
+	if (Profiler::get().is_tracing())
+	{
+		toggle_trace();
 	}
+#endif
+}
+
+void Renderer::run_benchmark(const BenchmarkSettings& settings)
+{
+	const std::vector<CameraKey> path = read_camera_path(settings.camera_path);
+
+	window_width = settings.width;
+	window_height = settings.height;
+
+	//the window might not even be visible, so render somewhere we control the size of
+	std::optional<Framebuffer> framebuffer;
+	std::optional<GpuTimer> gpu_timer;
+
+	if (software)
+	{
+		resize_software();
+	}
+	else
+	{
+		framebuffer.emplace(settings.width, settings.height);
+		framebuffer->bind();
+
+		glViewport(0, 0, window_width, window_height);
+
+		//measure with the real textures rather than the placeholders
+		texture_array.finish_loading();
+
+		gpu_timer.emplace();
+	}
+
+	std::vector<double> cpu_times;
+	std::vector<double> gpu_times;
+	cpu_times.reserve(settings.frames);
+	gpu_times.reserve(settings.warmup_frames + settings.frames);
+
+	const uint32_t total_frames = settings.warmup_frames + settings.frames;
+	const float last_frame = static_cast<float>(std::max(settings.frames, 2u) - 1);
+
+	auto measure_start = std::chrono::steady_clock::now();
+	for (uint32_t frame = 0; frame < total_frames && is_running; frame++)
+	{
+		//the warmup frames render the start of the path
+		const bool measured = frame >= settings.warmup_frames;
+		const uint32_t path_frame = measured ? frame - settings.warmup_frames : frame;
+
+		if (frame == settings.warmup_frames)
+		{
+			measure_start = std::chrono::steady_clock::now();
+		}
+
+		//keep the window system happy
+		SDL_Event ev;
+		while (SDL_PollEvent(&ev))
+		{
+			if (ev.type == SDL_QUIT)
+			{
+				is_running = false;
+			}
+		}
+
+		const CameraKey key = sample_camera_path(path, static_cast<float>(path_frame) / last_frame);
+
+		int32_t sector = sector_index.find_sector(glm::vec2{ key.pos.x, key.pos.z });
+		if (sector < 0)
+		{
+			sector = static_cast<int32_t>(player.get_sector());
+		}
+
+		player.set_view(static_cast<uint32_t>(sector), key.pos, key.yaw, key.pitch);
+
+#ifdef SECTOR_PROFILER
+		Profiler::get().begin_frame();
+#endif
+
+		//waiting on an old timer query isn't part of the frame
+		if (gpu_timer)
+		{
+			gpu_timer->begin(gpu_times);
+		}
+
+		const auto cpu_start = std::chrono::steady_clock::now();
+
+		{
+			PROFILE_ZONE("draw_scene");
+
+			//a fixed step keeps the movers in the same place every run
+			update_movers(SIMULATION_STEP);
+
+			draw_scene();
+		}
+
+		const auto cpu_end = std::chrono::steady_clock::now();
+
+		if (gpu_timer)
+		{
+			gpu_timer->end();
+		}
+
+#ifdef SECTOR_PROFILER
+		Profiler::get().end_frame();
+#endif
+
+		if (measured)
+		{
+			cpu_times.push_back(std::chrono::duration<double, std::milli>(cpu_end - cpu_start).count());
+		}
+	}
+
+	if (gpu_timer)
+	{
+		gpu_timer->finish(gpu_times);
+		glFinish();
+	}
+
+	const double total_seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - measure_start).count();
+
+	if (!settings.screenshot.empty())
+	{
+		std::vector<uint32_t> pixels;
+		if (software)
+		{
+			pixels = get_software_pixels();
+		}
+		else
+		{
+			//gl rows start at the bottom
+			pixels.resize(static_cast<size_t>(window_width) * window_height);
+			glReadPixels(0, 0, window_width, window_height, GL_RGBA, GL_UNSIGNED_BYTE, pixels.data());
+
+			for (int32_t y = 0; y < window_height / 2; y++)
+			{
+				std::swap_ranges(pixels.begin() + static_cast<size_t>(y) * window_width, pixels.begin() + static_cast<size_t>(y + 1) * window_width,
+					pixels.begin() + static_cast<size_t>(window_height - 1 - y) * window_width);
+			}
+		}
+
+		write_screenshot(settings.screenshot, window_width, window_height, pixels);
+	}
+
+	if (framebuffer)
+	{
+		glBindFramebuffer(GL_FRAMEBUFFER, 0);
+	}
+
+	//throw away the warmup frames
+	gpu_times.erase(gpu_times.begin(), gpu_times.begin() + std::min<size_t>(settings.warmup_frames, gpu_times.size()));
+
+	const std::string thread_count = std::to_string(thread_pool.get_thread_count() + 1);
+
+	std::string renderer_name;
+	switch (backend)
+	{
+	case RenderBackend::OPENGL:   renderer_name = reinterpret_cast<const char*>(glGetString(GL_RENDERER)); break;
+	case RenderBackend::SOFTWARE: renderer_name = "Software rasterizer (" + thread_count + " threads)"; break;
+	case RenderBackend::PORTAL:   renderer_name = "Portal renderer (" + thread_count + " threads)"; break;
+	}
+
+	write_benchmark_json(settings.output, settings, renderer_name, cpu_times, gpu_times, total_seconds);
+
+#ifdef SECTOR_PROFILER
+	if (Profiler::get().is_tracing())
+	{
+		toggle_trace();
+	}
+#endif
+
+	std::cout << "Rendered " << cpu_times.size() << " frames in " << total_seconds << "s on " << renderer_name << ", results written to " << settings.output << '\n';
 }
 
 void Renderer::get_events()
@@ -117,7 +517,14 @@ void Renderer::get_events()
 			case SDL_WINDOWEVENT_RESIZED:
 				window_width = ev.window.data1;
 				window_height = ev.window.data2;
-				glViewport(0, 0, window_width, window_height);
+				if (software)
+				{
+					resize_software();
+				}
+				else
+				{
+					glViewport(0, 0, window_width, window_height);
+				}
 				break;
 			}
 			break;
@@ -130,6 +537,14 @@ void Renderer::get_events()
 			case SDLK_ESCAPE:
 				is_running = false;
 				break;
+#ifdef SECTOR_PROFILER
+			case SDLK_F3:
+				if (ev.key.repeat == 0) Profiler::get().toggle_overlay();
+				break;
+			case SDLK_F4:
+				if (ev.key.repeat == 0) toggle_trace();
+				break;
+#endif
 			}
 			[[fallthrough]];
 		case SDL_KEYUP:
@@ -179,33 +594,243 @@ void Renderer::handle_events()
 		dir = dir | Player::MoveDir::RIGHT;
 	}
 
-	player.move(dir, delta_time);
+	simulation_time = std::min(simulation_time + delta_time, SIMULATION_STEP * MAX_SIMULATION_STEPS);
+
+	while (simulation_time >= SIMULATION_STEP)
+	{
+		simulation_time -= SIMULATION_STEP;
+
+		step_simulation(dir);
+	}
+
+	simulation_alpha = static_cast<float>(simulation_time / SIMULATION_STEP);
+}
+
+void Renderer::step_simulation(Player::MoveDir dir)
+{
+	PROFILE_ZONE("step_simulation");
+
+	update_movers(SIMULATION_STEP);
+
+	player.begin_step();
 
-	player.collision(sectors, delta_time);
+	player.move(dir, SIMULATION_STEP);
+
+	{
+		PROFILE_ZONE("Player::collision");
+
+		player.collision(sectors, collision_world, sector_index, SIMULATION_STEP);
+	}
 }
 
-void Renderer::draw()
+void Renderer::record_frame()
 {
-	glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT);
+	record_timer -= delta_time;
+	if (record_timer > 0.0)
+	{
+		return;
+	}
 
-	const glm::mat4 projection = glm::perspective(glm::radians(90.0f), (float)window_width / (float)window_height, 0.1f, 125.0f);
+	record_timer += RECORD_INTERVAL;
+	if (record_timer < 0.0)
+	{
+		record_timer = 0.0;
+	}
 
-	const auto pv = projection * player.get_view_matrix();
+	recorded_path.push_back(CameraKey{ player.get_pos(), player.get_yaw(), player.get_pitch() });
+}
 
-	texture_array.bind(0);
+void Renderer::draw()
+{
+	{
+		PROFILE_ZONE("draw_scene");
 
-	main_shader.use();
+		draw_scene();
+	}
 
-	glProgramUniformMatrix4fv(main_shader.program, 0, 1, GL_FALSE, glm::value_ptr(pv));
+	if (software)
+	{
+		PROFILE_ZONE("present_software");
 
-	const auto view_pos = player.get_pos();
-	glProgramUniform3f(main_shader.program, 1, view_pos.x, view_pos.y, view_pos.z);
+		present_software();
+		return;
+	}
 
-	map_mesh.draw();
+#ifdef SECTOR_PROFILER
+	{
+		PROFILE_GPU_ZONE("Overlay");
+
+		Profiler::get().draw_overlay(window_width, window_height);
+	}
+#endif
+
+	//the driver can block here waiting on the gpu
+	PROFILE_ZONE("SDL_GL_SwapWindow");
 
 	SDL_GL_SwapWindow(window);
 }
 
+void Renderer::resize_software()
+{
+	if (software_rasterizer)
+	{
+		software_rasterizer->resize(window_width, window_height);
+	}
+	else
+	{
+		portal_renderer->resize(window_width, window_height);
+	}
+}
+
+const std::vector<uint32_t>& Renderer::get_software_pixels() const
+{
+	return software_rasterizer ? software_rasterizer->get_pixels() : portal_renderer->get_pixels();
+}
+
+void Renderer::present_software()
+{
+	SDL_Surface* surface = SDL_GetWindowSurface(window);
+	if (nullptr == surface)
+	{
+		throw std::runtime_error("Failed to get window surface");
+	}
+
+	//the window surface can lag a resize behind, only copy what fits
+	const int32_t width = std::min(surface->w, window_width);
+	const int32_t height = std::min(surface->h, window_height);
+
+	const auto& pixels = get_software_pixels();
+
+	SDL_ConvertPixels(width, height, SDL_PIXELFORMAT_RGBA32, pixels.data(), window_width * static_cast<int>(sizeof(uint32_t)),
+		surface->format->format, surface->pixels, surface->pitch);
+
+	SDL_UpdateWindowSurface(window);
+}
+
+void Renderer::draw_scene()
+{
+	PROFILE_GPU_ZONE("draw_scene");
+
+	const float aspect = (float)window_width / (float)window_height;
+
+	const glm::mat4 projection = glm::perspective(glm::radians(90.0f), aspect, 0.1f, 125.0f);
+
+	const auto pv = projection * player.get_view_matrix(simulation_alpha);
+
+	const auto view_pos = player.get_render_pos(simulation_alpha);
+
+	const uint32_t player_sector = player.get_render_sector(sectors, simulation_alpha);
+
+	//the portal renderer walks the sectors itself, the culler and mesh aren't needed
+	if (backend == RenderBackend::PORTAL)
+	{
+		portal_renderer->draw(sectors, player_sector, view_pos, player.get_front2d(), player.get_pitch());
+		return;
+	}
+
+	update_map_mesh();
+
+	RasterShaderProgram& shader = vertex_fetch == VertexFetch::PULLED ? pulled_shader : main_shader;
+
+	if (!software)
+	{
+		glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT);
+
+		texture_array.bind(0);
+
+		shader.use();
+
+		glProgramUniformMatrix4fv(shader.program, 0, 1, GL_FALSE, glm::value_ptr(pv));
+
+		glProgramUniform3f(shader.program, 1, view_pos.x, view_pos.y, view_pos.z);
+	}
+
+	if (!software && (culling == CullingMode::FRUSTUM || player_sector >= sectors.size()))
+	{
+		gpu_culler.cull(pv);
+
+		shader.use();
+
+		PROFILE_GPU_ZONE("map_mesh");
+
+		gpu_culler.draw(map_mesh.get_mesh());
+		return;
+	}
+
+	//walk the portals from the player's sector and only draw what can be seen through them
+	if (player_sector < sectors.size())
+	{
+		const auto view_wedge = PortalCuller::make_view_wedge(player.get_front2d(), player.get_pitch(), 90.0f, aspect);
+
+		{
+			PROFILE_ZONE("PortalCuller::find_visible_sectors");
+
+			portal_culler.find_visible_sectors(sectors, player_sector, glm::vec2{ view_pos.x, view_pos.z }, view_wedge, visible_sectors);
+		}
+	}
+	else
+	{
+		//outside of the map the software renderer draws everything
+		visible_sectors.resize(sectors.size());
+		std::iota(visible_sectors.begin(), visible_sectors.end(), 0u);
+	}
+
+	if (software)
+	{
+		//sectors are laid out in order in the mesh, so neighbouring ranges can be merged into one draw
+		std::sort(visible_sectors.begin(), visible_sectors.end());
+
+		visible_ranges.clear();
+
+		for (const auto visible_sector : visible_sectors)
+		{
+			const auto& range = map_geometry.sector_ranges[visible_sector];
+			if (range.count == 0)
+			{
+				continue;
+			}
+
+			if (!visible_ranges.empty() && range.first == visible_ranges.back().first + visible_ranges.back().count)
+			{
+				visible_ranges.back().count += range.count;
+			}
+			else
+			{
+				visible_ranges.push_back(range);
+			}
+		}
+
+		software_rasterizer->draw(map_geometry.vertices, map_geometry.indices, visible_ranges, pv, view_pos);
+		return;
+	}
+
+	//one command per visible sector in the order the portals were walked, so the nearest sectors go first for early depth testing
+	//base_instance carries the sector index for anything that wants to know it on the gpu
+	draw_commands.clear();
+
+	const auto& mesh_ranges = map_mesh.get_sector_ranges();
+
+	for (const auto visible_sector : visible_sectors)
+	{
+		const auto& range = mesh_ranges[visible_sector];
+		if (range.count == 0)
+		{
+			continue;
+		}
+
+		draw_commands.push_back(DrawElementsIndirectCommand{ range.count, 1, range.first, 0, visible_sector });
+	}
+
+	if (!draw_commands.empty())
+	{
+		PROFILE_GPU_ZONE("map_mesh");
+
+		draw_command_buffer.upload(draw_commands);
+
+		map_mesh.get_mesh().draw_indirect(draw_command_buffer);
+	}
+}
+
 void Renderer::init_window_renderer()
 {
 	//initialize our window
@@ -217,12 +842,18 @@ void Renderer::init_window_renderer()
 	window_width = 1280;
 	window_height = 720;
 
-	window = SDL_CreateWindow("Sector Renderer", SDL_WINDOWPOS_CENTERED, SDL_WINDOWPOS_CENTERED, window_width, window_height, SDL_WINDOW_OPENGL | SDL_WINDOW_SHOWN | SDL_WINDOW_RESIZABLE);
+	window = SDL_CreateWindow("Sector Renderer", SDL_WINDOWPOS_CENTERED, SDL_WINDOWPOS_CENTERED, window_width, window_height, (software ? 0 : SDL_WINDOW_OPENGL) | (headless ? SDL_WINDOW_HIDDEN : SDL_WINDOW_SHOWN | SDL_WINDOW_RESIZABLE));
 	if (nullptr == window)
 	{
 		throw std::runtime_error("Failed to create window");
 	}
 
+	//the software renderer copies into the window surface instead
+	if (software)
+	{
+		return;
+	}
+
 	//set opengl settings, ask for an OpenGL 4.3 Core context, and create a context
 	SDL_GL_SetAttribute(SDL_GL_CONTEXT_MAJOR_VERSION, 4);
 	SDL_GL_SetAttribute(SDL_GL_CONTEXT_MINOR_VERSION, 5);
@@ -249,9 +880,15 @@ void Renderer::set_sdl_settings()
 {
 	wasd = {};
 
-	SDL_GL_SetSwapInterval(0);
+	if (!software)
+	{
+		SDL_GL_SetSwapInterval(0);
+	}
 
-	SDL_SetRelativeMouseMode(SDL_TRUE);
+	if (!headless)
+	{
+		SDL_SetRelativeMouseMode(SDL_TRUE);
+	}
 }
 
 void Renderer::set_opengl_settings()
@@ -278,8 +915,8 @@ void Renderer::set_opengl_settings()
 		"layout(location = 0) uniform mat4 pv;"
 		"layout(location = 0) in vec3 inPos;"
 		"layout(location = 1) in vec2 inTextureCoord;"
-		"layout(location = 2) in float inTextureIndex;"
-		"layout(location = 3) in vec3 inNormal;"
+		"layout(location = 2) in uint inTextureIndex;"
+		"layout(location = 3) in vec4 inNormal;"
 		"layout(location = 0) out vec2 outTextureCoord;"
 		"layout(location = 1) flat out float outTextureIndex;"
 		"layout(location = 2) out vec3 outNormal;"
@@ -289,8 +926,9 @@ void Renderer::set_opengl_settings()
 		"	gl_Position = pv * vec4( inPos, 1.0f );"
 		"	outFragPos = inPos;"
 		"	outTextureCoord = inTextureCoord;"
-		"	outTextureIndex = inTextureIndex;"
-		"	outNormal = inNormal;"
+		"	outTextureIndex = float(inTextureIndex);"
+		//floors and ceilings keep the (x, 1, z) and (x, -1, z) normals they've always had
+		"	outNormal = inNormal.w != 0.0 ? vec3(inPos.x, inNormal.w, inPos.z) : inNormal.xyz;"
 		"}";
 
 	//fragment shader
@@ -317,258 +955,181 @@ void Renderer::set_opengl_settings()
 		"	outColor = vec4(ambient + diffuse + specular, 1.0);"
 		"}";
 
+	//pulled vertex shader, the same outputs rebuilt from PulledVertex and the sectors like SectorGeometry does on the cpu
+	//the structs only have scalar members, a vec2 would give them an 8 byte alignment and a 24 byte stride under std430
+	constexpr const char* pulled_vertex_shader_code =
+		"#version 430 core\n"
+		"struct PulledVertex"
+		"{"
+		"	float x, z;"
+		"	uint sector;"
+		"	uint height;"
+		"	uint normal;"
+		"};"
+		"struct SectorData"
+		"{"
+		"	float floor_height, ceil_height;"
+		"	uint wall_type, ceil_type, floor_type;"
+		"};"
+		"layout(std430, binding = 0) readonly buffer Vertices { PulledVertex vertices[]; };"
+		"layout(std430, binding = 1) readonly buffer Sectors { SectorData sectors[]; };"
+		"layout(location = 0) uniform mat4 pv;"
+		"layout(location = 0) out vec2 outTextureCoord;"
+		"layout(location = 1) flat out float outTextureIndex;"
+		"layout(location = 2) out vec3 outNormal;"
+		"layout(location = 3) out vec3 outFragPos;"
+		"void main()"
+		"{"
+		"	PulledVertex vertex = vertices[gl_VertexID];"
+		"	SectorData owner = sectors[vertex.sector];"
+		"	SectorData source = sectors[vertex.height >> 1];"
+		//steps reach to the neighbor's height but never past the owner's own floor and ceiling
+		"	float height = (vertex.height & 1u) != 0u ? min(source.ceil_height, owner.ceil_height) : max(source.floor_height, owner.floor_height);"
+		"	vec3 pos = vec3(vertex.x, height, vertex.z);"
+		//sign extend the 2_10_10_10 fields
+		"	int bits = int(vertex.normal);"
+		"	ivec4 normal = ivec4(bits << 22, bits << 12, bits << 2, bits) >> ivec4(22, 22, 22, 30);"
+		"	gl_Position = pv * vec4(pos, 1.0f);"
+		"	outFragPos = pos;"
+		"	if (normal.w != 0)"
+		"	{"
+		"		outTextureCoord = vec2(vertex.x, vertex.z) / 8.0f;"
+		"		outTextureIndex = float(normal.w > 0 ? owner.floor_type : owner.ceil_type);"
+		"		outNormal = vec3(vertex.x, float(normal.w), vertex.z);"
+		"	}"
+		"	else"
+		"	{"
+		"		outTextureCoord = vec2(((vertex.x + vertex.z) * (vertex.x - vertex.z)) / 64.0f, height) / 8.0f;"
+		"		outTextureIndex = float(owner.wall_type);"
+		"		outNormal = vec3(normal.xyz) / 511.0f;"
+		"	}"
+		"}";
+
 	main_shader = RasterShaderProgram
 	{
 		vertex_shader_code,
 		fragment_shader_code
 	};
+
+	pulled_shader = RasterShaderProgram
+	{
+		pulled_vertex_shader_code,
+		fragment_shader_code
+	};
 }
 
-void Renderer::init_game_objects()
+void Renderer::build_map_mesh()
 {
-	std::vector<Vertex> vertices;
-	std::vector<uint32_t> indices;
-	std::vector<std::string> texture_strings;
+	//turn the 2d sectors into 3d data on the thread pool
+	map_mesh = SectorMeshCache{ sectors, vertex_fetch, thread_pool };
+
+	gpu_culler = GpuCuller{ sectors, map_mesh.get_sector_ranges() };
+}
 
-	//load map from file
+void Renderer::update_map_mesh()
+{
+	if (software)
 	{
+		if (map_geometry_dirty)
 		{
-			std::ifstream map_file{ "map.sec" };
+			build_software_geometry();
+		}
+		else if (!moved_sectors.empty())
+		{
+			PROFILE_ZONE("regenerate_sector_geometry");
 
-			std::vector<glm::vec2> vertices;
+			thread_pool.parallel_for(moved_sectors.size(), [this](size_t i)
+				{
+					regenerate_sector_geometry(sectors, moved_sectors[i], map_slots[moved_sectors[i]], map_geometry);
+				});
 
-			//read file line by line and process
+			for (const auto sector : moved_sectors)
 			{
-				std::string line;
-				while (std::getline(map_file, line))
-				{
-					std::stringstream line_stream{ line };
-
-					std::string prefix_identifier;
-					line_stream >> prefix_identifier;
-
-					if (prefix_identifier.compare("vertex") == 0)
-					{
-						glm::vec2 vec{ 0.0f, 0.0f };
-
-						line_stream >> vec.x;
-
-						while (line_stream >> vec.y)
-						{
-							vertices.push_back(vec);
-						}
-					}
-					else if (prefix_identifier.compare("player") == 0)
-					{
-						glm::vec2 pos;
-						line_stream >> pos.x >> pos.y;
-
-						int64_t sector = -1;
-						for (size_t ii = 0; ii < sectors.size(); ii++)
-						{
-							for (size_t i = 0, j = sectors[ii].vertices.size() - 1; i < sectors[ii].vertices.size(); j = i++)
-							{
-								const auto& vert2 = sectors[ii].vertices[i];
-								const auto& vert1 = sectors[ii].vertices[j];
-
-								if ((vert1.y > pos.y) != (vert2.y > pos.y) &&
-									(pos.x < (vert2.x - vert1.x) * (pos.y - vert1.y) / (vert2.y - vert1.y) + vert1.x))
-								{
-									sector = ii;
-									break;
-								}
-							}
-						}
-
-						if (sector < 0)
-						{
-							sector = 0;
-						}
-
-						player = Player{ static_cast<uint32_t>(sector), glm::vec3{ pos.x, sectors[static_cast<size_t>(sector)].floor + Player::get_eye_height(), pos.y } };
-					}
-					else if (prefix_identifier.compare("sector") == 0)
-					{
-						Sector sector;
-
-						//get height
-						line_stream >> sector.floor >> sector.ceil;
-
-						//get material types
-						{
-							uint32_t wall_type, ceil_type, floor_type;
-							line_stream >> wall_type >> ceil_type >> floor_type;
-
-							sector.wall_type = wall_type;
-							sector.ceil_type = ceil_type;
-							sector.floor_type = floor_type;
-						}
-
-						std::vector<int64_t> integers;
-						{
-							int64_t get_integer;
-							while (line_stream >> get_integer)
-							{
-								integers.push_back(get_integer);
-							}
-						}
-
-						if (integers.size() < 6)
-						{
-							throw std::logic_error("Sector size must have at least 3 vertices & neighbors");
-						}
-
-						const size_t size = integers.size() / 2;
-
-						for (size_t i = 0; i < size; i++)
-						{
-							sector.vertices.push_back(vertices[static_cast<size_t>(integers[i])]);
-							sector.neighbors.push_back(static_cast<int32_t>(integers[i + size]));
-						}
-
-						sectors.push_back(sector);
-					}
-					else if (prefix_identifier.compare("texture") == 0)
-					{
-						std::string texture_name;
-						line_stream >> std::quoted(texture_name);
-
-						texture_strings.push_back(std::move(texture_name));
-					}
-				}
+				moved_flags[sector] = 0;
 			}
-			map_file.close();
+
+			moved_sectors.clear();
 		}
 
-		std::unordered_map<Vertex, uint32_t> unique_vertices;
+		return;
+	}
 
-		//lambda to add to indices and vertices easier
-		auto add_vertex = [&vertices, &indices, &unique_vertices](const Vertex& vertex)
-		{
-			if (unique_vertices.count(vertex) == 0)
-			{
-				unique_vertices[vertex] = static_cast<uint32_t>(vertices.size());
-				vertices.push_back(vertex);
-			}
+	if (!map_mesh.needs_update())
+	{
+		return;
+	}
 
-			indices.push_back(unique_vertices[vertex]);
-		};
+	const auto& updated = map_mesh.update(sectors, thread_pool);
 
-		//change 2d sectors into 3d data
-		for (auto& sector : sectors)
-		{
-			//create floor and ceiling
-			//we use triangle fans because convex sector
-			const Vertex main_floor_vert{ glm::vec3{sector.vertices[0].x, sector.floor, sector.vertices[0].y}, sector.vertices[0] / 8.0f, static_cast<float>(sector.floor_type), glm::vec3{sector.vertices[0].x, 1.0f, sector.vertices[0].y} };
-			const Vertex main_ceil_vert{ glm::vec3{sector.vertices[0].x, sector.ceil, sector.vertices[0].y}, sector.vertices[0] / 8.0f, static_cast<float>(sector.ceil_type), glm::vec3{sector.vertices[0].x, -1.0f, sector.vertices[0].y} };
+	//a rebuild moves everything
+	if (updated.size() == sectors.size())
+	{
+		gpu_culler = GpuCuller{ sectors, map_mesh.get_sector_ranges() };
+		return;
+	}
 
-			for (size_t i = 1; i < (sector.vertices.size() - 1); i++)
-			{
-				//construct floor triangle
-				{
-					const Vertex floor_vert1{ glm::vec3{sector.vertices[i].x, sector.floor, sector.vertices[i].y}, sector.vertices[i] / 8.0f, static_cast<float>(sector.floor_type), glm::vec3{sector.vertices[i].x, 1.0f, sector.vertices[i].y} };
-					const Vertex floor_vert2{ glm::vec3{sector.vertices[i + 1].x, sector.floor, sector.vertices[i + 1].y}, sector.vertices[i + 1] / 8.0f, static_cast<float>(sector.floor_type), glm::vec3{sector.vertices[i + 1].x, 1.0f, sector.vertices[i + 1].y} };
+	for (const auto sector : updated)
+	{
+		gpu_culler.update_sector(sector, sectors[sector], map_mesh.get_sector_ranges()[sector]);
+	}
+}
 
-					add_vertex(main_floor_vert);
-					add_vertex(floor_vert1);
-					add_vertex(floor_vert2);
-				}
-				//construct ceil triangle
-				{
-					const Vertex ceil_vert1{ glm::vec3{sector.vertices[i].x, sector.ceil, sector.vertices[i].y}, sector.vertices[i] / 8.0f, static_cast<float>(sector.ceil_type), glm::vec3{sector.vertices[i].x, -1.0f, sector.vertices[i].y} };
-					const Vertex ceil_vert2{ glm::vec3{sector.vertices[i + 1].x, sector.ceil, sector.vertices[i + 1].y}, sector.vertices[i + 1] / 8.0f, static_cast<float>(sector.ceil_type), glm::vec3{sector.vertices[i + 1].x, -1.0f, sector.vertices[i + 1].y} };
+void Renderer::build_software_geometry()
+{
+	//turn the 2d sectors into 3d data on the thread pool
+	//only movers need room to regenerate sectors in place, without them the welded mesh is smaller
+	if (movers.empty())
+	{
+		map_geometry = build_map_geometry(sectors, thread_pool);
+		map_slots.clear();
+	}
+	else
+	{
+		map_geometry = build_slotted_map_geometry(sectors, thread_pool, map_slots);
+	}
 
-					add_vertex(ceil_vert2);
-					add_vertex(ceil_vert1);
-					add_vertex(main_ceil_vert);
-				}
-			}
+	map_geometry_dirty = false;
 
-			//we construct wall vertices
-			for (size_t i = 0; i < sector.vertices.size(); i++)
-			{
-				const glm::vec2& v1 = sector.vertices[i];
-				//if this is the last vertex in the list, we use the first vertex in the list as the connector
-				const glm::vec2* v2;
-				if (i == sector.vertices.size() - 1)
-				{
-					v2 = &sector.vertices[0];
-				}
-				else
-				{
-					v2 = &sector.vertices[i + 1];
-				}
+	//the rebuild already has them
+	moved_sectors.clear();
+	moved_flags.assign(sectors.size(), 0);
+}
 
-				const glm::vec3 normal{ (v2->y - v1.y), 0.0f, -(v2->x - v1.x) };
+void Renderer::init_game_objects()
+{
+	std::vector<std::string> texture_strings;
 
-				const Vertex top_left{ glm::vec3{ v1.x, sector.ceil, v1.y }, glm::vec2{ ((v1.x + v1.y) * (v1.x - v1.y)) / 64.0f, sector.ceil } / 8.0f, static_cast<float>(sector.wall_type), normal };
-				const Vertex top_right{ glm::vec3{ v2->x, sector.ceil, v2->y }, glm::vec2{ ((v2->x + v2->y) * (v2->x - v2->y)) / 64.0f, sector.ceil } / 8.0f, static_cast<float>(sector.wall_type), normal };
-				const Vertex bottom_left{ glm::vec3{ v1.x, sector.floor, v1.y }, glm::vec2{ ((v1.x + v1.y) * (v1.x - v1.y)) / 64.0f, sector.floor } / 8.0f, static_cast<float>(sector.wall_type), normal };
-				const Vertex bottom_right{ glm::vec3{ v2->x, sector.floor, v2->y }, glm::vec2{((v2->x + v2->y) * (v2->x - v2->y)) / 64.0f, sector.floor } / 8.0f, static_cast<float>(sector.wall_type), normal };
+	//load map from file, the binary format is mapped straight into memory so prefer it, unless the text map was saved after it
+	if (map_filename.empty())
+	{
+		map_filename = "map.sec";
 
-				if (sector.neighbors[i] < 0)
-				{
-					//no neighbor, draw solid wall
-					add_vertex(top_left);
-					add_vertex(top_right);
-					add_vertex(bottom_left);
-
-					add_vertex(top_right);
-					add_vertex(bottom_right);
-					add_vertex(bottom_left);
-				}
-				else
-				{
-					//neighbor
-					const auto& neighbor_sector = sectors[sector.neighbors[i]];
-
-					if (neighbor_sector.ceil < sector.ceil)
-					{
-						//math from https://math.stackexchange.com/questions/1205733/how-to-convert-or-transform-from-one-range-to-another that I probably should've already learn't and not spend 3 hours on
-						//this is to make texture coords accurate and make it look like it got cut off, to fit with the other walls that are not portals
-						const float normal_diff =
-							((neighbor_sector.ceil - sector.floor) * (sector.ceil - sector.floor)
-							/
-							(sector.ceil - sector.floor)) + sector.floor;
-
-						const Vertex neighbor_top_left{ glm::vec3{ v1.x, neighbor_sector.ceil, v1.y }, glm::vec2{ ((v1.x + v1.y) * (v1.x - v1.y)) / 64.0f, normal_diff } / 8.0f, static_cast<float>(sector.wall_type), normal };
-						const Vertex neighbor_top_right{ glm::vec3{ v2->x, neighbor_sector.ceil, v2->y }, glm::vec2{ ((v2->x + v2->y) * (v2->x - v2->y)) / 64.0f,  normal_diff } / 8.0f, static_cast<float>(sector.wall_type), normal };
-
-						add_vertex(top_left);
-						add_vertex(top_right);
-						add_vertex(neighbor_top_left);
-
-						add_vertex(top_right);
-						add_vertex(neighbor_top_right);
-						add_vertex(neighbor_top_left);
-					}
-
-					if (neighbor_sector.floor > sector.floor)
-					{
-						//more math from stackexchange
-						//texture coord accuracy
-						const float normal_diff =
-							((neighbor_sector.floor - sector.floor) * (sector.ceil - sector.floor)
-								/
-								(sector.ceil - sector.floor)) + sector.floor;
-
-						const Vertex neighbor_bottom_left{ glm::vec3{ v1.x, neighbor_sector.floor, v1.y }, glm::vec2{ ((v1.x + v1.y) * (v1.x - v1.y)) / 64.0f, normal_diff } / 8.0f, static_cast<float>(sector.wall_type), normal };
-						const Vertex neighbor_bottom_right{ glm::vec3{ v2->x, neighbor_sector.floor, v2->y }, glm::vec2{((v2->x + v2->y) * (v2->x - v2->y)) / 64.0f, normal_diff } / 8.0f, static_cast<float>(sector.wall_type), normal };
-
-						add_vertex(neighbor_bottom_left);
-						add_vertex(neighbor_bottom_right);
-						add_vertex(bottom_left);
-
-						add_vertex(neighbor_bottom_right);
-						add_vertex(bottom_right);
-						add_vertex(bottom_left);
-					}
-				}
-			}
+		std::error_code error;
+		const bool has_binary = std::filesystem::exists("map.secb", error);
+		const bool has_text = std::filesystem::exists("map.sec", error);
+
+		if (has_binary && (!has_text || std::filesystem::last_write_time("map.secb", error) >= std::filesystem::last_write_time("map.sec", error)))
+		{
+			map_filename = "map.secb";
 		}
 	}
 
-	map_mesh = Mesh{ vertices, indices };
+	const bool is_binary = std::filesystem::path{ map_filename }.extension() == ".secb";
+
+	std::cerr << "Loading map " << map_filename << '\n';
+
+	if (is_binary)
+	{
+		const MappedMap mapped_map{ map_filename.c_str() };
+
+		load_map(mapped_map.view(), texture_strings);
+	}
+	else
+	{
+		const MapData map_data = read_text_map(map_filename.c_str());
+
+		load_map(map_data.view(), texture_strings);
+	}
 
 	//copy pointers
 	std::vector<const char*> textures;
@@ -577,13 +1138,107 @@ void Renderer::init_game_objects()
 		textures.push_back(texture_str.c_str());
 	}
 
-	//build the texture array used in shaders
-	texture_array = TextureArray2d{ textures, 512, 512 };
+	//the portal renderer draws straight from the sectors, there is no mesh
+	if (portal_renderer)
+	{
+		portal_renderer->load_textures(textures, 512, 512);
+		return;
+	}
+
+	if (software)
+	{
+		build_software_geometry();
+
+		//the block compressed cache is only for the gpu
+		software_rasterizer->load_textures(textures, 512, 512);
+		return;
+	}
+
+	build_map_mesh();
+
+	//a cooked texture cache next to the map skips decoding and mipmapping entirely
+	const std::string cache_filename = std::filesystem::path{ map_filename }.replace_extension(".texc").string();
+	if (std::filesystem::exists(cache_filename))
+	{
+		const TextureCache cache = read_texture_cache(cache_filename.c_str());
+
+		if (!cache.matches(texture_strings, 512, 512))
+		{
+			std::cerr << "Texture cache " << cache_filename << " doesn't match the map's textures, rerun TextureCooker\n";
+		}
+		else if (!TextureArray2d::supports_format(cache.format))
+		{
+			std::cerr << "Texture cache " << cache_filename << " uses a block format this driver doesn't support\n";
+		}
+		else
+		{
+			texture_array = TextureArray2d{ cache };
+			return;
+		}
+	}
+
+	//the layers are decoded on the thread pool and show up over the first few frames
+	texture_array = TextureArray2d{ textures, 512, 512, thread_pool };
+}
+
+void Renderer::load_map(const MapView& map, std::vector<std::string>& texture_strings)
+{
+	sectors.clear();
+	sectors.reserve(map.sector_count);
+
+	for (uint32_t s = 0; s < map.sector_count; s++)
+	{
+		const auto& record = map.sectors[s];
+
+		Sector sector;
+
+		sector.floor = record.floor;
+		sector.ceil = record.ceil;
+
+		sector.wall_type = record.wall_type;
+		sector.ceil_type = record.ceil_type;
+		sector.floor_type = record.floor_type;
+
+		sector.vertices.reserve(record.count);
+		for (uint32_t i = record.first; i < record.first + record.count; i++)
+		{
+			sector.vertices.push_back(map.vertices[map.indices[i]]);
+		}
+
+		sector.neighbors.assign(map.neighbors + record.first, map.neighbors + record.first + record.count);
+
+		sectors.push_back(std::move(sector));
+	}
+
+	sector_index.build(sectors);
+	collision_world.build(sectors);
+
+	if (map.has_player)
+	{
+		const glm::vec2 pos = map.player_pos;
+
+		int32_t sector = sector_index.find_sector(pos);
+		if (sector < 0)
+		{
+			sector = 0;
+		}
+
+		player = Player{ static_cast<uint32_t>(sector), glm::vec3{ pos.x, sectors[static_cast<size_t>(sector)].floor + Player::get_eye_height(), pos.y } };
+	}
+
+	texture_strings.clear();
+	for (uint32_t i = 0; i < map.texture_count; i++)
+	{
+		texture_strings.emplace_back(map.texture(i));
+	}
 }
 
 void Renderer::destroy_window_renderer()
 {
-	SDL_GL_DeleteContext(context);
+	if (context)
+	{
+		SDL_GL_DeleteContext(context);
+	}
 
 	SDL_DestroyWindow(window);
 
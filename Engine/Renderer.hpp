@@ -2,8 +2,10 @@
 #define RENDERER_OPENGL_VEOT_HPP
 
 #include <vector>
+#include <string>
 #include <array>
 #include <chrono>
+#include <memory>
 
 #include <glad/glad.h>
 
@@ -16,21 +18,108 @@
 
 #include "RenderData.hpp"
 
+#include "PortalCuller.hpp"
+
+#include "GpuCuller.hpp"
+
+#include "SectorMeshCache.hpp"
+
+#include "SectorGeometry.hpp"
+
+#include "SectorMovers.hpp"
+
+#include "ThreadPool.hpp"
+
 #include "Sector.hpp"
 
+#include "SectorIndex.hpp"
+
+#include "SoftwareRasterizer.hpp"
+
+#include "PortalRenderer.hpp"
+
+#include "Benchmark.hpp"
+
+#include "Profiler.hpp"
+
+struct MapView;
+
+enum class RenderBackend
+{
+	OPENGL,
+	//the triangle mesh rasterized on the cpu
+	SOFTWARE,
+	//column raycasting through the sector portals on the cpu
+	PORTAL
+};
+
+enum class CullingMode
+{
+	//walks the portals from the player's sector on the cpu
+	PORTAL,
+	//tests every sector against the frustum in a compute shader
+	FRUSTUM
+};
+
 class Renderer
 {
 	SDL_Window* window;
-	SDL_GLContext context;
+	SDL_GLContext context = nullptr;
+
+	ThreadPool thread_pool;
 
 	RasterShaderProgram main_shader;
 
+	//main_shader's lighting with vertices pulled from storage buffers
+	RasterShaderProgram pulled_shader;
+
 	TextureArray2d texture_array;
 
-	Mesh map_mesh;
+	SectorMeshCache map_mesh;
+
+	PortalCuller portal_culler;
+
+	//scratch lists for drawing only the visible sectors, kept around to avoid reallocating every frame
+	std::vector<uint32_t> visible_sectors;
+	std::vector<MeshRange> visible_ranges;
+	std::vector<DrawElementsIndirectCommand> draw_commands;
+
+	DrawCommandBuffer draw_command_buffer;
+
+	CullingMode culling = CullingMode::PORTAL;
+
+	//also used when the player is outside of the map, where there are no portals to walk
+	GpuCuller gpu_culler;
+
+	VertexFetch vertex_fetch = VertexFetch::ATTRIBUTES;
+
+	RenderBackend backend;
+
+	//renders on the cpu instead of OpenGL, there is no GL context at all then
+	bool software;
+	std::unique_ptr<SoftwareRasterizer> software_rasterizer;
+	std::unique_ptr<PortalRenderer> portal_renderer;
+
+	//the software renderer keeps the map mesh on the cpu, once there are movers every sector gets a slot so moving heights are regenerated in place
+	MapGeometry map_geometry;
+	std::vector<GeometrySlot> map_slots;
+
+	//set_sector() changed something the software renderer's mesh doesn't have yet, it's rebuilt whole
+	bool map_geometry_dirty = false;
+
+	//sectors the movers changed and their neighbors, whose steps follow them, regenerated on the next frame
+	std::vector<uint32_t> moved_sectors;
+	std::vector<uint8_t> moved_flags;
 
 	std::vector<Sector> sectors;
 
+	SectorIndex sector_index;
+
+	CollisionWorld collision_world;
+
+	//moving floors and ceilings, they change sectors in place
+	SectorMovers movers;
+
 	Player player;
 
 	std::array<bool, 4> wasd;
@@ -39,8 +128,25 @@ class Renderer
 	Uint64 prev_time = 0;
 	double delta_time = 0;
 
+	//real time the simulation hasn't stepped through yet, and how far that is into the next step
+	double simulation_time = 0;
+	float simulation_alpha = 1.0f;
+
 	bool is_running;
 
+	//no visible window or mouse grab, for benchmarks
+	bool headless;
+
+	std::string map_filename;
+
+	//the player's path is written here when the renderer quits if it isn't empty
+	std::string record_filename;
+	std::vector<CameraKey> recorded_path;
+	double record_timer = 0.0;
+
+	//F4 starts and stops a chrome trace written here
+	std::string trace_filename = "trace.json";
+
 	//window size
 	int32_t window_width, window_height;
 
@@ -52,20 +158,81 @@ class Renderer
 
 	void init_game_objects();
 
+	void load_map(const MapView& map, std::vector<std::string>& texture_strings);
+
+	//builds map_mesh in the current vertex format and the culler indexing it
+	void build_map_mesh();
+
+	//remeshes whatever set_sector() changed since the last frame
+	void update_map_mesh();
+
+	//moves the movers and hands the new heights to whatever draws the map
+	void update_movers(double step);
+
+	//one fixed step of the movers and the player
+	void step_simulation(Player::MoveDir dir);
+
+	void build_software_geometry();
+
+	//queues a sector and its neighbors for regenerating in the software mesh
+	void mark_sector_moved(uint32_t index);
+
 	void destroy_window_renderer();
 
 public:
-	explicit Renderer();
+	//an empty map filename loads whichever of map.secb and map.sec in the working directory was saved last
+	explicit Renderer(const std::string& map_filename = "", bool headless = false, RenderBackend backend = RenderBackend::OPENGL);
 
 	~Renderer();
 
 	void run();
 
+	//records the player's movement during run() so it can be replayed with run_benchmark()
+	void record_camera_path(const std::string& filename);
+
+	//frustum culling only exists on the gpu backend
+	void set_culling(CullingMode culling);
+
+	//rebuilds the map mesh in the other format, only the gl backend has one
+	void set_vertex_fetch(VertexFetch vertex_fetch);
+
+	//replaces one sector, only it and the sectors it has portals to are remeshed before the next frame
+	void set_sector(uint32_t index, const Sector& sector);
+
+	//with vertex pulling a moving sector costs one small upload a frame, otherwise it's remeshed with its neighbors
+	void add_mover(const SectorMover& mover);
+
+	const std::vector<Sector>& get_sectors() const
+	{
+		return sectors;
+	}
+
+	//starts capturing a chrome trace right away, it's written when run() or run_benchmark() finishes
+	void capture_trace(const std::string& filename);
+
+	//replays a camera path into an offscreen framebuffer and writes the frame times as json
+	void run_benchmark(const BenchmarkSettings& settings);
+
 private:
 	void get_events();
 
 	void handle_events();
 
+	void record_frame();
+
+	void toggle_trace();
+
+	//renders the current view into whatever framebuffer is bound, or the cpu renderer's buffer
+	void draw_scene();
+
+	void resize_software();
+
+	//the cpu renderer's rgba8 buffer, top row first
+	const std::vector<uint32_t>& get_software_pixels() const;
+
+	//copies the cpu renderer's buffer to the window
+	void present_software();
+
 	void draw();
 };
 
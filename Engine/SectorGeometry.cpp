@@ -0,0 +1,387 @@
+#include "SectorGeometry.hpp"
+
+#include <algorithm>
+
+//sectors are generated in contiguous chunks, a few per thread so uneven chunks balance out
+constexpr size_t CHUNKS_PER_THREAD = 4;
+
+SectorGeometrySize count_sector_geometry(const std::vector<Sector>& sectors, size_t sector_index)
+{
+	const auto& sector = sectors[sector_index];
+
+	//floor and ceiling fans
+	SectorGeometrySize size{ (sector.vertices.size() - 2) * 6, sector.vertices.size() * 2 };
+
+	for (size_t i = 0; i < sector.vertices.size(); i++)
+	{
+		size_t quads = 1;
+		if (sector.neighbors[i] >= 0)
+		{
+			const auto& neighbor_sector = sectors[sector.neighbors[i]];
+			quads = (neighbor_sector.ceil < sector.ceil ? 1 : 0) + (neighbor_sector.floor > sector.floor ? 1 : 0);
+		}
+
+		size.indices += quads * 6;
+		size.vertices += quads * 4;
+	}
+
+	return size;
+}
+
+SectorGeometrySize max_sector_geometry(const Sector& sector)
+{
+	SectorGeometrySize size{ (sector.vertices.size() - 2) * 6, sector.vertices.size() * 2 };
+
+	for (const auto neighbor : sector.neighbors)
+	{
+		const size_t quads = neighbor >= 0 ? 2 : 1;
+
+		size.indices += quads * 6;
+		size.vertices += quads * 4;
+	}
+
+	return size;
+}
+
+void generate_sector_geometry(const std::vector<Sector>& sectors, size_t sector_index, VertexWelder<Vertex>& welder, std::vector<uint32_t>& indices)
+{
+	const auto& sector = sectors[sector_index];
+
+	//lambda to add to indices and vertices easier
+	auto add_vertex = [&indices, &welder](const Vertex& vertex)
+	{
+		indices.push_back(welder.add(vertex));
+	};
+
+	//create floor and ceiling
+	//we use triangle fans because convex sector
+	const Vertex main_floor_vert{ glm::vec3{sector.vertices[0].x, sector.floor, sector.vertices[0].y}, sector.vertices[0] / 8.0f, static_cast<float>(sector.floor_type), glm::vec3{sector.vertices[0].x, 1.0f, sector.vertices[0].y} };
+	const Vertex main_ceil_vert{ glm::vec3{sector.vertices[0].x, sector.ceil, sector.vertices[0].y}, sector.vertices[0] / 8.0f, static_cast<float>(sector.ceil_type), glm::vec3{sector.vertices[0].x, -1.0f, sector.vertices[0].y} };
+
+	for (size_t i = 1; i < (sector.vertices.size() - 1); i++)
+	{
+		//construct floor triangle
+		{
+			const Vertex floor_vert1{ glm::vec3{sector.vertices[i].x, sector.floor, sector.vertices[i].y}, sector.vertices[i] / 8.0f, static_cast<float>(sector.floor_type), glm::vec3{sector.vertices[i].x, 1.0f, sector.vertices[i].y} };
+			const Vertex floor_vert2{ glm::vec3{sector.vertices[i + 1].x, sector.floor, sector.vertices[i + 1].y}, sector.vertices[i + 1] / 8.0f, static_cast<float>(sector.floor_type), glm::vec3{sector.vertices[i + 1].x, 1.0f, sector.vertices[i + 1].y} };
+
+			add_vertex(main_floor_vert);
+			add_vertex(floor_vert1);
+			add_vertex(floor_vert2);
+		}
+		//construct ceil triangle
+		{
+			const Vertex ceil_vert1{ glm::vec3{sector.vertices[i].x, sector.ceil, sector.vertices[i].y}, sector.vertices[i] / 8.0f, static_cast<float>(sector.ceil_type), glm::vec3{sector.vertices[i].x, -1.0f, sector.vertices[i].y} };
+			const Vertex ceil_vert2{ glm::vec3{sector.vertices[i + 1].x, sector.ceil, sector.vertices[i + 1].y}, sector.vertices[i + 1] / 8.0f, static_cast<float>(sector.ceil_type), glm::vec3{sector.vertices[i + 1].x, -1.0f, sector.vertices[i + 1].y} };
+
+			add_vertex(ceil_vert2);
+			add_vertex(ceil_vert1);
+			add_vertex(main_ceil_vert);
+		}
+	}
+
+	//we construct wall vertices
+	for (size_t i = 0; i < sector.vertices.size(); i++)
+	{
+		const glm::vec2& v1 = sector.vertices[i];
+		//if this is the last vertex in the list, we use the first vertex in the list as the connector
+		const glm::vec2* v2;
+		if (i == sector.vertices.size() - 1)
+		{
+			v2 = &sector.vertices[0];
+		}
+		else
+		{
+			v2 = &sector.vertices[i + 1];
+		}
+
+		const glm::vec3 normal{ (v2->y - v1.y), 0.0f, -(v2->x - v1.x) };
+
+		const Vertex top_left{ glm::vec3{ v1.x, sector.ceil, v1.y }, glm::vec2{ ((v1.x + v1.y) * (v1.x - v1.y)) / 64.0f, sector.ceil } / 8.0f, static_cast<float>(sector.wall_type), normal };
+		const Vertex top_right{ glm::vec3{ v2->x, sector.ceil, v2->y }, glm::vec2{ ((v2->x + v2->y) * (v2->x - v2->y)) / 64.0f, sector.ceil } / 8.0f, static_cast<float>(sector.wall_type), normal };
+		const Vertex bottom_left{ glm::vec3{ v1.x, sector.floor, v1.y }, glm::vec2{ ((v1.x + v1.y) * (v1.x - v1.y)) / 64.0f, sector.floor } / 8.0f, static_cast<float>(sector.wall_type), normal };
+		const Vertex bottom_right{ glm::vec3{ v2->x, sector.floor, v2->y }, glm::vec2{((v2->x + v2->y) * (v2->x - v2->y)) / 64.0f, sector.floor } / 8.0f, static_cast<float>(sector.wall_type), normal };
+
+		if (sector.neighbors[i] < 0)
+		{
+			//no neighbor, draw solid wall
+			add_vertex(top_left);
+			add_vertex(top_right);
+			add_vertex(bottom_left);
+
+			add_vertex(top_right);
+			add_vertex(bottom_right);
+			add_vertex(bottom_left);
+		}
+		else
+		{
+			//neighbor
+			const auto& neighbor_sector = sectors[sector.neighbors[i]];
+
+			if (neighbor_sector.ceil < sector.ceil)
+			{
+				//math from https://math.stackexchange.com/questions/1205733/how-to-convert-or-transform-from-one-range-to-another that I probably should've already learn't and not spend 3 hours on
+				//this is to make texture coords accurate and make it look like it got cut off, to fit with the other walls that are not portals
+				const float normal_diff =
+					((neighbor_sector.ceil - sector.floor) * (sector.ceil - sector.floor)
+					/
+					(sector.ceil - sector.floor)) + sector.floor;
+
+				const Vertex neighbor_top_left{ glm::vec3{ v1.x, neighbor_sector.ceil, v1.y }, glm::vec2{ ((v1.x + v1.y) * (v1.x - v1.y)) / 64.0f, normal_diff } / 8.0f, static_cast<float>(sector.wall_type), normal };
+				const Vertex neighbor_top_right{ glm::vec3{ v2->x, neighbor_sector.ceil, v2->y }, glm::vec2{ ((v2->x + v2->y) * (v2->x - v2->y)) / 64.0f,  normal_diff } / 8.0f, static_cast<float>(sector.wall_type), normal };
+
+				add_vertex(top_left);
+				add_vertex(top_right);
+				add_vertex(neighbor_top_left);
+
+				add_vertex(top_right);
+				add_vertex(neighbor_top_right);
+				add_vertex(neighbor_top_left);
+			}
+
+			if (neighbor_sector.floor > sector.floor)
+			{
+				//more math from stackexchange
+				//texture coord accuracy
+				const float normal_diff =
+					((neighbor_sector.floor - sector.floor) * (sector.ceil - sector.floor)
+						/
+						(sector.ceil - sector.floor)) + sector.floor;
+
+				const Vertex neighbor_bottom_left{ glm::vec3{ v1.x, neighbor_sector.floor, v1.y }, glm::vec2{ ((v1.x + v1.y) * (v1.x - v1.y)) / 64.0f, normal_diff } / 8.0f, static_cast<float>(sector.wall_type), normal };
+				const Vertex neighbor_bottom_right{ glm::vec3{ v2->x, neighbor_sector.floor, v2->y }, glm::vec2{((v2->x + v2->y) * (v2->x - v2->y)) / 64.0f, normal_diff } / 8.0f, static_cast<float>(sector.wall_type), normal };
+
+				add_vertex(neighbor_bottom_left);
+				add_vertex(neighbor_bottom_right);
+				add_vertex(bottom_left);
+
+				add_vertex(neighbor_bottom_right);
+				add_vertex(bottom_right);
+				add_vertex(bottom_left);
+			}
+		}
+	}
+}
+
+void generate_sector_pulled_geometry(const std::vector<Sector>& sectors, size_t sector_index, VertexWelder<PulledVertex>& welder, std::vector<uint32_t>& indices)
+{
+	const auto& sector = sectors[sector_index];
+	const uint32_t owner = static_cast<uint32_t>(sector_index);
+
+	auto add_vertex = [&indices, &welder](const PulledVertex& vertex)
+	{
+		indices.push_back(welder.add(vertex));
+	};
+
+	const uint32_t floor_normal = pack_normal(glm::vec3{ 0.0f, 1.0f, 0.0f });
+	const uint32_t ceil_normal = pack_normal(glm::vec3{ 0.0f, -1.0f, 0.0f });
+
+	//same fans and winding as generate_sector_geometry
+	const PulledVertex main_floor_vert{ sector.vertices[0], owner, make_height_ref(owner, false), floor_normal };
+	const PulledVertex main_ceil_vert{ sector.vertices[0], owner, make_height_ref(owner, true), ceil_normal };
+
+	for (size_t i = 1; i < (sector.vertices.size() - 1); i++)
+	{
+		add_vertex(main_floor_vert);
+		add_vertex(PulledVertex{ sector.vertices[i], owner, make_height_ref(owner, false), floor_normal });
+		add_vertex(PulledVertex{ sector.vertices[i + 1], owner, make_height_ref(owner, false), floor_normal });
+
+		add_vertex(PulledVertex{ sector.vertices[i + 1], owner, make_height_ref(owner, true), ceil_normal });
+		add_vertex(PulledVertex{ sector.vertices[i], owner, make_height_ref(owner, true), ceil_normal });
+		add_vertex(main_ceil_vert);
+	}
+
+	for (size_t i = 0; i < sector.vertices.size(); i++)
+	{
+		const glm::vec2& v1 = sector.vertices[i];
+		const glm::vec2& v2 = sector.vertices[i == sector.vertices.size() - 1 ? 0 : i + 1];
+
+		const uint32_t normal = pack_normal(glm::vec3{ (v2.y - v1.y), 0.0f, -(v2.x - v1.x) });
+
+		//a quad from the bottom height to the top height along the wall
+		auto add_quad = [&](uint32_t top, uint32_t bottom)
+		{
+			const PulledVertex top_left{ v1, owner, top, normal };
+			const PulledVertex top_right{ v2, owner, top, normal };
+			const PulledVertex bottom_left{ v1, owner, bottom, normal };
+			const PulledVertex bottom_right{ v2, owner, bottom, normal };
+
+			add_vertex(top_left);
+			add_vertex(top_right);
+			add_vertex(bottom_left);
+
+			add_vertex(top_right);
+			add_vertex(bottom_right);
+			add_vertex(bottom_left);
+		};
+
+		if (sector.neighbors[i] < 0)
+		{
+			add_quad(make_height_ref(owner, true), make_height_ref(owner, false));
+			continue;
+		}
+
+		//both steps are always there, the shader's clamping flattens the ones that don't exist at the current heights,
+		//so moving a floor or ceiling only ever changes the sector data
+		const uint32_t neighbor = static_cast<uint32_t>(sector.neighbors[i]);
+
+		add_quad(make_height_ref(owner, true), make_height_ref(neighbor, true));
+		add_quad(make_height_ref(neighbor, false), make_height_ref(owner, false));
+	}
+}
+
+//chunks of sectors are generated on the thread pool, then merged in order
+template<typename T, typename Generate>
+static BasicMapGeometry<T> build_geometry(const std::vector<Sector>& sectors, ThreadPool& thread_pool, Generate generate)
+{
+	struct ChunkGeometry
+	{
+		size_t first_sector, sector_count;
+
+		std::vector<T> vertices;
+		std::vector<uint32_t> indices;
+		std::vector<MeshRange> sector_ranges;
+
+		size_t first_vertex, first_index;
+	};
+
+	const size_t chunk_count = std::min(sectors.size(), std::max<size_t>(1, thread_pool.get_thread_count() + 1) * CHUNKS_PER_THREAD);
+
+	std::vector<ChunkGeometry> chunks(chunk_count);
+	for (size_t c = 0; c < chunk_count; c++)
+	{
+		chunks[c].first_sector = sectors.size() * c / chunk_count;
+		chunks[c].sector_count = sectors.size() * (c + 1) / chunk_count - chunks[c].first_sector;
+	}
+
+	//generate every chunk into its own buffers, vertices are welded within a chunk
+	thread_pool.parallel_for(chunk_count, [&sectors, &chunks, &generate](size_t c)
+		{
+			auto& chunk = chunks[c];
+
+			SectorGeometrySize size{ 0, 0 };
+			for (size_t s = chunk.first_sector; s < chunk.first_sector + chunk.sector_count; s++)
+			{
+				const auto sector_size = count_sector_geometry(sectors, s);
+
+				size.indices += sector_size.indices;
+				size.vertices += sector_size.vertices;
+			}
+
+			chunk.indices.reserve(size.indices);
+			chunk.vertices.reserve(size.vertices);
+			chunk.sector_ranges.reserve(chunk.sector_count);
+
+			VertexWelder<T> welder{ chunk.vertices, size.vertices };
+
+			for (size_t s = chunk.first_sector; s < chunk.first_sector + chunk.sector_count; s++)
+			{
+				const uint32_t first_index = static_cast<uint32_t>(chunk.indices.size());
+
+				generate(sectors, s, welder, chunk.indices);
+
+				chunk.sector_ranges.push_back(MeshRange{ first_index, static_cast<uint32_t>(chunk.indices.size()) - first_index });
+			}
+		});
+
+	//prefix sum of the chunk sizes gives every chunk its place in the merged buffers
+	BasicMapGeometry<T> geometry;
+
+	size_t vertex_count = 0;
+	size_t index_count = 0;
+	for (auto& chunk : chunks)
+	{
+		chunk.first_vertex = vertex_count;
+		chunk.first_index = index_count;
+
+		vertex_count += chunk.vertices.size();
+		index_count += chunk.indices.size();
+	}
+
+	geometry.vertices.resize(vertex_count);
+	geometry.indices.resize(index_count);
+	geometry.sector_ranges.resize(sectors.size());
+
+	//copy the chunks into place, rebasing their indices
+	thread_pool.parallel_for(chunk_count, [&geometry, &chunks](size_t c)
+		{
+			auto& chunk = chunks[c];
+
+			std::copy(chunk.vertices.begin(), chunk.vertices.end(), geometry.vertices.begin() + chunk.first_vertex);
+
+			const uint32_t first_vertex = static_cast<uint32_t>(chunk.first_vertex);
+			std::transform(chunk.indices.begin(), chunk.indices.end(), geometry.indices.begin() + chunk.first_index,
+				[first_vertex](uint32_t index)
+				{
+					return index + first_vertex;
+				});
+
+			const uint32_t first_index = static_cast<uint32_t>(chunk.first_index);
+			std::transform(chunk.sector_ranges.begin(), chunk.sector_ranges.end(), geometry.sector_ranges.begin() + chunk.first_sector,
+				[first_index](const MeshRange& range)
+				{
+					return MeshRange{ range.first + first_index, range.count };
+				});
+
+			//free as we go, the merged buffers already hold a second copy
+			chunk.vertices = std::vector<T>{};
+			chunk.indices = std::vector<uint32_t>{};
+		});
+
+	return geometry;
+}
+
+MapGeometry build_map_geometry(const std::vector<Sector>& sectors, ThreadPool& thread_pool)
+{
+	return build_geometry<Vertex>(sectors, thread_pool, generate_sector_geometry);
+}
+
+MapGeometry build_slotted_map_geometry(const std::vector<Sector>& sectors, ThreadPool& thread_pool, std::vector<GeometrySlot>& slots)
+{
+	slots.resize(sectors.size());
+
+	uint32_t vertex_count = 0;
+	uint32_t index_count = 0;
+	for (size_t s = 0; s < sectors.size(); s++)
+	{
+		const auto size = max_sector_geometry(sectors[s]);
+
+		slots[s] = GeometrySlot{ vertex_count, static_cast<uint32_t>(size.vertices), index_count, static_cast<uint32_t>(size.indices) };
+
+		vertex_count += static_cast<uint32_t>(size.vertices);
+		index_count += static_cast<uint32_t>(size.indices);
+	}
+
+	MapGeometry geometry;
+	geometry.vertices.resize(vertex_count);
+	geometry.indices.resize(index_count);
+	geometry.sector_ranges.resize(sectors.size());
+
+	thread_pool.parallel_for(sectors.size(), [&sectors, &slots, &geometry](size_t s)
+		{
+			regenerate_sector_geometry(sectors, s, slots[s], geometry);
+		});
+
+	return geometry;
+}
+
+void regenerate_sector_geometry(const std::vector<Sector>& sectors, size_t sector_index, const GeometrySlot& slot, MapGeometry& geometry)
+{
+	//welded on its own so nothing outside the slot refers to its vertices
+	std::vector<Vertex> vertices;
+	std::vector<uint32_t> indices;
+
+	VertexWelder<Vertex> welder{ vertices, slot.vertex_capacity };
+
+	generate_sector_geometry(sectors, sector_index, welder, indices);
+
+	std::copy(vertices.begin(), vertices.end(), geometry.vertices.begin() + slot.first_vertex);
+
+	std::transform(indices.begin(), indices.end(), geometry.indices.begin() + slot.first_index,
+		[&slot](uint32_t index)
+		{
+			return index + slot.first_vertex;
+		});
+
+	geometry.sector_ranges[sector_index] = MeshRange{ slot.first_index, static_cast<uint32_t>(indices.size()) };
+}
@@ -0,0 +1,64 @@
+#ifndef SECTOR_GEOMETRY_HPP
+#define SECTOR_GEOMETRY_HPP
+
+#include <vector>
+#include <cstdint>
+#include <cstddef>
+
+#include "RenderData.hpp"
+
+#include "Sector.hpp"
+
+#include "ThreadPool.hpp"
+
+#include "VertexWelder.hpp"
+
+struct SectorGeometrySize
+{
+	//exact number of indices, and the most vertices that can be left after welding
+	size_t indices, vertices;
+};
+
+//how much a sector turns into, depends on the heights of its neighbors
+SectorGeometrySize count_sector_geometry(const std::vector<Sector>& sectors, size_t sector_index);
+
+//the most a sector can turn into whatever its neighbors' heights are, every portal having both steps
+SectorGeometrySize max_sector_geometry(const Sector& sector);
+
+//appends the floor, ceiling and walls of one sector
+void generate_sector_geometry(const std::vector<Sector>& sectors, size_t sector_index, VertexWelder<Vertex>& welder, std::vector<uint32_t>& indices);
+
+//the same triangles as generate_sector_geometry plus both steps on every portal, which the vertex shader flattens when they don't exist
+//heights, texture coordinates and materials are left for the vertex shader to look up
+void generate_sector_pulled_geometry(const std::vector<Sector>& sectors, size_t sector_index, VertexWelder<PulledVertex>& welder, std::vector<uint32_t>& indices);
+
+template<typename T>
+struct BasicMapGeometry
+{
+	std::vector<T> vertices;
+	std::vector<uint32_t> indices;
+
+	//index range of every sector, in sector order
+	std::vector<MeshRange> sector_ranges;
+};
+
+using MapGeometry = BasicMapGeometry<Vertex>;
+
+//generates every sector in parallel and merges the results into one vertex and index buffer
+MapGeometry build_map_geometry(const std::vector<Sector>& sectors, ThreadPool& thread_pool);
+
+//room for one sector's worst case in a slotted build
+struct GeometrySlot
+{
+	uint32_t first_vertex, vertex_capacity;
+	uint32_t first_index, index_capacity;
+};
+
+//like build_map_geometry but every sector gets a slot that fits it whatever its neighbors' heights are,
+//so a sector whose heights changed can be regenerated in place, the unused parts of slots are never in sector_ranges
+MapGeometry build_slotted_map_geometry(const std::vector<Sector>& sectors, ThreadPool& thread_pool, std::vector<GeometrySlot>& slots);
+
+//redoes one sector of a slotted build, its vertices and portals have to be the ones the slots were made for
+void regenerate_sector_geometry(const std::vector<Sector>& sectors, size_t sector_index, const GeometrySlot& slot, MapGeometry& geometry);
+
+#endif
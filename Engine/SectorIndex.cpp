@@ -0,0 +1,169 @@
+#include "SectorIndex.hpp"
+
+#include <algorithm>
+#include <limits>
+
+//leaves hold at most this many sectors
+constexpr uint32_t MAX_LEAF_SECTORS = 4;
+
+//median splits keep the tree balanced, so this is plenty for any 32 bit sector count
+constexpr size_t MAX_TREE_DEPTH = 64;
+
+bool point_in_sector(const Sector& sector, glm::vec2 point)
+{
+	bool inside = false;
+
+	for (size_t i = 0, j = sector.vertices.size() - 1; i < sector.vertices.size(); j = i++)
+	{
+		const auto& vert1 = sector.vertices[j];
+		const auto& vert2 = sector.vertices[i];
+
+		if ((vert1.y > point.y) != (vert2.y > point.y) &&
+			(point.x < (vert2.x - vert1.x) * (point.y - vert1.y) / (vert2.y - vert1.y) + vert1.x))
+		{
+			inside = !inside;
+		}
+	}
+
+	return inside;
+}
+
+void SectorIndex::build(const std::vector<Sector>& sectors)
+{
+	this->sectors = &sectors;
+
+	nodes.clear();
+	sector_order.clear();
+	sector_mins.clear();
+	sector_maxs.clear();
+
+	if (sectors.empty())
+	{
+		return;
+	}
+
+	sector_mins.reserve(sectors.size());
+	sector_maxs.reserve(sectors.size());
+	sector_order.reserve(sectors.size());
+
+	for (size_t i = 0; i < sectors.size(); i++)
+	{
+		glm::vec2 min{ std::numeric_limits<float>::max() };
+		glm::vec2 max{ std::numeric_limits<float>::lowest() };
+
+		for (const auto& vertex : sectors[i].vertices)
+		{
+			min = glm::min(min, vertex);
+			max = glm::max(max, vertex);
+		}
+
+		sector_mins.push_back(min);
+		sector_maxs.push_back(max);
+		sector_order.push_back(static_cast<uint32_t>(i));
+	}
+
+	//a binary tree with one or more sectors per leaf never needs more nodes than this
+	nodes.reserve(sectors.size() * 2);
+	nodes.push_back(Node{});
+
+	build_node(0, 0, static_cast<uint32_t>(sectors.size()));
+}
+
+void SectorIndex::build_node(uint32_t node_index, uint32_t first, uint32_t count)
+{
+	glm::vec2 min{ std::numeric_limits<float>::max() };
+	glm::vec2 max{ std::numeric_limits<float>::lowest() };
+	glm::vec2 centroid_min = min;
+	glm::vec2 centroid_max = max;
+
+	for (uint32_t i = first; i < first + count; i++)
+	{
+		const uint32_t sector = sector_order[i];
+
+		min = glm::min(min, sector_mins[sector]);
+		max = glm::max(max, sector_maxs[sector]);
+
+		const glm::vec2 centroid = (sector_mins[sector] + sector_maxs[sector]) * 0.5f;
+		centroid_min = glm::min(centroid_min, centroid);
+		centroid_max = glm::max(centroid_max, centroid);
+	}
+
+	nodes[node_index] = Node{ min, max, first, count };
+
+	if (count <= MAX_LEAF_SECTORS)
+	{
+		return;
+	}
+
+	//split at the median centroid along the longest axis
+	const glm::vec2 extent = centroid_max - centroid_min;
+	const int axis = extent.x >= extent.y ? 0 : 1;
+
+	const uint32_t half = count / 2;
+	std::nth_element(sector_order.begin() + first, sector_order.begin() + first + half, sector_order.begin() + first + count,
+		[this, axis](uint32_t a, uint32_t b)
+		{
+			return (sector_mins[a][axis] + sector_maxs[a][axis]) < (sector_mins[b][axis] + sector_maxs[b][axis]);
+		});
+
+	//children are stored next to each other
+	const uint32_t children = static_cast<uint32_t>(nodes.size());
+	nodes[node_index].first = children;
+	nodes[node_index].count = 0;
+
+	nodes.push_back(Node{});
+	nodes.push_back(Node{});
+
+	build_node(children, first, half);
+	build_node(children + 1, first + half, count - half);
+}
+
+int32_t SectorIndex::find_sector(glm::vec2 point) const
+{
+	if (nodes.empty())
+	{
+		return -1;
+	}
+
+	uint32_t stack[MAX_TREE_DEPTH];
+	size_t stack_size = 0;
+
+	stack[stack_size++] = 0;
+
+	while (stack_size > 0)
+	{
+		const Node& node = nodes[stack[--stack_size]];
+
+		if (point.x < node.min.x || point.y < node.min.y || point.x > node.max.x || point.y > node.max.y)
+		{
+			continue;
+		}
+
+		if (node.count == 0)
+		{
+			stack[stack_size++] = node.first;
+			stack[stack_size++] = node.first + 1;
+			continue;
+		}
+
+		for (uint32_t i = node.first; i < node.first + node.count; i++)
+		{
+			const uint32_t sector = sector_order[i];
+
+			const auto& min = sector_mins[sector];
+			const auto& max = sector_maxs[sector];
+
+			if (point.x < min.x || point.y < min.y || point.x > max.x || point.y > max.y)
+			{
+				continue;
+			}
+
+			if (point_in_sector((*sectors)[sector], point))
+			{
+				return static_cast<int32_t>(sector);
+			}
+		}
+	}
+
+	return -1;
+}
@@ -0,0 +1,45 @@
+#ifndef SECTOR_INDEX_HPP
+#define SECTOR_INDEX_HPP
+
+#include <vector>
+#include <cstdint>
+
+#include <glm/glm.hpp>
+
+#include "Sector.hpp"
+
+//even-odd test of a point against a sector's outline
+bool point_in_sector(const Sector& sector, glm::vec2 point);
+
+//bounding volume hierarchy over the sectors' bounding boxes
+class SectorIndex
+{
+	struct Node
+	{
+		glm::vec2 min, max;
+
+		//leaves reference count sectors in sector_order starting at first,
+		//inner nodes have count 0 and their children at first and first + 1
+		uint32_t first, count;
+	};
+
+	std::vector<Node> nodes;
+	std::vector<uint32_t> sector_order;
+
+	std::vector<glm::vec2> sector_mins, sector_maxs;
+
+	const std::vector<Sector>* sectors = nullptr;
+
+	void build_node(uint32_t node_index, uint32_t first, uint32_t count);
+
+public:
+	explicit SectorIndex() = default;
+
+	//the sectors are referenced, not copied, so build again whenever they change
+	void build(const std::vector<Sector>& sectors);
+
+	//returns the sector containing point, or -1 if it's outside the map
+	int32_t find_sector(glm::vec2 point) const;
+};
+
+#endif
@@ -0,0 +1,262 @@
+#include "SectorMeshCache.hpp"
+
+#include <algorithm>
+#include <numeric>
+
+#include "SectorGeometry.hpp"
+#include "Profiler.hpp"
+
+//spare space at the end of the buffers for sectors that outgrow their slot, as a fraction of the used space
+constexpr uint32_t SPARE_FRACTION = 4;
+
+//so small maps can still be edited for a while before everything is rebuilt
+constexpr uint32_t MIN_SPARE_VERTICES = 1024;
+constexpr uint32_t MIN_SPARE_INDICES = 1536;
+
+template<typename T>
+struct SectorPatch
+{
+	std::vector<T> vertices;
+	std::vector<uint32_t> indices;
+};
+
+//one sector on its own, its indices start at 0
+template<typename T, typename Generate>
+static void generate_patch(const std::vector<Sector>& sectors, size_t sector_index, Generate generate, SectorPatch<T>& patch)
+{
+	patch.vertices.clear();
+	patch.indices.clear();
+
+	VertexWelder<T> welder{ patch.vertices, max_sector_geometry(sectors[sector_index]).vertices };
+
+	generate(sectors, sector_index, welder, patch.indices);
+}
+
+static Mesh make_mesh(const std::vector<Vertex>& vertices, const std::vector<uint32_t>& indices, const std::vector<Sector>&)
+{
+	return Mesh{ vertices, indices };
+}
+
+static Mesh make_mesh(const std::vector<PulledVertex>& vertices, const std::vector<uint32_t>& indices, const std::vector<Sector>& sectors)
+{
+	return Mesh{ vertices, indices, sectors };
+}
+
+SectorMeshCache::SectorMeshCache(const std::vector<Sector>& sectors, VertexFetch vertex_fetch, ThreadPool& thread_pool)
+	: vertex_fetch(vertex_fetch)
+{
+	rebuild(sectors, thread_pool);
+}
+
+void SectorMeshCache::mark_dirty(const std::vector<Sector>& sectors, uint32_t sector_index)
+{
+	if (dirty_flags.size() < sectors.size())
+	{
+		dirty_flags.resize(sectors.size(), 0);
+	}
+
+	auto mark = [this](uint32_t index)
+	{
+		if (!dirty_flags[index])
+		{
+			dirty_flags[index] = 1;
+			dirty_sectors.push_back(index);
+		}
+	};
+
+	mark(sector_index);
+
+	for (const auto neighbor : sectors[sector_index].neighbors)
+	{
+		if (neighbor >= 0 && static_cast<size_t>(neighbor) < sectors.size())
+		{
+			mark(static_cast<uint32_t>(neighbor));
+		}
+	}
+}
+
+bool SectorMeshCache::heights_changed(const std::vector<Sector>& sectors, uint32_t sector_index)
+{
+	if (vertex_fetch == VertexFetch::PULLED)
+	{
+		mesh.update_sector(sector_index, sectors[sector_index]);
+		return true;
+	}
+
+	mark_dirty(sectors, sector_index);
+	return false;
+}
+
+const std::vector<uint32_t>& SectorMeshCache::update(const std::vector<Sector>& sectors, ThreadPool& thread_pool)
+{
+	PROFILE_ZONE("SectorMeshCache::update");
+
+	updated_sectors.clear();
+
+	if (sectors.size() != slots.size())
+	{
+		rebuild(sectors, thread_pool);
+		return updated_sectors;
+	}
+
+	if (dirty_sectors.empty())
+	{
+		return updated_sectors;
+	}
+
+	const bool patched = vertex_fetch == VertexFetch::PULLED ?
+		patch_dirty_as<PulledVertex>(sectors, thread_pool, generate_sector_pulled_geometry) :
+		patch_dirty_as<Vertex>(sectors, thread_pool, generate_sector_geometry);
+
+	if (!patched)
+	{
+		rebuild(sectors, thread_pool);
+		return updated_sectors;
+	}
+
+	updated_sectors.swap(dirty_sectors);
+
+	dirty_sectors.clear();
+	for (const auto sector : updated_sectors)
+	{
+		dirty_flags[sector] = 0;
+	}
+
+	return updated_sectors;
+}
+
+void SectorMeshCache::rebuild(const std::vector<Sector>& sectors, ThreadPool& thread_pool)
+{
+	PROFILE_ZONE("SectorMeshCache::rebuild");
+
+	if (vertex_fetch == VertexFetch::PULLED)
+	{
+		rebuild_as<PulledVertex>(sectors, thread_pool, generate_sector_pulled_geometry);
+	}
+	else
+	{
+		rebuild_as<Vertex>(sectors, thread_pool, generate_sector_geometry);
+	}
+
+	dirty_sectors.clear();
+	dirty_flags.assign(sectors.size(), 0);
+
+	updated_sectors.resize(sectors.size());
+	std::iota(updated_sectors.begin(), updated_sectors.end(), 0u);
+}
+
+template<typename T, typename Generate>
+void SectorMeshCache::rebuild_as(const std::vector<Sector>& sectors, ThreadPool& thread_pool, Generate generate)
+{
+	slots.resize(sectors.size());
+	sector_ranges.resize(sectors.size());
+
+	uint32_t vertex_count = 0;
+	uint32_t index_count = 0;
+	for (size_t s = 0; s < sectors.size(); s++)
+	{
+		const auto size = max_sector_geometry(sectors[s]);
+
+		slots[s] = Slot{ vertex_count, static_cast<uint32_t>(size.vertices), index_count, static_cast<uint32_t>(size.indices) };
+
+		vertex_count += static_cast<uint32_t>(size.vertices);
+		index_count += static_cast<uint32_t>(size.indices);
+	}
+
+	vertex_end = vertex_count;
+	index_end = index_count;
+	vertex_capacity = vertex_end + std::max(vertex_end / SPARE_FRACTION, MIN_SPARE_VERTICES);
+	index_capacity = index_end + std::max(index_end / SPARE_FRACTION, MIN_SPARE_INDICES);
+
+	//the unused parts of slots are never drawn, they only have to exist
+	std::vector<T> vertices(vertex_capacity, T{});
+	std::vector<uint32_t> indices(index_capacity, 0);
+
+	thread_pool.parallel_for(sectors.size(), [&](size_t s)
+		{
+			SectorPatch<T> patch;
+			generate_patch(sectors, s, generate, patch);
+
+			const auto& slot = slots[s];
+
+			std::copy(patch.vertices.begin(), patch.vertices.end(), vertices.begin() + slot.first_vertex);
+
+			std::transform(patch.indices.begin(), patch.indices.end(), indices.begin() + slot.first_index,
+				[&slot](uint32_t index)
+				{
+					return index + slot.first_vertex;
+				});
+
+			sector_ranges[s] = MeshRange{ slot.first_index, static_cast<uint32_t>(patch.indices.size()) };
+		});
+
+	mesh = make_mesh(vertices, indices, sectors);
+}
+
+template<typename T, typename Generate>
+bool SectorMeshCache::patch_dirty_as(const std::vector<Sector>& sectors, ThreadPool& thread_pool, Generate generate)
+{
+	std::vector<SectorPatch<T>> patches(dirty_sectors.size());
+
+	thread_pool.parallel_for(dirty_sectors.size(), [&](size_t i)
+		{
+			generate_patch(sectors, dirty_sectors[i], generate, patches[i]);
+		});
+
+	//find room for everything before touching the mesh, so running out leaves it as it was for the rebuild
+	std::vector<Slot> placements(dirty_sectors.size());
+
+	uint32_t new_vertex_end = vertex_end;
+	uint32_t new_index_end = index_end;
+
+	for (size_t i = 0; i < dirty_sectors.size(); i++)
+	{
+		Slot slot = slots[dirty_sectors[i]];
+
+		if (patches[i].vertices.size() > slot.vertex_capacity || patches[i].indices.size() > slot.index_capacity)
+		{
+			//the old slot is abandoned until the next rebuild
+			const auto size = max_sector_geometry(sectors[dirty_sectors[i]]);
+
+			if (new_vertex_end + size.vertices > vertex_capacity || new_index_end + size.indices > index_capacity)
+			{
+				return false;
+			}
+
+			slot = Slot{ new_vertex_end, static_cast<uint32_t>(size.vertices), new_index_end, static_cast<uint32_t>(size.indices) };
+
+			new_vertex_end += static_cast<uint32_t>(size.vertices);
+			new_index_end += static_cast<uint32_t>(size.indices);
+		}
+
+		placements[i] = slot;
+	}
+
+	vertex_end = new_vertex_end;
+	index_end = new_index_end;
+
+	for (size_t i = 0; i < dirty_sectors.size(); i++)
+	{
+		const uint32_t sector_index = dirty_sectors[i];
+		const Slot& slot = placements[i];
+		auto& patch = patches[i];
+
+		for (auto& index : patch.indices)
+		{
+			index += slot.first_vertex;
+		}
+
+		mesh.update_vertices(slot.first_vertex, patch.vertices);
+		mesh.update_indices(slot.first_index, patch.indices);
+
+		if (vertex_fetch == VertexFetch::PULLED)
+		{
+			mesh.update_sector(sector_index, sectors[sector_index]);
+		}
+
+		slots[sector_index] = slot;
+		sector_ranges[sector_index] = MeshRange{ slot.first_index, static_cast<uint32_t>(patch.indices.size()) };
+	}
+
+	return true;
+}
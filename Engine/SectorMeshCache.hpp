@@ -0,0 +1,86 @@
+#ifndef SECTOR_MESH_CACHE_HPP
+#define SECTOR_MESH_CACHE_HPP
+
+#include <vector>
+#include <cstdint>
+
+#include "RenderData.hpp"
+
+#include "Sector.hpp"
+
+#include "ThreadPool.hpp"
+
+//the gl map mesh with a slot of its own for every sector, so a changed sector is regenerated and patched in without touching the rest
+//slots fit the sector's worst case, both steps on every portal, so height and material changes always fit in place
+//sectors that outgrow their slot move into the spare space at the end of the buffers, and everything is rebuilt once that runs out
+class SectorMeshCache
+{
+	struct Slot
+	{
+		uint32_t first_vertex, vertex_capacity;
+		uint32_t first_index, index_capacity;
+	};
+
+	VertexFetch vertex_fetch = VertexFetch::ATTRIBUTES;
+
+	Mesh mesh;
+
+	std::vector<Slot> slots;
+
+	//the part of every slot that's in use
+	std::vector<MeshRange> sector_ranges;
+
+	//where the spare space starts and how big the buffers are
+	uint32_t vertex_end = 0, vertex_capacity = 0;
+	uint32_t index_end = 0, index_capacity = 0;
+
+	//sectors to regenerate on the next update, the flags keep the list free of duplicates
+	std::vector<uint32_t> dirty_sectors;
+	std::vector<uint8_t> dirty_flags;
+
+	//what the last update regenerated
+	std::vector<uint32_t> updated_sectors;
+
+	void rebuild(const std::vector<Sector>& sectors, ThreadPool& thread_pool);
+
+	template<typename T, typename Generate>
+	void rebuild_as(const std::vector<Sector>& sectors, ThreadPool& thread_pool, Generate generate);
+
+	//false if the spare space ran out and nothing was changed
+	template<typename T, typename Generate>
+	bool patch_dirty_as(const std::vector<Sector>& sectors, ThreadPool& thread_pool, Generate generate);
+
+public:
+	explicit SectorMeshCache(const std::vector<Sector>& sectors, VertexFetch vertex_fetch, ThreadPool& thread_pool);
+
+	explicit SectorMeshCache() = default;
+
+	//call after changing a sector, every sector it has a portal to is marked too since their steps depend on its heights
+	//for relinked portals mark the sector before and after the change
+	void mark_dirty(const std::vector<Sector>& sectors, uint32_t sector_index);
+
+	//for moving floors and ceilings, pulled meshes only upload the sector's new data since their triangles don't depend on heights,
+	//attribute meshes mark it dirty, returns whether the mesh is already up to date
+	bool heights_changed(const std::vector<Sector>& sectors, uint32_t sector_index);
+
+	bool needs_update() const
+	{
+		return !dirty_sectors.empty();
+	}
+
+	//regenerates the dirty sectors on the thread pool and patches them into the mesh
+	//returns the sectors whose ranges changed, a new sector count or running out of space rebuilds and returns all of them
+	const std::vector<uint32_t>& update(const std::vector<Sector>& sectors, ThreadPool& thread_pool);
+
+	Mesh& get_mesh()
+	{
+		return mesh;
+	}
+
+	const std::vector<MeshRange>& get_sector_ranges() const
+	{
+		return sector_ranges;
+	}
+};
+
+#endif
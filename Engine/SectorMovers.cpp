@@ -0,0 +1,88 @@
+#include "SectorMovers.hpp"
+
+#include <stdexcept>
+#include <string>
+#include <algorithm>
+
+#include "Profiler.hpp"
+
+void SectorMovers::add(const std::vector<Sector>& sectors, const SectorMover& mover)
+{
+	if (mover.sector >= sectors.size())
+	{
+		throw std::runtime_error("Mover for sector " + std::to_string(mover.sector) + " of a map with " + std::to_string(sectors.size()));
+	}
+
+	if (mover.low > mover.high || mover.speed <= 0.0f)
+	{
+		throw std::runtime_error("Mover needs low <= high and a positive speed");
+	}
+
+	//the floor may never go above the ceiling, including where the other height is moved too
+	const auto& sector = sectors[mover.sector];
+
+	float lowest_ceil = sector.ceil, highest_floor = sector.floor;
+	for (const auto& state : movers)
+	{
+		if (state.mover.sector != mover.sector)
+		{
+			continue;
+		}
+
+		if (state.mover.ceil)
+		{
+			lowest_ceil = std::min(lowest_ceil, state.mover.low);
+		}
+		else
+		{
+			highest_floor = std::max(highest_floor, state.mover.high);
+		}
+	}
+
+	if (mover.ceil ? mover.low < highest_floor : mover.high > lowest_ceil)
+	{
+		throw std::runtime_error("Mover for sector " + std::to_string(mover.sector) + " would move its " + (mover.ceil ? "ceiling below its floor" : "floor above its ceiling"));
+	}
+
+	movers.push_back(State{ mover, 1.0f, 0.0f });
+}
+
+const std::vector<uint32_t>& SectorMovers::update(std::vector<Sector>& sectors, double delta_time)
+{
+	PROFILE_ZONE("SectorMovers::update");
+
+	moved_sectors.clear();
+
+	const float step = static_cast<float>(delta_time);
+
+	for (auto& state : movers)
+	{
+		if (state.wait_timer > 0.0f)
+		{
+			state.wait_timer -= step;
+			continue;
+		}
+
+		const auto& mover = state.mover;
+
+		float& height = mover.ceil ? sectors[mover.sector].ceil : sectors[mover.sector].floor;
+
+		const float target = state.direction > 0.0f ? mover.high : mover.low;
+		const float moved = state.direction > 0.0f ? std::min(height + mover.speed * step, target) : std::max(height - mover.speed * step, target);
+
+		if (moved != height)
+		{
+			height = moved;
+
+			moved_sectors.push_back(mover.sector);
+		}
+
+		if (moved == target)
+		{
+			state.direction = -state.direction;
+			state.wait_timer = mover.wait;
+		}
+	}
+
+	return moved_sectors;
+}
@@ -0,0 +1,58 @@
+#ifndef SECTOR_MOVERS_HPP
+#define SECTOR_MOVERS_HPP
+
+#include <vector>
+#include <cstdint>
+
+#include "Sector.hpp"
+
+//a floor or ceiling going back and forth between two heights, lifts move floors, doors and crushers move ceilings
+struct SectorMover
+{
+	uint32_t sector;
+
+	//moves the ceiling instead of the floor
+	bool ceil;
+
+	float low, high;
+
+	//units per second
+	float speed;
+
+	//seconds spent at either end before turning around
+	float wait;
+};
+
+//moves the heights in the sectors themselves, so collision and culling see the same values the gpu gets
+class SectorMovers
+{
+	struct State
+	{
+		SectorMover mover;
+
+		//1 going up, -1 going down
+		float direction;
+
+		float wait_timer;
+	};
+
+	std::vector<State> movers;
+
+	std::vector<uint32_t> moved_sectors;
+
+public:
+	explicit SectorMovers() = default;
+
+	//starts at the sector's current height, going towards high
+	void add(const std::vector<Sector>& sectors, const SectorMover& mover);
+
+	bool empty() const
+	{
+		return movers.empty();
+	}
+
+	//advances every mover, returns the sectors whose heights changed, a sector with two movers shows up twice
+	const std::vector<uint32_t>& update(std::vector<Sector>& sectors, double delta_time);
+};
+
+#endif
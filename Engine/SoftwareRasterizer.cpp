@@ -0,0 +1,502 @@
+#include "SoftwareRasterizer.hpp"
+
+#include <stdexcept>
+#include <string>
+#include <algorithm>
+#include <cmath>
+
+#ifdef __SSE2__
+#include <emmintrin.h>
+#endif
+
+#include "ThreadPool.hpp"
+#include "Profiler.hpp"
+
+//clipping keeps vertices within this many pixels outside the screen so edge functions can't overflow
+constexpr float GUARD_BAND = 4096.0f;
+
+//vertices are snapped to 1/16th of a pixel
+constexpr int64_t SUBPIXEL_SCALE = 16;
+
+//rounds towards negative infinity unlike /
+static int64_t floor_divide(int64_t value, int64_t divisor)
+{
+	return value >= 0 ? value / divisor : -((-value + divisor - 1) / divisor);
+}
+
+SoftwareRasterizer::SoftwareRasterizer(ThreadPool& thread_pool)
+	: thread_pool(thread_pool)
+{
+}
+
+void SoftwareRasterizer::resize(int32_t new_width, int32_t new_height)
+{
+	if (new_width <= 0 || new_height <= 0 || new_width > MAX_SIZE || new_height > MAX_SIZE)
+	{
+		throw std::runtime_error("Software rasterizer size must be between 1 and " + std::to_string(MAX_SIZE));
+	}
+
+	width = new_width;
+	height = new_height;
+
+	tiles_x = (width + TILE_SIZE - 1) / TILE_SIZE;
+	tiles_y = (height + TILE_SIZE - 1) / TILE_SIZE;
+
+	color_buffer.assign(static_cast<size_t>(width) * height, clear_color);
+	depth_buffer.assign(static_cast<size_t>(width) * height, 1.0f);
+
+	tile_bins.resize(static_cast<size_t>(tiles_x) * tiles_y);
+}
+
+void SoftwareRasterizer::load_textures(const std::vector<const char*>& texture_filenames, const size_t texture_width, const size_t texture_height)
+{
+	textures.load(thread_pool, texture_filenames, texture_width, texture_height);
+}
+
+void SoftwareRasterizer::set_clear_color(const glm::vec3& color)
+{
+	clear_color = pack_srgb(color);
+}
+
+void SoftwareRasterizer::draw(const std::vector<Vertex>& vertices, const std::vector<uint32_t>& indices, const std::vector<MeshRange>& ranges,
+	const glm::mat4& pv, const glm::vec3& view_pos)
+{
+	{
+		PROFILE_ZONE("SoftwareRasterizer::transform");
+
+		clip_positions.resize(vertices.size());
+
+		thread_pool.parallel_for(vertices.size(), [&](size_t i)
+			{
+				clip_positions[i] = pv * glm::vec4{ vertices[i].pos, 1.0f };
+			}, 1024);
+	}
+
+	{
+		PROFILE_ZONE("SoftwareRasterizer::setup");
+
+		triangles.clear();
+
+		//how far outside the screen a vertex may be in clip space
+		const float guard_x = 1.0f + 2.0f * GUARD_BAND / static_cast<float>(width);
+		const float guard_y = 1.0f + 2.0f * GUARD_BAND / static_cast<float>(height);
+
+		for (const auto& range : ranges)
+		{
+			for (uint32_t i = range.first; i + 2 < range.first + range.count; i += 3)
+			{
+				std::array<ClipVertex, 3> triangle;
+
+				//bit p is set when a vertex is outside plane p
+				uint32_t outside_all = 0x1F, outside_any = 0;
+				for (size_t v = 0; v < 3; v++)
+				{
+					const Vertex& vertex = vertices[indices[i + v]];
+					const glm::vec4& clip = clip_positions[indices[i + v]];
+
+					triangle[v] = ClipVertex{ clip, vertex.pos, vertex.tex_coord, vertex.normal };
+
+					const uint32_t outside =
+						(clip.z < -clip.w ? 1u : 0u) |
+						(clip.x > guard_x * clip.w ? 2u : 0u) |
+						(clip.x < -guard_x * clip.w ? 4u : 0u) |
+						(clip.y > guard_y * clip.w ? 8u : 0u) |
+						(clip.y < -guard_y * clip.w ? 16u : 0u);
+
+					outside_all &= outside;
+					outside_any |= outside;
+				}
+
+				if (outside_all != 0)
+				{
+					continue;
+				}
+
+				//flat attributes come from the last vertex like in gl
+				const float tex_index = vertices[indices[i + 2]].tex_index;
+				const uint32_t layer = static_cast<uint32_t>(std::clamp(std::lround(tex_index), 0l, static_cast<long>(std::max<size_t>(textures.get_layer_count(), 1) - 1)));
+
+				if (outside_any == 0)
+				{
+					setup_triangle(triangle, layer);
+				}
+				else
+				{
+					clip_triangle(triangle, layer);
+				}
+			}
+		}
+	}
+
+	{
+		PROFILE_ZONE("SoftwareRasterizer::bin");
+
+		for (auto& bin : tile_bins)
+		{
+			bin.clear();
+		}
+
+		for (uint32_t t = 0; t < triangles.size(); t++)
+		{
+			const auto& triangle = triangles[t];
+
+			for (int32_t tile_y = triangle.min_y / TILE_SIZE; tile_y <= triangle.max_y / TILE_SIZE; tile_y++)
+			{
+				for (int32_t tile_x = triangle.min_x / TILE_SIZE; tile_x <= triangle.max_x / TILE_SIZE; tile_x++)
+				{
+					tile_bins[static_cast<size_t>(tile_y) * tiles_x + tile_x].push_back(t);
+				}
+			}
+		}
+	}
+
+	PROFILE_ZONE("SoftwareRasterizer::rasterize");
+
+	//tiles don't share any pixels, so each one can be shaded on its own thread
+	thread_pool.parallel_for(tile_bins.size(), [&](size_t tile)
+		{
+			rasterize_tile(static_cast<int32_t>(tile % tiles_x), static_cast<int32_t>(tile / tiles_x), view_pos);
+		}, 1);
+}
+
+void SoftwareRasterizer::clip_triangle(const std::array<ClipVertex, 3>& vertices, uint32_t layer)
+{
+	const float guard_x = 1.0f + 2.0f * GUARD_BAND / static_cast<float>(width);
+	const float guard_y = 1.0f + 2.0f * GUARD_BAND / static_cast<float>(height);
+
+	//signed distance to each clip plane, positive inside
+	const auto distance = [guard_x, guard_y](const glm::vec4& clip, size_t plane)
+	{
+		switch (plane)
+		{
+		case 0: return clip.z + clip.w;
+		case 1: return guard_x * clip.w - clip.x;
+		case 2: return guard_x * clip.w + clip.x;
+		case 3: return guard_y * clip.w - clip.y;
+		default: return guard_y * clip.w + clip.y;
+		}
+	};
+
+	const auto lerp = [](const ClipVertex& a, const ClipVertex& b, float t)
+	{
+		return ClipVertex
+		{
+			glm::mix(a.clip, b.clip, t),
+			glm::mix(a.pos, b.pos, t),
+			glm::mix(a.tex_coord, b.tex_coord, t),
+			glm::mix(a.normal, b.normal, t)
+		};
+	};
+
+	//every plane can add at most one vertex
+	std::vector<ClipVertex> polygon{ vertices.begin(), vertices.end() };
+	std::vector<ClipVertex> clipped;
+
+	for (size_t plane = 0; plane < 5 && !polygon.empty(); plane++)
+	{
+		clipped.clear();
+
+		for (size_t i = 0; i < polygon.size(); i++)
+		{
+			const ClipVertex& current = polygon[i];
+			const ClipVertex& next = polygon[(i + 1) % polygon.size()];
+
+			const float current_distance = distance(current.clip, plane);
+			const float next_distance = distance(next.clip, plane);
+
+			if (current_distance >= 0.0f)
+			{
+				clipped.push_back(current);
+			}
+
+			if ((current_distance >= 0.0f) != (next_distance >= 0.0f))
+			{
+				clipped.push_back(lerp(current, next, current_distance / (current_distance - next_distance)));
+			}
+		}
+
+		std::swap(polygon, clipped);
+	}
+
+	for (size_t i = 2; i < polygon.size(); i++)
+	{
+		setup_triangle({ polygon[0], polygon[i - 1], polygon[i] }, layer);
+	}
+}
+
+void SoftwareRasterizer::setup_triangle(const std::array<ClipVertex, 3>& clip_vertices, uint32_t layer)
+{
+	std::array<ClipVertex, 3> vertices = clip_vertices;
+
+	Triangle triangle;
+	std::array<float, 3> inv_w, depth;
+
+	for (size_t v = 0; v < 3; v++)
+	{
+		inv_w[v] = 1.0f / vertices[v].clip.w;
+
+		const glm::vec3 ndc = glm::vec3{ vertices[v].clip } * inv_w[v];
+
+		//y goes down the screen, the opposite of gl window coordinates
+		triangle.x[v] = std::llround((ndc.x * 0.5f + 0.5f) * static_cast<float>(width) * SUBPIXEL_SCALE);
+		triangle.y[v] = std::llround((0.5f - ndc.y * 0.5f) * static_cast<float>(height) * SUBPIXEL_SCALE);
+
+		depth[v] = ndc.z * 0.5f + 0.5f;
+	}
+
+	const int64_t area = (triangle.x[1] - triangle.x[0]) * (triangle.y[2] - triangle.y[0]) - (triangle.y[1] - triangle.y[0]) * (triangle.x[2] - triangle.x[0]);
+
+	//counter clockwise front faces in gl turn clockwise with y flipped, which makes the area negative,
+	//so positive areas are the back faces gl culls
+	if (area >= 0)
+	{
+		return;
+	}
+
+	//wind the other way so the edge functions are positive inside
+	std::swap(triangle.x[1], triangle.x[2]);
+	std::swap(triangle.y[1], triangle.y[2]);
+	std::swap(vertices[1], vertices[2]);
+	std::swap(inv_w[1], inv_w[2]);
+	std::swap(depth[1], depth[2]);
+
+	//pixels whose centers are inside the bounding box
+	const int64_t half_pixel = SUBPIXEL_SCALE / 2;
+	triangle.min_x = static_cast<int32_t>(std::max<int64_t>(0, floor_divide(*std::min_element(triangle.x.begin(), triangle.x.end()) - half_pixel + SUBPIXEL_SCALE - 1, SUBPIXEL_SCALE)));
+	triangle.min_y = static_cast<int32_t>(std::max<int64_t>(0, floor_divide(*std::min_element(triangle.y.begin(), triangle.y.end()) - half_pixel + SUBPIXEL_SCALE - 1, SUBPIXEL_SCALE)));
+	triangle.max_x = static_cast<int32_t>(std::min<int64_t>(width - 1, floor_divide(*std::max_element(triangle.x.begin(), triangle.x.end()) - half_pixel, SUBPIXEL_SCALE)));
+	triangle.max_y = static_cast<int32_t>(std::min<int64_t>(height - 1, floor_divide(*std::max_element(triangle.y.begin(), triangle.y.end()) - half_pixel, SUBPIXEL_SCALE)));
+
+	if (triangle.min_x > triangle.max_x || triangle.min_y > triangle.max_y)
+	{
+		return;
+	}
+
+	for (size_t edge = 0; edge < 3; edge++)
+	{
+		const size_t a = (edge + 1) % 3;
+		const size_t b = (edge + 2) % 3;
+
+		const int64_t step_x = triangle.y[a] - triangle.y[b];
+		const int64_t step_y = triangle.x[b] - triangle.x[a];
+
+		//top-left rule, pixel centers exactly on an edge belong to the triangle on its right or below it
+		const bool top_left = step_x > 0 || (step_x == 0 && step_y > 0);
+		triangle.bias[edge] = top_left ? 0 : 1;
+	}
+
+	//screen space planes for everything the pixels need, divided by w so they can be interpolated linearly
+	triangle.origin_x = static_cast<float>(triangle.x[0]) / SUBPIXEL_SCALE;
+	triangle.origin_y = static_cast<float>(triangle.y[0]) / SUBPIXEL_SCALE;
+
+	const float x1 = static_cast<float>(triangle.x[1] - triangle.x[0]) / SUBPIXEL_SCALE;
+	const float y1 = static_cast<float>(triangle.y[1] - triangle.y[0]) / SUBPIXEL_SCALE;
+	const float x2 = static_cast<float>(triangle.x[2] - triangle.x[0]) / SUBPIXEL_SCALE;
+	const float y2 = static_cast<float>(triangle.y[2] - triangle.y[0]) / SUBPIXEL_SCALE;
+	const float determinant = x1 * y2 - x2 * y1;
+
+	const auto make_plane = [=](float a0, float a1, float a2)
+	{
+		return Plane
+		{
+			a0,
+			((a1 - a0) * y2 - (a2 - a0) * y1) / determinant,
+			((a2 - a0) * x1 - (a1 - a0) * x2) / determinant
+		};
+	};
+
+	triangle.planes[PLANE_DEPTH] = make_plane(depth[0], depth[1], depth[2]);
+	triangle.planes[PLANE_INV_W] = make_plane(inv_w[0], inv_w[1], inv_w[2]);
+
+	std::array<std::array<float, 8>, 3> attributes;
+	for (size_t v = 0; v < 3; v++)
+	{
+		const auto& vertex = vertices[v];
+
+		attributes[v] =
+		{
+			vertex.tex_coord.x, vertex.tex_coord.y,
+			vertex.normal.x, vertex.normal.y, vertex.normal.z,
+			vertex.pos.x, vertex.pos.y, vertex.pos.z
+		};
+	}
+
+	for (size_t i = 0; i < 8; i++)
+	{
+		triangle.planes[PLANE_ATTRIBUTES + i] = make_plane(attributes[0][i] * inv_w[0], attributes[1][i] * inv_w[1], attributes[2][i] * inv_w[2]);
+	}
+
+	triangle.layer = layer;
+
+	triangles.push_back(triangle);
+}
+
+void SoftwareRasterizer::rasterize_tile(int32_t tile_x, int32_t tile_y, const glm::vec3& view_pos)
+{
+	const int32_t tile_min_x = tile_x * TILE_SIZE;
+	const int32_t tile_min_y = tile_y * TILE_SIZE;
+	const int32_t tile_max_x = std::min(tile_min_x + TILE_SIZE, width) - 1;
+	const int32_t tile_max_y = std::min(tile_min_y + TILE_SIZE, height) - 1;
+
+	for (int32_t y = tile_min_y; y <= tile_max_y; y++)
+	{
+		const size_t row = static_cast<size_t>(y) * width;
+
+		std::fill(color_buffer.begin() + row + tile_min_x, color_buffer.begin() + row + tile_max_x + 1, clear_color);
+		std::fill(depth_buffer.begin() + row + tile_min_x, depth_buffer.begin() + row + tile_max_x + 1, 1.0f);
+	}
+
+	for (const auto index : tile_bins[static_cast<size_t>(tile_y) * tiles_x + tile_x])
+	{
+		const Triangle& triangle = triangles[index];
+
+		const int32_t min_x = std::max(triangle.min_x, tile_min_x);
+		const int32_t min_y = std::max(triangle.min_y, tile_min_y);
+		const int32_t max_x = std::min(triangle.max_x, tile_max_x);
+		const int32_t max_y = std::min(triangle.max_y, tile_max_y);
+
+		if (min_x > max_x || min_y > max_y)
+		{
+			continue;
+		}
+
+		//edge values at the first pixel and their steps, an edge that covers the whole rectangle is left at zero
+		//so the partially covered ones are small enough for 32 bits
+		std::array<int32_t, 3> edge_start{}, edge_step_x{}, edge_step_y{};
+
+		bool outside = false;
+		for (size_t edge = 0; edge < 3 && !outside; edge++)
+		{
+			const size_t a = (edge + 1) % 3;
+			const size_t b = (edge + 2) % 3;
+
+			const int64_t step_x = triangle.y[a] - triangle.y[b];
+			const int64_t step_y = triangle.x[b] - triangle.x[a];
+
+			const auto edge_at = [&](int32_t x, int32_t y)
+			{
+				const int64_t center_x = x * SUBPIXEL_SCALE + SUBPIXEL_SCALE / 2;
+				const int64_t center_y = y * SUBPIXEL_SCALE + SUBPIXEL_SCALE / 2;
+
+				return step_x * (center_x - triangle.x[a]) + step_y * (center_y - triangle.y[a]) - triangle.bias[edge];
+			};
+
+			const std::array<int64_t, 4> corners{ edge_at(min_x, min_y), edge_at(max_x, min_y), edge_at(min_x, max_y), edge_at(max_x, max_y) };
+
+			const int64_t lowest = *std::min_element(corners.begin(), corners.end());
+			const int64_t highest = *std::max_element(corners.begin(), corners.end());
+
+			if (highest < 0)
+			{
+				outside = true;
+			}
+			else if (lowest < 0)
+			{
+				edge_start[edge] = static_cast<int32_t>(corners[0]);
+				edge_step_x[edge] = static_cast<int32_t>(step_x * SUBPIXEL_SCALE);
+				edge_step_y[edge] = static_cast<int32_t>(step_y * SUBPIXEL_SCALE);
+			}
+		}
+
+		if (outside)
+		{
+			continue;
+		}
+
+#ifdef __SSE2__
+		__m128i lane_steps[3];
+		for (size_t edge = 0; edge < 3; edge++)
+		{
+			lane_steps[edge] = _mm_setr_epi32(0, edge_step_x[edge], edge_step_x[edge] * 2, edge_step_x[edge] * 3);
+		}
+#endif
+
+		std::array<int32_t, 3> row_edges = edge_start;
+
+		for (int32_t y = min_y; y <= max_y; y++)
+		{
+			std::array<int32_t, 3> edges = row_edges;
+
+			for (int32_t x = min_x; x <= max_x; x += 4)
+			{
+				//one bit per pixel of the 4 pixel span
+				uint32_t coverage;
+
+#ifdef __SSE2__
+				const __m128i e0 = _mm_add_epi32(_mm_set1_epi32(edges[0]), lane_steps[0]);
+				const __m128i e1 = _mm_add_epi32(_mm_set1_epi32(edges[1]), lane_steps[1]);
+				const __m128i e2 = _mm_add_epi32(_mm_set1_epi32(edges[2]), lane_steps[2]);
+
+				//a pixel is outside when any of its edge values has the sign bit set
+				const __m128i any_negative = _mm_or_si128(_mm_or_si128(e0, e1), e2);
+				coverage = ~static_cast<uint32_t>(_mm_movemask_ps(_mm_castsi128_ps(any_negative))) & 0xF;
+#else
+				coverage = 0;
+				for (int32_t lane = 0; lane < 4; lane++)
+				{
+					if (((edges[0] + edge_step_x[0] * lane) | (edges[1] + edge_step_x[1] * lane) | (edges[2] + edge_step_x[2] * lane)) >= 0)
+					{
+						coverage |= 1u << lane;
+					}
+				}
+#endif
+
+				//the last span can hang over the rectangle
+				if (max_x - x < 3)
+				{
+					coverage &= (1u << (max_x - x + 1)) - 1;
+				}
+
+				for (int32_t lane = 0; lane < 4; lane++)
+				{
+					if (!(coverage & (1u << lane)))
+					{
+						continue;
+					}
+
+					const int32_t pixel_x = x + lane;
+					const size_t pixel = static_cast<size_t>(y) * width + pixel_x;
+
+					const float px = static_cast<float>(pixel_x) + 0.5f - triangle.origin_x;
+					const float py = static_cast<float>(y) + 0.5f - triangle.origin_y;
+
+					//depth test is GL_LESS, and gl clips anything past the far plane
+					const float depth = triangle.planes[PLANE_DEPTH].at(px, py);
+					if (depth > 1.0f || !(depth < depth_buffer[pixel]))
+					{
+						continue;
+					}
+
+					depth_buffer[pixel] = depth;
+
+					const float w = 1.0f / triangle.planes[PLANE_INV_W].at(px, py);
+
+					std::array<float, 8> attributes;
+					for (size_t i = 0; i < attributes.size(); i++)
+					{
+						attributes[i] = triangle.planes[PLANE_ATTRIBUTES + i].at(px, py) * w;
+					}
+
+					const glm::vec2 tex_coord{ attributes[0], attributes[1] };
+					const glm::vec3 normal{ attributes[2], attributes[3], attributes[4] };
+					const glm::vec3 frag_pos{ attributes[5], attributes[6], attributes[7] };
+
+					//the main shader's fragment stage
+					const glm::vec3 texel = textures.sample(triangle.layer, tex_coord);
+
+					color_buffer[pixel] = pack_srgb(shade_fragment(texel, normal, frag_pos, view_pos));
+				}
+
+				for (size_t edge = 0; edge < 3; edge++)
+				{
+					edges[edge] += edge_step_x[edge] * 4;
+				}
+			}
+
+			for (size_t edge = 0; edge < 3; edge++)
+			{
+				row_edges[edge] += edge_step_y[edge];
+			}
+		}
+	}
+}
@@ -0,0 +1,126 @@
+#ifndef SOFTWARE_RASTERIZER_HPP
+#define SOFTWARE_RASTERIZER_HPP
+
+#include <vector>
+#include <array>
+#include <cstdint>
+
+#include <glm/glm.hpp>
+
+#include "RenderData.hpp"
+#include "SoftwareShading.hpp"
+
+class ThreadPool;
+
+//cpu version of the main shader for machines without a gpu
+//triangles are clipped and binned into screen tiles, then the thread pool rasterizes the tiles independently
+class SoftwareRasterizer
+{
+public:
+	static constexpr int32_t TILE_SIZE = 64;
+
+	//edge functions are stepped in 32 bits inside a tile, which only works up to this size
+	static constexpr int32_t MAX_SIZE = 8192;
+
+private:
+	//vertex after clipping, everything the fragment shader reads
+	struct ClipVertex
+	{
+		glm::vec4 clip;
+		glm::vec3 pos;
+		glm::vec2 tex_coord;
+		glm::vec3 normal;
+	};
+
+	//a value interpolated linearly in screen space, relative to the triangle's first vertex
+	struct Plane
+	{
+		float value, dx, dy;
+
+		float at(float x, float y) const
+		{
+			return value + dx * x + dy * y;
+		}
+	};
+
+	static constexpr size_t PLANE_DEPTH = 0;
+	static constexpr size_t PLANE_INV_W = 1;
+	//tex_coord, normal and pos divided by w
+	static constexpr size_t PLANE_ATTRIBUTES = 2;
+	static constexpr size_t PLANE_COUNT = PLANE_ATTRIBUTES + 8;
+
+	struct Triangle
+	{
+		//vertices in 1/16ths of a pixel, wound so every edge function is positive inside
+		std::array<int64_t, 3> x, y;
+
+		//edge i is opposite vertex i, subtracted so pixels on edges that aren't top or left are outside
+		std::array<int64_t, 3> bias;
+
+		int32_t min_x, min_y, max_x, max_y;
+
+		float origin_x, origin_y;
+		std::array<Plane, PLANE_COUNT> planes;
+
+		uint32_t layer;
+	};
+
+	ThreadPool& thread_pool;
+
+	int32_t width = 0, height = 0;
+	int32_t tiles_x = 0, tiles_y = 0;
+
+	//rgba8 in srgb, top row first
+	std::vector<uint32_t> color_buffer;
+	std::vector<float> depth_buffer;
+
+	uint32_t clear_color = 0;
+
+	SoftwareTextureArray textures;
+
+	std::vector<glm::vec4> clip_positions;
+	std::vector<Triangle> triangles;
+	std::vector<std::vector<uint32_t>> tile_bins;
+
+	void setup_triangle(const std::array<ClipVertex, 3>& vertices, uint32_t layer);
+
+	void clip_triangle(const std::array<ClipVertex, 3>& vertices, uint32_t layer);
+
+	void rasterize_tile(int32_t tile_x, int32_t tile_y, const glm::vec3& view_pos);
+
+public:
+	explicit SoftwareRasterizer(ThreadPool& thread_pool);
+
+	explicit SoftwareRasterizer(SoftwareRasterizer&) = delete;
+
+	SoftwareRasterizer& operator=(SoftwareRasterizer&) = delete;
+
+	void resize(int32_t width, int32_t height);
+
+	//decodes the layers on the thread pool, the same images the TextureArray2d is built from
+	void load_textures(const std::vector<const char*>& texture_filenames, const size_t texture_width, const size_t texture_height);
+
+	//color is linear like glClearColor with GL_FRAMEBUFFER_SRGB
+	void set_clear_color(const glm::vec3& color);
+
+	//clears and draws the given index ranges with the main shader's lighting
+	void draw(const std::vector<Vertex>& vertices, const std::vector<uint32_t>& indices, const std::vector<MeshRange>& ranges,
+		const glm::mat4& pv, const glm::vec3& view_pos);
+
+	const std::vector<uint32_t>& get_pixels() const
+	{
+		return color_buffer;
+	}
+
+	int32_t get_width() const
+	{
+		return width;
+	}
+
+	int32_t get_height() const
+	{
+		return height;
+	}
+};
+
+#endif
@@ -0,0 +1,158 @@
+#include "SoftwareShading.hpp"
+
+#include <stdexcept>
+#include <string>
+#include <array>
+#include <algorithm>
+#include <cmath>
+
+#include "stb_image.h"
+
+#include "ThreadPool.hpp"
+
+constexpr size_t LINEAR_TO_SRGB_STEPS = 16384;
+
+static float srgb_to_linear(float value)
+{
+	return value <= 0.04045f ? value / 12.92f : std::pow((value + 0.055f) / 1.055f, 2.4f);
+}
+
+static float linear_to_srgb(float value)
+{
+	return value <= 0.0031308f ? value * 12.92f : 1.055f * std::pow(value, 1.0f / 2.4f) - 0.055f;
+}
+
+static const std::array<float, 256>& srgb_to_linear_table()
+{
+	static const auto table = []()
+	{
+		std::array<float, 256> values;
+		for (size_t i = 0; i < values.size(); i++)
+		{
+			values[i] = srgb_to_linear(static_cast<float>(i) / 255.0f);
+		}
+
+		return values;
+	}();
+
+	return table;
+}
+
+static uint32_t encode_srgb(float value)
+{
+	static const auto table = []()
+	{
+		std::vector<uint8_t> values(LINEAR_TO_SRGB_STEPS);
+		for (size_t i = 0; i < values.size(); i++)
+		{
+			values[i] = static_cast<uint8_t>(std::lround(linear_to_srgb(static_cast<float>(i) / (LINEAR_TO_SRGB_STEPS - 1)) * 255.0f));
+		}
+
+		return values;
+	}();
+
+	const float clamped = std::clamp(value, 0.0f, 1.0f);
+
+	return table[static_cast<size_t>(clamped * (LINEAR_TO_SRGB_STEPS - 1) + 0.5f)];
+}
+
+void SoftwareTextureArray::load(ThreadPool& thread_pool, const std::vector<const char*>& texture_filenames, const size_t new_texture_width, const size_t new_texture_height)
+{
+	texture_width = new_texture_width;
+	texture_height = new_texture_height;
+	texture_layers = texture_filenames.size();
+
+	const size_t layer_size = texture_width * texture_height;
+	texels.assign(layer_size * texture_layers, glm::vec3{ 0.0f });
+
+	//exceptions can't leave the workers, so remember them and throw here
+	std::vector<std::string> errors(texture_layers);
+
+	const auto& linear = srgb_to_linear_table();
+
+	thread_pool.parallel_for(texture_layers, [&](size_t layer)
+		{
+			int loaded_width, loaded_height, nr_channels;
+			unsigned char* texture = stbi_load(texture_filenames[layer], &loaded_width, &loaded_height, &nr_channels, 3);
+
+			if (nullptr == texture)
+			{
+				errors[layer] = std::string{ "Failed to load texture from file " } + texture_filenames[layer];
+				return;
+			}
+
+			if (loaded_width != static_cast<int>(texture_width) || loaded_height != static_cast<int>(texture_height))
+			{
+				errors[layer] = "texture loaded is not of size (" + std::to_string(texture_width) + " x " + std::to_string(texture_height) + ")";
+			}
+			else
+			{
+				for (size_t i = 0; i < layer_size; i++)
+				{
+					texels[layer * layer_size + i] = glm::vec3{ linear[texture[i * 3]], linear[texture[i * 3 + 1]], linear[texture[i * 3 + 2]] };
+				}
+			}
+
+			stbi_image_free(texture);
+		}, 1);
+
+	for (const auto& error : errors)
+	{
+		if (!error.empty())
+		{
+			throw std::runtime_error(error);
+		}
+	}
+}
+
+glm::vec3 SoftwareTextureArray::sample(uint32_t layer, glm::vec2 tex_coord) const
+{
+	//the texels are already linear like an srgb texture after decoding
+	const float u = tex_coord.x * static_cast<float>(texture_width) - 0.5f;
+	const float v = tex_coord.y * static_cast<float>(texture_height) - 0.5f;
+
+	const float floor_u = std::floor(u);
+	const float floor_v = std::floor(v);
+
+	const float blend_u = u - floor_u;
+	const float blend_v = v - floor_v;
+
+	const int64_t w = static_cast<int64_t>(texture_width);
+	const int64_t h = static_cast<int64_t>(texture_height);
+
+	const int64_t x0 = ((static_cast<int64_t>(floor_u) % w) + w) % w;
+	const int64_t y0 = ((static_cast<int64_t>(floor_v) % h) + h) % h;
+	const int64_t x1 = (x0 + 1) % w;
+	const int64_t y1 = (y0 + 1) % h;
+
+	const glm::vec3* texture = &texels[layer * texture_width * texture_height];
+
+	const glm::vec3 top = glm::mix(texture[y0 * w + x0], texture[y0 * w + x1], blend_u);
+	const glm::vec3 bottom = glm::mix(texture[y1 * w + x0], texture[y1 * w + x1], blend_u);
+
+	return glm::mix(top, bottom, blend_v);
+}
+
+glm::vec3 shade_fragment(const glm::vec3& texel, const glm::vec3& normal, const glm::vec3& frag_pos, const glm::vec3& view_pos)
+{
+	const glm::vec3 light_pos{ 0.0f, 5.0f, 0.0f };
+
+	const glm::vec3 ambient = glm::vec3{ 0.4f } * texel;
+
+	const glm::vec3 norm = glm::normalize(normal);
+	const glm::vec3 light_dir = glm::normalize(light_pos - frag_pos);
+	const float diff = std::max(glm::dot(norm, light_dir), 0.0f);
+	const glm::vec3 diffuse = glm::vec3{ 0.5f } * diff * texel;
+
+	const glm::vec3 view_dir = glm::normalize(view_pos - frag_pos);
+	const glm::vec3 reflect_dir = glm::reflect(-light_dir, norm);
+	const float spec = std::pow(std::max(glm::dot(view_dir, reflect_dir), 0.0f), 128.0f);
+	const glm::vec3 specular = spec * glm::vec3{ 0.1f };
+
+	return ambient + diffuse + specular;
+}
+
+uint32_t pack_srgb(const glm::vec3& color)
+{
+	return encode_srgb(color.r) | (encode_srgb(color.g) << 8) | (encode_srgb(color.b) << 16) | (255u << 24);
+}
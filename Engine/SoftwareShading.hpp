@@ -0,0 +1,47 @@
+#ifndef SOFTWARE_SHADING_HPP
+#define SOFTWARE_SHADING_HPP
+
+#include <vector>
+#include <cstdint>
+#include <cstddef>
+
+#include <glm/glm.hpp>
+
+class ThreadPool;
+
+//the parts of the main shader shared by the cpu renderers
+
+//the textures as linear rgb, sampled like the TextureArray2d
+class SoftwareTextureArray
+{
+private:
+	//linear rgb texels of every layer
+	std::vector<glm::vec3> texels;
+	size_t texture_width = 0, texture_height = 0, texture_layers = 0;
+
+public:
+	SoftwareTextureArray() = default;
+
+	explicit SoftwareTextureArray(SoftwareTextureArray&) = delete;
+
+	SoftwareTextureArray& operator=(SoftwareTextureArray&) = delete;
+
+	//decodes the layers on the thread pool, the same images the TextureArray2d is built from
+	void load(ThreadPool& thread_pool, const std::vector<const char*>& texture_filenames, const size_t texture_width, const size_t texture_height);
+
+	//GL_LINEAR with GL_REPEAT on level 0
+	glm::vec3 sample(uint32_t layer, glm::vec2 tex_coord) const;
+
+	size_t get_layer_count() const
+	{
+		return texture_layers;
+	}
+};
+
+//the main shader's lighting, returns linear color
+glm::vec3 shade_fragment(const glm::vec3& texel, const glm::vec3& normal, const glm::vec3& frag_pos, const glm::vec3& view_pos);
+
+//encodes linear color to rgba8 like GL_FRAMEBUFFER_SRGB does on write
+uint32_t pack_srgb(const glm::vec3& color);
+
+#endif
@@ -0,0 +1,332 @@
+#include "ThreadPool.hpp"
+
+#include <stdexcept>
+
+//how many times an idle worker looks for work again before going to sleep
+constexpr int IDLE_SPINS = 64;
+
+//set on every worker so jobs submitted from inside jobs go to that worker's own deque
+static thread_local const ThreadPool* worker_pool = nullptr;
+static thread_local size_t worker_deque = 0;
+
+void WorkDeque::store_job(Slot& slot, const Job& job)
+{
+	uint64_t words[sizeof(Job) / sizeof(uint64_t)];
+	memcpy(words, &job, sizeof(Job));
+
+	for (size_t i = 0; i < sizeof(Job) / sizeof(uint64_t); i++)
+	{
+		slot.words[i].store(words[i], std::memory_order_relaxed);
+	}
+}
+
+void WorkDeque::load_job(const Slot& slot, Job& job)
+{
+	uint64_t words[sizeof(Job) / sizeof(uint64_t)];
+
+	for (size_t i = 0; i < sizeof(Job) / sizeof(uint64_t); i++)
+	{
+		words[i] = slot.words[i].load(std::memory_order_relaxed);
+	}
+
+	memcpy(&job, words, sizeof(Job));
+}
+
+WorkDeque::WorkDeque()
+	: slots(new Slot[CAPACITY])
+{
+}
+
+bool WorkDeque::push(const Job& job)
+{
+	const int64_t b = bottom.load(std::memory_order_relaxed);
+	const int64_t t = top.load(std::memory_order_acquire);
+
+	if (b - t >= CAPACITY)
+	{
+		return false;
+	}
+
+	store_job(slots[b & (CAPACITY - 1)], job);
+
+	//publish the job before the thieves can see the new bottom
+	bottom.store(b + 1, std::memory_order_release);
+
+	return true;
+}
+
+bool WorkDeque::pop(Job& job)
+{
+	const int64_t b = bottom.load(std::memory_order_relaxed) - 1;
+	bottom.store(b, std::memory_order_relaxed);
+
+	std::atomic_thread_fence(std::memory_order_seq_cst);
+
+	int64_t t = top.load(std::memory_order_relaxed);
+
+	if (t > b)
+	{
+		//empty
+		bottom.store(b + 1, std::memory_order_relaxed);
+
+		return false;
+	}
+
+	load_job(slots[b & (CAPACITY - 1)], job);
+
+	if (t != b)
+	{
+		return true;
+	}
+
+	//last job, race the thieves for it
+	const bool won = top.compare_exchange_strong(t, t + 1, std::memory_order_seq_cst, std::memory_order_relaxed);
+	bottom.store(b + 1, std::memory_order_relaxed);
+
+	return won;
+}
+
+bool WorkDeque::steal(Job& job)
+{
+	int64_t t = top.load(std::memory_order_acquire);
+
+	std::atomic_thread_fence(std::memory_order_seq_cst);
+
+	const int64_t b = bottom.load(std::memory_order_acquire);
+
+	if (t >= b)
+	{
+		return false;
+	}
+
+	load_job(slots[t & (CAPACITY - 1)], job);
+
+	return top.compare_exchange_strong(t, t + 1, std::memory_order_seq_cst, std::memory_order_relaxed);
+}
+
+ThreadPool::ThreadPool()
+	: owner_thread(std::this_thread::get_id())
+{
+	//don't immediatly terminate all threads
+	terminate_pool.store(false);
+
+	//hardware_concurrency can be 0 if it's unknown
+	const size_t thread_count = std::max(1u, std::thread::hardware_concurrency()) - 1;
+
+	//all deques have to exist before any worker starts stealing
+	for (size_t i = 0; i < thread_count + 1; i++)
+	{
+		deques.push_back(std::make_unique<WorkDeque>());
+	}
+
+	//allocate threads, start them off
+	for (size_t i = 0; i < thread_count; i++)
+	{
+		threads.push_back(std::thread{ &ThreadPool::thread_func, this, i + 1 });
+	}
+}
+
+ThreadPool::~ThreadPool()
+{
+	//call for threads to finish once every deque is empty
+	terminate_pool.store(true);
+
+	{
+		std::unique_lock<std::mutex> lock{ sleep_mutex };
+		wake_condition.notify_all();
+	}
+
+	//join all the threads
+	for (auto& thread : threads)
+	{
+		thread.join();
+	}
+
+	//whatever the owner left in its own deque
+	Job job;
+	while (deques[0]->pop(job))
+	{
+		job();
+	}
+
+	//without workers nobody took these
+	while (pop_background(job))
+	{
+		job();
+	}
+}
+
+void ThreadPool::thread_func(size_t deque_index)
+{
+	worker_pool = this;
+	worker_deque = deque_index;
+
+	//the job we execute
+	Job job;
+	while (true)
+	{
+		bool found = false;
+		for (int spin = 0; spin < IDLE_SPINS && !found; spin++)
+		{
+			found = find_job(deque_index, job) || pop_background(job);
+			if (!found)
+			{
+				std::this_thread::yield();
+			}
+		}
+
+		if (found)
+		{
+			job();
+			continue;
+		}
+
+		//remember the epoch before the last look, anything submitted after it wakes us up again
+		const uint64_t epoch = work_epoch.load();
+
+		if (find_job(deque_index, job) || pop_background(job))
+		{
+			job();
+			continue;
+		}
+
+		//if there are no more jobs to execute and we're told to quit, quit
+		if (terminate_pool.load())
+		{
+			break;
+		}
+
+		std::unique_lock<std::mutex> lock{ sleep_mutex };
+
+		sleeping.fetch_add(1);
+		wake_condition.wait(lock, [this, epoch]() { return work_epoch.load() != epoch || terminate_pool.load(); });
+		sleeping.fetch_sub(1);
+	}
+}
+
+bool ThreadPool::find_job(size_t deque_index, Job& job)
+{
+	if (deque_index < deques.size() && deques[deque_index]->pop(job))
+	{
+		return true;
+	}
+
+	//start with the next deque over so thieves spread out
+	for (size_t i = 1; i <= deques.size(); i++)
+	{
+		const size_t victim = (deque_index + i) % deques.size();
+
+		if (victim != deque_index && deques[victim]->steal(job))
+		{
+			return true;
+		}
+	}
+
+	return false;
+}
+
+size_t ThreadPool::current_deque() const
+{
+	if (worker_pool == this)
+	{
+		return worker_deque;
+	}
+
+	if (std::this_thread::get_id() == owner_thread)
+	{
+		return 0;
+	}
+
+	return deques.size();
+}
+
+void ThreadPool::submit(const Job& job)
+{
+	const size_t deque_index = current_deque();
+	if (deque_index >= deques.size())
+	{
+		throw std::logic_error("Jobs can only be submitted from the thread that created the ThreadPool or from its jobs");
+	}
+
+	//a full deque means there is more than enough queued up already
+	if (!deques[deque_index]->push(job))
+	{
+		job();
+		return;
+	}
+
+	work_epoch.fetch_add(1);
+
+	if (sleeping.load() > 0)
+	{
+		std::unique_lock<std::mutex> lock{ sleep_mutex };
+		wake_condition.notify_one();
+	}
+}
+
+void ThreadPool::submit_background(const Job& job)
+{
+	{
+		std::unique_lock<std::mutex> lock{ background_mutex };
+		background_jobs.push_back(job);
+	}
+
+	work_epoch.fetch_add(1);
+
+	if (sleeping.load() > 0)
+	{
+		std::unique_lock<std::mutex> lock{ sleep_mutex };
+		wake_condition.notify_one();
+	}
+}
+
+bool ThreadPool::pop_background(Job& job)
+{
+	std::unique_lock<std::mutex> lock{ background_mutex };
+
+	if (background_jobs.empty())
+	{
+		return false;
+	}
+
+	job = background_jobs.front();
+	background_jobs.pop_front();
+
+	return true;
+}
+
+bool ThreadPool::run_pending_job()
+{
+	Job job;
+	if (find_job(current_deque(), job))
+	{
+		job();
+		return true;
+	}
+
+	return false;
+}
+
+bool ThreadPool::run_background_job()
+{
+	Job job;
+	if (pop_background(job))
+	{
+		job();
+		return true;
+	}
+
+	return false;
+}
+
+void TaskGroup::wait()
+{
+	while (!is_done())
+	{
+		//without workers the background jobs would never finish otherwise
+		if (!pool.run_pending_job() && !(pool.get_thread_count() == 0 && pool.run_background_job()))
+		{
+			std::this_thread::yield();
+		}
+	}
+}
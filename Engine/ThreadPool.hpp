@@ -1,93 +1,305 @@
 #ifndef CPP_DESIGNO_ENGINE_HPP_THREADPOOL
 #define CPP_DESIGNO_ENGINE_HPP_THREADPOOL
 
-#include <queue>
 #include <vector>
+#include <deque>
 #include <thread>
 #include <mutex>
-#include <functional>
+#include <atomic>
+#include <memory>
+#include <optional>
+#include <algorithm>
+#include <cstring>
+#include <cstdint>
+#include <type_traits>
 #include <condition_variable>
 
+//a job is stored inline in a fixed size buffer so scheduling it never allocates,
+//only small trivially copyable callables fit (lambdas capturing pointers, references and plain values)
+class Job
+{
+public:
+	static constexpr size_t STORAGE_SIZE = 56;
+
+private:
+	using Invoke = void(*)(const void* storage);
+
+	Invoke invoke = nullptr;
+	alignas(8) unsigned char storage[STORAGE_SIZE];
+
+public:
+	template<typename F>
+	static Job make(const F& func)
+	{
+		static_assert(std::is_trivially_copyable<F>::value, "Jobs are copied byte by byte, capture pointers or references instead of owning objects");
+		static_assert(sizeof(F) <= STORAGE_SIZE, "Job captures too much, capture a pointer to the data instead");
+		static_assert(alignof(F) <= 8, "Job captures are over aligned");
+
+		Job job;
+		job.invoke = [](const void* storage)
+		{
+			(*static_cast<const F*>(storage))();
+		};
+		memcpy(job.storage, &func, sizeof(F));
+
+		return job;
+	}
+
+	void operator()() const
+	{
+		invoke(storage);
+	}
+};
+
+static_assert(sizeof(Job) == 64, "Job must fill one deque slot");
+
+//Chase-Lev work stealing deque with a fixed capacity, the owning thread pushes and pops at the bottom
+//while any thread may steal from the top
+class WorkDeque
+{
+	static constexpr int64_t CAPACITY = 4096;
+
+	//jobs are copied in and out word by word with atomics, a thief may read a slot the owner is rewriting
+	//and will then fail its compare exchange and throw the copy away
+	struct Slot
+	{
+		std::atomic<uint64_t> words[sizeof(Job) / sizeof(uint64_t)];
+	};
+
+	alignas(64) std::atomic<int64_t> top{ 0 };
+	alignas(64) std::atomic<int64_t> bottom{ 0 };
+
+	std::unique_ptr<Slot[]> slots;
+
+	static void store_job(Slot& slot, const Job& job);
+
+	static void load_job(const Slot& slot, Job& job);
+
+public:
+	explicit WorkDeque();
+
+	//fails when the deque is full
+	bool push(const Job& job);
+
+	bool pop(Job& job);
+
+	bool steal(Job& job);
+};
+
 class ThreadPool
 {
 	std::vector<std::thread> threads;
 
-	std::condition_variable condition;
+	//deque 0 belongs to the thread that created the pool, the rest to the workers in order
+	std::vector<std::unique_ptr<WorkDeque>> deques;
+
+	std::thread::id owner_thread;
 
-	//controlled by queue_mutex
-	std::queue<std::function<void()>> func_queue;
-	
-	//controlled by queue_mutex
 	std::atomic_bool terminate_pool;
 
-	std::mutex queue_mutex;
+	//idle workers sleep until the epoch changes, which happens on every submission
+	std::mutex sleep_mutex;
+	std::condition_variable wake_condition;
+	std::atomic<uint64_t> work_epoch{ 0 };
+	std::atomic<uint32_t> sleeping{ 0 };
+
+	//jobs only the workers take, so a thread waiting on the pool never ends up running them
+	std::mutex background_mutex;
+	std::deque<Job> background_jobs;
+
+	void thread_func(size_t deque_index);
+
+	//pops from the given deque or steals from the others
+	bool find_job(size_t deque_index, Job& job);
+
+	//deque owned by the calling thread, or deques.size() if it doesn't own one
+	size_t current_deque() const;
+
+	void submit(const Job& job);
+
+	void submit_background(const Job& job);
+
+	bool pop_background(Job& job);
+
+	friend class TaskGroup;
+
+public:
+	explicit ThreadPool();
+
+	~ThreadPool();
+
+	explicit ThreadPool(ThreadPool&) = delete;
 
-	void thread_func()
+	ThreadPool& operator=(ThreadPool&) = delete;
+
+	size_t get_thread_count() const
 	{
-		//the job we execute
-		std::function<void()> job_func;
-		while (true)
-		{
-			job_func = nullptr;
+		return threads.size();
+	}
+
+	//runs one queued job on the calling thread if there is any
+	bool run_pending_job();
+
+	//runs one background job on the calling thread if there is any, for pools without workers
+	bool run_background_job();
+
+	//fire and forget, the pool finishes every queued job before it is destroyed
+	template<typename F>
+	void add_work(const F& work)
+	{
+		submit(Job::make(work));
+	}
+
+	//calls func for every index in [0, count) on the pool and on the calling thread, returns once they're all done
+	template<typename F>
+	void parallel_for(size_t count, const F& func, size_t grain = 0);
+
+	template<typename F>
+	auto async(const F& func);
+};
+
+//a set of jobs that can be waited on, the waiting thread runs queued jobs instead of blocking
+class TaskGroup
+{
+	ThreadPool& pool;
+
+	std::atomic<size_t> pending{ 0 };
+
+public:
+	explicit TaskGroup(ThreadPool& pool)
+		: pool(pool)
+	{
+	}
+
+	~TaskGroup()
+	{
+		wait();
+	}
+
+	explicit TaskGroup(TaskGroup&) = delete;
+
+	TaskGroup& operator=(TaskGroup&) = delete;
+
+	template<typename F>
+	void run(const F& func)
+	{
+		pending.fetch_add(1, std::memory_order_relaxed);
+
+		TaskGroup* group = this;
+		pool.submit(Job::make([group, func]()
 			{
-				std::unique_lock<std::mutex> lock{ queue_mutex };
+				func();
 
-				//wait for availablility of queue
-				condition.wait(lock, [this]() { return !func_queue.empty() || terminate_pool.load(); });
+				group->pending.fetch_sub(1, std::memory_order_release);
+			}));
+	}
 
-				//if there are no more jobs to execute and we're told to quit, quit
-				if (func_queue.empty() && terminate_pool.load())
-				{
-					break;
-				}
+	//like run but never picked up by wait or parallel_for on the submitting thread,
+	//for long jobs that shouldn't stall it
+	template<typename F>
+	void run_background(const F& func)
+	{
+		pending.fetch_add(1, std::memory_order_relaxed);
 
-				//get from queue, and remove from queue
-				job_func = func_queue.front();
-				func_queue.pop();
-			}
-			//execute the job we got from the queue, if it exists
-			if (job_func != nullptr)
+		TaskGroup* group = this;
+		pool.submit_background(Job::make([group, func]()
 			{
-				job_func();
-			}
-		}
+				func();
+
+				group->pending.fetch_sub(1, std::memory_order_release);
+			}));
+	}
+
+	bool is_done() const
+	{
+		return pending.load(std::memory_order_acquire) == 0;
 	}
 
+	void wait();
+};
+
+//result of ThreadPool::async, it can't be moved because the running job writes straight into it
+template<typename T>
+class Future
+{
+	static_assert(!std::is_void<T>::value, "Use a TaskGroup for jobs without a result");
+
+	std::optional<T> value;
+
+	TaskGroup group;
+
 public:
-	ThreadPool()
+	template<typename F>
+	explicit Future(ThreadPool& pool, const F& func)
+		: group(pool)
 	{
-		//don't immediatly terminate all threads
-		terminate_pool.store(false);
+		Future* future = this;
+		group.run([future, func]()
+			{
+				future->value.emplace(func());
+			});
+	}
 
-		//allocate threads, start them off
-		for (size_t i = 0; i < (std::thread::hardware_concurrency() - 1); i++)
-		{
-			threads.push_back(std::thread{ &ThreadPool::thread_func, this });
-		}
+	explicit Future(Future&) = delete;
+
+	Future& operator=(Future&) = delete;
+
+	bool is_ready() const
+	{
+		return group.is_done();
 	}
 
-	~ThreadPool()
+	T& get()
 	{
-		//call for threads to finish once queue is empty
-		terminate_pool.store(true);
+		group.wait();
 
-		condition.notify_all();
+		return *value;
+	}
+};
 
-		//join all the threads
-		for (auto& thread : threads)
-		{
-			thread.join();
-		}
+template<typename F>
+void ThreadPool::parallel_for(size_t count, const F& func, size_t grain)
+{
+	if (count == 0)
+	{
+		return;
 	}
 
-	void add_work(const std::function<void()>& work)
+	//a few chunks per thread lets idle threads steal the leftovers of slow ones
+	if (grain == 0)
 	{
-		{
-			std::unique_lock<std::mutex> lock(queue_mutex);
-			func_queue.push(work);
-		}
-		condition.notify_all();
+		grain = std::max<size_t>(1, count / ((threads.size() + 1) * 4));
 	}
-};
 
-#endif
\ No newline at end of file
+	TaskGroup group{ *this };
+
+	const F* function = &func;
+	for (size_t begin = grain; begin < count; begin += grain)
+	{
+		const size_t end = std::min(begin + grain, count);
+
+		group.run([function, begin, end]()
+			{
+				for (size_t i = begin; i < end; i++)
+				{
+					(*function)(i);
+				}
+			});
+	}
+
+	//the first chunk runs right here
+	for (size_t i = 0; i < std::min(grain, count); i++)
+	{
+		func(i);
+	}
+
+	group.wait();
+}
+
+template<typename F>
+auto ThreadPool::async(const F& func)
+{
+	return Future<decltype(func())>{ *this, func };
+}
+
+#endif
@@ -1,20 +1,209 @@
 #include <exception>
 #include <iostream>
+#include <string>
+#include <stdexcept>
+#include <algorithm>
 
 #include "Renderer.hpp"
 
+//usage: Engine [--map file] [--renderer gl|software|portal] [--culling portal|frustum] [--vertices attributes|pulled] [--movers n] [--record path.txt] [--trace trace.json]
+//       Engine [--map file] [--renderer gl|software|portal] [--culling portal|frustum] [--vertices attributes|pulled] [--movers n] --bench path.txt [--frames n] [--warmup n] [--size WxH] [--output bench.json]
+//              [--screenshot last.ppm] [--trace trace.json]
+//--movers turns the floors of the first n sectors into lifts, to see what moving sectors cost
+//       with --vertices attributes and the software renderer every step regenerates each moving sector and its neighbors, pulled vertices only upload the new heights
+//in builds with the profiler F3 shows the frame time graph and F4 starts/stops a trace
+//for machines without a display run with SDL_VIDEODRIVER=offscreen, the software and portal renderers need no gpu, gl needs LIBGL_ALWAYS_SOFTWARE=1 for mesa's software rasterizer
+struct Arguments
+{
+	std::string map_filename;
+	std::string record_filename;
+	std::string trace_filename;
+
+	RenderBackend backend = RenderBackend::OPENGL;
+	CullingMode culling = CullingMode::PORTAL;
+	VertexFetch vertex_fetch = VertexFetch::ATTRIBUTES;
+	uint32_t movers = 0;
+
+	bool bench = false;
+	BenchmarkSettings bench_settings;
+};
+
+static Arguments parse_arguments(int argc, char** argv)
+{
+	Arguments arguments;
+
+	for (int i = 1; i < argc; i++)
+	{
+		const std::string arg = argv[i];
+
+		//every option takes a value
+		if (i + 1 >= argc)
+		{
+			throw std::runtime_error("Missing value for " + arg);
+		}
+
+		const std::string value = argv[++i];
+
+		if (arg == "--map")
+		{
+			arguments.map_filename = value;
+		}
+		else if (arg == "--record")
+		{
+			arguments.record_filename = value;
+		}
+		else if (arg == "--renderer")
+		{
+			if (value == "gl")
+			{
+				arguments.backend = RenderBackend::OPENGL;
+			}
+			else if (value == "software")
+			{
+				arguments.backend = RenderBackend::SOFTWARE;
+			}
+			else if (value == "portal")
+			{
+				arguments.backend = RenderBackend::PORTAL;
+			}
+			else
+			{
+				throw std::runtime_error("Renderer must be gl, software or portal");
+			}
+		}
+		else if (arg == "--culling")
+		{
+			if (value == "portal")
+			{
+				arguments.culling = CullingMode::PORTAL;
+			}
+			else if (value == "frustum")
+			{
+				arguments.culling = CullingMode::FRUSTUM;
+			}
+			else
+			{
+				throw std::runtime_error("Culling must be portal or frustum");
+			}
+		}
+		else if (arg == "--vertices")
+		{
+			if (value == "attributes")
+			{
+				arguments.vertex_fetch = VertexFetch::ATTRIBUTES;
+			}
+			else if (value == "pulled")
+			{
+				arguments.vertex_fetch = VertexFetch::PULLED;
+			}
+			else
+			{
+				throw std::runtime_error("Vertices must be attributes or pulled");
+			}
+		}
+		else if (arg == "--movers")
+		{
+			arguments.movers = static_cast<uint32_t>(std::stoul(value));
+		}
+		else if (arg == "--screenshot")
+		{
+			arguments.bench_settings.screenshot = value;
+		}
+		else if (arg == "--trace")
+		{
+			arguments.trace_filename = value;
+		}
+		else if (arg == "--bench")
+		{
+			arguments.bench = true;
+			arguments.bench_settings.camera_path = value;
+		}
+		else if (arg == "--frames")
+		{
+			arguments.bench_settings.frames = static_cast<uint32_t>(std::stoul(value));
+		}
+		else if (arg == "--warmup")
+		{
+			arguments.bench_settings.warmup_frames = static_cast<uint32_t>(std::stoul(value));
+		}
+		else if (arg == "--output")
+		{
+			arguments.bench_settings.output = value;
+		}
+		else if (arg == "--size")
+		{
+			const size_t x = value.find('x');
+			if (x == std::string::npos)
+			{
+				throw std::runtime_error("Size must look like 1280x720");
+			}
+
+			arguments.bench_settings.width = std::stoi(value.substr(0, x));
+			arguments.bench_settings.height = std::stoi(value.substr(x + 1));
+		}
+		else
+		{
+			throw std::runtime_error("Unknown argument " + arg);
+		}
+	}
+
+	if (arguments.bench_settings.frames == 0 || arguments.bench_settings.width <= 0 || arguments.bench_settings.height <= 0)
+	{
+		throw std::runtime_error("Benchmark needs at least one frame and a positive size");
+	}
+
+	return arguments;
+}
+
 int main(int argc, char** argv)
 {
 	try
 	{
-		Renderer renderer;
+		const Arguments arguments = parse_arguments(argc, argv);
+
+		Renderer renderer{ arguments.map_filename, arguments.bench, arguments.backend };
+
+		renderer.set_culling(arguments.culling);
 
-		renderer.run();
+		if (arguments.vertex_fetch != VertexFetch::ATTRIBUTES)
+		{
+			renderer.set_vertex_fetch(arguments.vertex_fetch);
+		}
+
+		const auto& sectors = renderer.get_sectors();
+		for (uint32_t i = 0; i < std::min<size_t>(arguments.movers, sectors.size()); i++)
+		{
+			const float floor = sectors[i].floor;
+			const float ceil = std::max(sectors[i].ceil, floor);
+
+			renderer.add_mover(SectorMover{ i, false, floor, floor + (ceil - floor) * 0.5f, 4.0f, 1.0f });
+		}
+
+		if (!arguments.trace_filename.empty())
+		{
+			renderer.capture_trace(arguments.trace_filename);
+		}
+
+		if (arguments.bench)
+		{
+			renderer.run_benchmark(arguments.bench_settings);
+		}
+		else
+		{
+			if (!arguments.record_filename.empty())
+			{
+				renderer.record_camera_path(arguments.record_filename);
+			}
+
+			renderer.run();
+		}
 	}
 	catch (const std::exception& exp)
 	{
 		std::cerr << "Exception: " << exp.what() << '\n';
+
+		return 1;
 	}
 
 	return 0;
-}
\ No newline at end of file
+}
@@ -0,0 +1,28 @@
+#include <exception>
+#include <iostream>
+
+#include "MapFile.hpp"
+
+//converts a text map (map.sec) into the binary format the Engine maps into memory (map.secb)
+int main(int argc, char** argv)
+{
+	const char* input_filename = argc > 1 ? argv[1] : "map.sec";
+	const char* output_filename = argc > 2 ? argv[2] : "map.secb";
+
+	try
+	{
+		const MapData map = read_text_map(input_filename);
+
+		write_binary_map(output_filename, map);
+
+		std::cout << "Wrote " << map.sectors.size() << " sectors and " << map.vertices.size() << " vertices to " << output_filename << '\n';
+	}
+	catch (const std::exception& exp)
+	{
+		std::cerr << "Exception: " << exp.what() << '\n';
+
+		return 1;
+	}
+
+	return 0;
+}
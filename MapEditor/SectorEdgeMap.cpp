@@ -0,0 +1,124 @@
+#include "SectorEdgeMap.hpp"
+
+#include <cmath>
+
+#include "VertexWelder.hpp"
+
+//vertices closer than this snap to the same key, the editor places them on whole units anyway
+constexpr float QUANTIZE_SCALE = 1024.0f;
+
+size_t SectorEdgeMap::EdgeKeyHash::operator()(const EdgeKey& key) const
+{
+	return static_cast<size_t>(hash_bytes(&key, sizeof(EdgeKey)));
+}
+
+SectorEdgeMap::EdgeKey SectorEdgeMap::make_key(const glm::vec2& v1, const glm::vec2& v2)
+{
+	auto quantize = [](float value)
+	{
+		return static_cast<int32_t>(std::lround(value * QUANTIZE_SCALE));
+	};
+
+	return EdgeKey{ quantize(v1.x), quantize(v1.y), quantize(v2.x), quantize(v2.y) };
+}
+
+SectorEdgeMap::EdgeKey SectorEdgeMap::edge_key(const Sector& sector, size_t edge)
+{
+	const size_t next = edge + 1 == sector.vertices.size() ? 0 : edge + 1;
+
+	return make_key(sector.vertices[edge], sector.vertices[next]);
+}
+
+int32_t SectorEdgeMap::find_twin(const EdgeKey& key, uint32_t exclude) const
+{
+	const EdgeKey reversed{ key.x2, key.y2, key.x1, key.y1 };
+
+	const auto range = edges.equal_range(reversed);
+	for (auto it = range.first; it != range.second; ++it)
+	{
+		if (it->second.sector != exclude)
+		{
+			return static_cast<int32_t>(it->second.sector);
+		}
+	}
+
+	return -1;
+}
+
+void SectorEdgeMap::add_sector(std::vector<Sector>& sectors, uint32_t sector_index)
+{
+	auto& sector = sectors[sector_index];
+
+	sector.neighbors.resize(sector.vertices.size());
+
+	for (uint32_t i = 0; i < sector.vertices.size(); i++)
+	{
+		const auto key = edge_key(sector, i);
+
+		const int32_t twin = find_twin(key, sector_index);
+		sector.neighbors[i] = twin;
+
+		//point the other side back at the new sector
+		if (twin >= 0)
+		{
+			const EdgeKey reversed{ key.x2, key.y2, key.x1, key.y1 };
+
+			const auto range = edges.equal_range(reversed);
+			for (auto it = range.first; it != range.second; ++it)
+			{
+				if (it->second.sector != sector_index)
+				{
+					sectors[it->second.sector].neighbors[it->second.edge] = static_cast<int32_t>(sector_index);
+				}
+			}
+		}
+
+		edges.emplace(key, EdgeRef{ sector_index, i });
+	}
+}
+
+void SectorEdgeMap::remove_back(std::vector<Sector>& sectors)
+{
+	if (sectors.empty())
+	{
+		return;
+	}
+
+	const uint32_t sector_index = static_cast<uint32_t>(sectors.size() - 1);
+	const auto& sector = sectors[sector_index];
+
+	for (uint32_t i = 0; i < sector.vertices.size(); i++)
+	{
+		const auto key = edge_key(sector, i);
+
+		auto range = edges.equal_range(key);
+		for (auto it = range.first; it != range.second; ++it)
+		{
+			if (it->second.sector == sector_index && it->second.edge == i)
+			{
+				edges.erase(it);
+				break;
+			}
+		}
+	}
+
+	//relink the sides that pointed at it, to an overlapping sector if there is one
+	for (uint32_t i = 0; i < sector.vertices.size(); i++)
+	{
+		const auto key = edge_key(sector, i);
+		const EdgeKey reversed{ key.x2, key.y2, key.x1, key.y1 };
+
+		const auto range = edges.equal_range(reversed);
+		for (auto it = range.first; it != range.second; ++it)
+		{
+			auto& neighbor = sectors[it->second.sector].neighbors[it->second.edge];
+
+			if (neighbor == static_cast<int32_t>(sector_index))
+			{
+				neighbor = find_twin(reversed, it->second.sector);
+			}
+		}
+	}
+
+	sectors.pop_back();
+}
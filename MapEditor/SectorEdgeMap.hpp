@@ -0,0 +1,54 @@
+#ifndef SECTOR_EDGE_MAP_HPP
+#define SECTOR_EDGE_MAP_HPP
+
+#include <vector>
+#include <unordered_map>
+#include <cstdint>
+
+#include "Sector.hpp"
+
+//finds portals by hashing every sector edge on its quantized endpoints,
+//a portal is an edge whose reverse, from its second vertex to its first, belongs to another sector
+class SectorEdgeMap
+{
+	struct EdgeKey
+	{
+		int32_t x1, y1, x2, y2;
+
+		bool operator==(const EdgeKey& o) const
+		{
+			return x1 == o.x1 && y1 == o.y1 && x2 == o.x2 && y2 == o.y2;
+		}
+	};
+
+	struct EdgeKeyHash
+	{
+		size_t operator()(const EdgeKey& key) const;
+	};
+
+	struct EdgeRef
+	{
+		uint32_t sector, edge;
+	};
+
+	//overlapping sectors can share an edge, so a key can have more than one
+	std::unordered_multimap<EdgeKey, EdgeRef, EdgeKeyHash> edges;
+
+	static EdgeKey make_key(const glm::vec2& v1, const glm::vec2& v2);
+
+	static EdgeKey edge_key(const Sector& sector, size_t edge);
+
+	//the sector other than exclude that has the edge from v2 to v1, or -1
+	int32_t find_twin(const EdgeKey& key, uint32_t exclude) const;
+
+public:
+	explicit SectorEdgeMap() = default;
+
+	//call after pushing a sector, links it and the sectors it shares edges with
+	void add_sector(std::vector<Sector>& sectors, uint32_t sector_index);
+
+	//unlinks the last sector from its neighbors and pops it
+	void remove_back(std::vector<Sector>& sectors);
+};
+
+#endif
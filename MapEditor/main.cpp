@@ -3,8 +3,8 @@
 #include <array>
 #include <vector>
 #include <algorithm>
-#include <fstream>
 #include <future>
+#include <chrono>
 
 #include <glad/glad.h>
 #include <GLFW/glfw3.h>
@@ -16,6 +16,10 @@
 #include "Camera.hpp"
 
 #include "Sector.hpp"
+#include "SectorEdgeMap.hpp"
+
+#include "MapFile.hpp"
+#include "VertexWelder.hpp"
 
 //the programming in here might be a bit shoddy, due to this being a one-off
 
@@ -31,11 +35,16 @@ static int width = 1600, height = 900;
 
 static GLuint shader_program = 0;
 
+//takes the model matrix from a per instance attribute instead of a uniform
+static GLuint instanced_shader_program = 0;
+
 static bool is_z_pressed = false;
 static bool is_p_pressed = false;
 static bool is_g_pressed = false;
 static bool is_n_pressed = false;
 static bool is_o_pressed = false;
+static bool is_b_pressed = false;
+static bool is_y_pressed = false;
 
 static bool is_1_pressed = false;
 static bool is_2_pressed = false;
@@ -54,6 +63,18 @@ static bool draw_grid = true;
 
 static std::vector<Sector> sectors;
 
+enum class MapFormat
+{
+	TEXT,
+	BINARY
+};
+
+//saves are written on another thread so the editor doesn't stall on big maps
+static std::future<void> pending_save;
+
+//keeps the portals between sectors linked as they're made and removed
+static SectorEdgeMap sector_edges;
+
 struct Renderable
 {
 	GLuint vao, vbo;
@@ -78,6 +99,42 @@ static std::vector<Renderable> sector_wireframe_meshes;
 
 static Renderable sector_height_bar;
 
+//a mesh drawn once per matrix in its instance buffer
+struct InstancedRenderable
+{
+	GLuint vao, instance_buffer;
+	GLsizei size, instance_count;
+};
+
+static InstancedRenderable sector_vert_markers;
+static InstancedRenderable sector_height_bars;
+static InstancedRenderable cube_vert_markers;
+
+//the instance buffers are only rebuilt when what they show changes
+static bool sector_instances_dirty = true;
+static bool cube_vert_instances_dirty = true;
+
+GLuint link_shader_program(const char* vertex_shader_code, const char* fragment_shader_code)
+{
+	auto vertex_shader = glCreateShader(GL_VERTEX_SHADER);
+	glShaderSource(vertex_shader, 1, &vertex_shader_code, nullptr);
+	glCompileShader(vertex_shader);
+
+	auto fragment_shader = glCreateShader(GL_FRAGMENT_SHADER);
+	glShaderSource(fragment_shader, 1, &fragment_shader_code, nullptr);
+	glCompileShader(fragment_shader);
+
+	const auto program = glCreateProgram();
+	glAttachShader(program, vertex_shader);
+	glAttachShader(program, fragment_shader);
+	glLinkProgram(program);
+
+	glDeleteShader(vertex_shader);
+	glDeleteShader(fragment_shader);
+
+	return program;
+}
+
 void create_shader_program()
 {
 	constexpr auto vertex_shader_code =
@@ -102,21 +159,21 @@ void create_shader_program()
 		"	out_colour = vec4(in_colour, 1.0f);"
 		"}";
 
-	auto vertex_shader = glCreateShader(GL_VERTEX_SHADER);
-	glShaderSource(vertex_shader, 1, &vertex_shader_code, nullptr);
-	glCompileShader(vertex_shader);
-
-	auto fragment_shader = glCreateShader(GL_FRAGMENT_SHADER);
-	glShaderSource(fragment_shader, 1, &fragment_shader_code, nullptr);
-	glCompileShader(fragment_shader);
-
-	shader_program = glCreateProgram();
-	glAttachShader(shader_program, vertex_shader);
-	glAttachShader(shader_program, fragment_shader);
-	glLinkProgram(shader_program);
+	constexpr auto instanced_vertex_shader_code =
+		"#version 430 core\n"
+		"layout (location = 0) uniform mat4 proj_view_mat;"
+		"layout (location = 0) in vec3 pos;"
+		"layout (location = 1) in vec3 colour;"
+		"layout (location = 2) in mat4 model_mat;"
+		"layout (location = 0) out vec3 out_colour;"
+		"void main()"
+		"{"
+		"	gl_Position = proj_view_mat * model_mat * vec4(pos, 1.0);"
+		"	out_colour = colour;"
+		"}";
 
-	glDeleteShader(vertex_shader);
-	glDeleteShader(fragment_shader);
+	shader_program = link_shader_program(vertex_shader_code, fragment_shader_code);
+	instanced_shader_program = link_shader_program(instanced_vertex_shader_code, fragment_shader_code);
 }
 
 void destroy_renderable(Renderable& renderable)
@@ -194,6 +251,58 @@ Renderable create_cube(float r, float g, float b)
 	return cube;
 }
 
+//shares the mesh's vertex buffer, the instance matrices take up locations 2 to 5
+InstancedRenderable create_instanced(const Renderable& mesh)
+{
+	InstancedRenderable instanced;
+
+	glCreateVertexArrays(1, &instanced.vao);
+	glCreateBuffers(1, &instanced.instance_buffer);
+
+	glVertexArrayVertexBuffer(instanced.vao, 0, mesh.vbo, 0, 6 * sizeof(float));
+
+	glVertexArrayAttribFormat(instanced.vao, 0, 3, GL_FLOAT, GL_FALSE, 0);
+	glVertexArrayAttribBinding(instanced.vao, 0, 0);
+	glEnableVertexArrayAttrib(instanced.vao, 0);
+
+	glVertexArrayAttribFormat(instanced.vao, 1, 3, GL_FLOAT, GL_FALSE, 3 * sizeof(float));
+	glVertexArrayAttribBinding(instanced.vao, 1, 0);
+	glEnableVertexArrayAttrib(instanced.vao, 1);
+
+	glVertexArrayVertexBuffer(instanced.vao, 1, instanced.instance_buffer, 0, sizeof(glm::mat4));
+	glVertexArrayBindingDivisor(instanced.vao, 1, 1);
+
+	for (GLuint column = 0; column < 4; column++)
+	{
+		glVertexArrayAttribFormat(instanced.vao, 2 + column, 4, GL_FLOAT, GL_FALSE, column * sizeof(glm::vec4));
+		glVertexArrayAttribBinding(instanced.vao, 2 + column, 1);
+		glEnableVertexArrayAttrib(instanced.vao, 2 + column);
+	}
+
+	instanced.size = mesh.size;
+	instanced.instance_count = 0;
+
+	return instanced;
+}
+
+void upload_instances(InstancedRenderable& instanced, const std::vector<glm::mat4>& mats)
+{
+	//respecifying orphans the old storage if a draw still uses it, and it only happens on edits
+	glNamedBufferData(instanced.instance_buffer, mats.size() * sizeof(glm::mat4), mats.data(), GL_STATIC_DRAW);
+
+	instanced.instance_count = static_cast<GLsizei>(mats.size());
+}
+
+void draw_instanced(const InstancedRenderable& instanced, GLenum mode)
+{
+	if (instanced.instance_count > 0)
+	{
+		glBindVertexArray(instanced.vao);
+
+		glDrawArraysInstanced(mode, 0, instanced.size, instanced.instance_count);
+	}
+}
+
 Renderable create_grid()
 {
 	Renderable grid;
@@ -268,8 +377,17 @@ void create_sector_height_bar()
 
 	glBindVertexArray(sector_height_bar.vao);
 
+	//a unit line, every sector's instance moves it to its floor and stretches it to its ceiling
+	constexpr float r = 0.3f, g = 0.0f, b = 1.0f;
+
+	const std::array<float, 12> vertices
+	{
+		0.0f, 0.0f, 0.0f, r, g, b,
+		0.0f, 1.0f, 0.0f, r, g, b
+	};
+
 	glBindBuffer(GL_ARRAY_BUFFER, sector_height_bar.vbo);
-	glBufferData(GL_ARRAY_BUFFER, sizeof(glm::vec3) * 4, nullptr, GL_DYNAMIC_DRAW);
+	glBufferData(GL_ARRAY_BUFFER, vertices.size() * sizeof(float), vertices.data(), GL_STATIC_DRAW);
 
 	glVertexAttribPointer(0, 3, GL_FLOAT, GL_FALSE, 6 * sizeof(float), (void*)0);
 	glEnableVertexAttribArray(0);
@@ -297,6 +415,47 @@ glm::vec2 get_avg_pos(const Sector& sector)
 	return avg_pos;
 }
 
+void update_sector_instances()
+{
+	std::vector<glm::mat4> vert_mats;
+	std::vector<glm::mat4> bar_mats;
+
+	bar_mats.reserve(sectors.size());
+
+	for (const auto& sector : sectors)
+	{
+		for (const auto& vert : sector.vertices)
+		{
+			vert_mats.push_back(glm::scale(glm::translate(glm::mat4(1.0f), glm::vec3{ vert.x, 0.0f, vert.y }), glm::vec3(0.1f)));
+		}
+
+		//get center
+		const glm::vec2 avg_pos = get_avg_pos(sector);
+
+		bar_mats.push_back(glm::scale(glm::translate(glm::mat4(1.0f), glm::vec3{ avg_pos.x, sector.floor, avg_pos.y }), glm::vec3{ 1.0f, sector.ceil - sector.floor, 1.0f }));
+	}
+
+	upload_instances(sector_vert_markers, vert_mats);
+	upload_instances(sector_height_bars, bar_mats);
+
+	sector_instances_dirty = false;
+}
+
+void update_cube_vert_instances()
+{
+	std::vector<glm::mat4> mats;
+	mats.reserve(cube_vert_poses.size());
+
+	for (const auto& cube_vert_pos : cube_vert_poses)
+	{
+		mats.push_back(glm::scale(glm::translate(glm::mat4(1.0f), cube_vert_pos), glm::vec3(0.3f)));
+	}
+
+	upload_instances(cube_vert_markers, mats);
+
+	cube_vert_instances_dirty = false;
+}
+
 //keyboard press input
 void process_input();
 
@@ -308,104 +467,104 @@ void framebuffer_size_callback(GLFWwindow* window, int width, int height)
 	glViewport(0, 0, width, height);
 }
 
-void write_sectors_to_file()
+//a copy of the sectors to save, so they can keep being edited while it's written
+MapData make_map_data()
 {
-	std::ofstream file{ "map.sec" };
+	MapData map;
 
-	file << "texture \"wall.jpg\"\n" << "texture \"container.jpg\"\n" << "texture \"stone.jpg\"\n";
+	map.add_texture("wall.jpg");
+	map.add_texture("container.jpg");
+	map.add_texture("stone.jpg");
 
-	uint32_t offset = 0;
+	//sectors share their corners with their neighbors, only store each corner once
+	size_t vertex_count = 0;
 	for (const auto& sector : sectors)
 	{
-		uint32_t temp_offset = 0;
+		vertex_count += sector.vertices.size();
+	}
 
-		for (const auto& vertex : sector.vertices)
-		{
-			file << "vertex " << vertex.x << ' ' << vertex.y << '\n';
-		}
+	VertexWelder<glm::vec2> welder{ map.vertices, vertex_count };
 
-		temp_offset = static_cast<uint32_t>(sector.vertices.size());
+	for (const auto& sector : sectors)
+	{
+		MapSectorRecord record;
+
+		record.floor = sector.floor;
+		record.ceil = sector.ceil;
+
+		record.wall_type = sector.wall_type;
+		record.ceil_type = sector.ceil_type;
+		record.floor_type = sector.floor_type;
 
-		file << "sector " << sector.floor << ' ' << sector.ceil << ' ' << sector.wall_type << ' ' << sector.ceil_type << ' ' << sector.floor_type << ' ';
+		record.first = static_cast<uint32_t>(map.indices.size());
+		record.count = static_cast<uint32_t>(sector.vertices.size());
 
 		for (size_t i = 0; i < sector.vertices.size(); i++)
 		{
-			file << i + offset << ' ';
-		}
+			map.indices.push_back(welder.add(sector.vertices[i]));
 
-		for (const auto& neighbor : sector.neighbors)
-		{
-			file << neighbor << ' ';
+			map.neighbors.push_back(sector.neighbors[i]);
 		}
 
-		file << '\n';
-
-		offset += temp_offset;
+		map.sectors.push_back(record);
 	}
 
-	file << "player " << player_pos.x << ' ' << player_pos.z << '\n';
+	map.has_player = true;
+	map.player_pos = glm::vec2{ player_pos.x, player_pos.z };
 
-	file.close();
+	return map;
 }
 
-void make_neighbors_for_sectors()
+//reports how the last save went once it's done, wait blocks until then
+void finish_save(bool wait)
 {
-	for (auto& sector : sectors)
+	if (!pending_save.valid())
 	{
-		for (size_t i = 0; i < sector.vertices.size(); i++)
-		{
-			const auto& vertex = sector.vertices[i];
-			for (size_t s = 0; s < sectors.size(); s++)
-			{
-				const auto& other_sector = sectors[s];
-				if (&other_sector == &sector)
-				{
-					continue;
-				}
+		return;
+	}
 
-				for (size_t ii = 0; ii < other_sector.vertices.size(); ii++)
-				{
-					const auto& other_vertex = other_sector.vertices[ii];
+	if (!wait && pending_save.wait_for(std::chrono::seconds(0)) != std::future_status::ready)
+	{
+		return;
+	}
 
-					const glm::vec2* vertex2 = nullptr;
-					if (i == sector.vertices.size() - 1)
-					{
-						vertex2 = &sector.vertices[0];
-					}
-					else
-					{
-						vertex2 = &sector.vertices[i + 1];
-					}
+	try
+	{
+		pending_save.get();
+	}
+	catch (const std::exception& e)
+	{
+		std::cerr << "Failed to save map: " << e.what() << '\n';
+	}
+}
 
-					const glm::vec2* other_vertex2 = nullptr;
-					if (ii == other_sector.vertices.size() - 1)
-					{
-						other_vertex2 = &other_sector.vertices[0];
-					}
-					else
-					{
-						other_vertex2 = &other_sector.vertices[ii + 1];
-					}
+void save_map(MapFormat format)
+{
+	if (pending_save.valid())
+	{
+		std::cerr << "Still saving the last map\n";
+		return;
+	}
 
-					if (*vertex2 == other_vertex)
-					{
-						if (*other_vertex2 == vertex)
-						{
-							sector.neighbors[i] = static_cast<int32_t>(s);
-						}
-					}
-				}
+	pending_save = std::async(std::launch::async, [map = make_map_data(), format]()
+		{
+			if (format == MapFormat::BINARY)
+			{
+				write_binary_map("map.secb", map);
 			}
-		}
-	}
+			else
+			{
+				write_text_map("map.sec", map);
+			}
+		});
 }
 
 int main(int argc, char** argv)
 {
 	glfwInit();
-	//could probably use 3.3 but 4.3 has convinient setting of uniform locations
+	//could probably use 3.3 but 4.3 has convinient setting of uniform locations, and 4.5 has persistently mapped buffers and dsa
 	glfwWindowHint(GLFW_CONTEXT_VERSION_MAJOR, 4);
-	glfwWindowHint(GLFW_CONTEXT_VERSION_MINOR, 3);
+	glfwWindowHint(GLFW_CONTEXT_VERSION_MINOR, 5);
 	glfwWindowHint(GLFW_OPENGL_PROFILE, GLFW_OPENGL_CORE_PROFILE);
 
 	window = glfwCreateWindow(width, height, "Map Editor", nullptr, nullptr);
@@ -478,35 +637,23 @@ int main(int argc, char** argv)
 
 	create_sector_height_bar();
 
+	sector_vert_markers = create_instanced(yellow_vert_cube);
+	sector_height_bars = create_instanced(sector_height_bar);
+	cube_vert_markers = create_instanced(vert_cube);
+
 	while (!glfwWindowShouldClose(window))
 	{
-		//some async funcs that we execute while we call our draw calls
-		auto future_cube_vert_mats = std::async([]()
-			{
-				std::vector<glm::mat4> mats;
-
-				for (const auto& cube_vert_pos : cube_vert_poses)
-				{
-					mats.push_back(glm::scale(glm::translate(glm::mat4(1.0f), cube_vert_pos), glm::vec3(0.3f)));
-				}
-
-				return mats;
-			});
-
-		auto future_sector_vert_mats = std::async([]()
-			{
-				std::vector<glm::mat4> mats;
+		finish_save(false);
 
-				for (const auto& sector : sectors)
-				{
-					for (const auto& vert : sector.vertices)
-					{
-						mats.push_back(glm::scale(glm::translate(glm::mat4(1.0f), glm::vec3{ vert.x, 0.0f, vert.y }), glm::vec3(0.1f)));
-					}
-				}
+		if (sector_instances_dirty)
+		{
+			update_sector_instances();
+		}
 
-				return mats;
-			});
+		if (cube_vert_instances_dirty)
+		{
+			update_cube_vert_instances();
+		}
 
 		glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT);
 
@@ -517,7 +664,9 @@ int main(int argc, char** argv)
 
 		const auto perspective = glm::perspective(glm::radians(90.0f), (float)width / (float)height, 0.1f, 700.0f);
 
-		glUniformMatrix4fv(0, 1, GL_FALSE, glm::value_ptr(perspective * view));
+		const auto proj_view = perspective * view;
+
+		glUniformMatrix4fv(0, 1, GL_FALSE, glm::value_ptr(proj_view));
 
 		//draw grid
 		if (draw_grid)
@@ -575,17 +724,6 @@ int main(int argc, char** argv)
 		//draw temporary vert cube
 		if (is_making_sector)
 		{
-			const auto cube_vert_mats = future_cube_vert_mats.get();
-
-			for (const auto& cube_vert_mat : cube_vert_mats)
-			{
-				glUniformMatrix4fv(1, 1, GL_FALSE, glm::value_ptr(cube_vert_mat));
-
-				glBindVertexArray(vert_cube.vao);
-
-				glDrawArrays(GL_TRIANGLES, 0, vert_cube.size);
-			}
-
 			glUniformMatrix4fv(1, 1, GL_FALSE, glm::value_ptr(glm::scale(glm::translate(glm::mat4(1.0f), org_cube_vert_pos), glm::vec3(0.4f))));
 
 			glBindVertexArray(main_vert_cube.vao);
@@ -613,43 +751,19 @@ int main(int argc, char** argv)
 			glDrawArrays(GL_LINES, 0, sector_mesh.size);
 		}
 
-		//draw verts on each sector vert
-		//generate on the fly matrix locations
+		//draw the temporary verts, verts on each sector vert and height bar for each sector
+		glUseProgram(instanced_shader_program);
 
-		glBindVertexArray(yellow_vert_cube.vao);
+		glUniformMatrix4fv(0, 1, GL_FALSE, glm::value_ptr(proj_view));
 
-		const auto sector_vert_mats = future_sector_vert_mats.get();
-
-		for (const auto& sector_vert_mat : sector_vert_mats)
+		if (is_making_sector)
 		{
-			glUniformMatrix4fv(1, 1, GL_FALSE, glm::value_ptr(sector_vert_mat));
-
-			glDrawArrays(GL_TRIANGLES, 0, yellow_vert_cube.size);
+			draw_instanced(cube_vert_markers, GL_TRIANGLES);
 		}
 
-		//draw height bar for each sector
-		glUniformMatrix4fv(1, 1, GL_FALSE, glm::value_ptr(glm::mat4(1.0f)));
-
-		glBindVertexArray(sector_height_bar.vao);
-		glBindBuffer(GL_ARRAY_BUFFER, sector_height_bar.vbo);
-		for (const auto& sector : sectors)
-		{
-			//get center
-			glm::vec2 avg_pos = get_avg_pos(sector);
-
-			constexpr glm::vec3 colour{ 0.3f, 0.0f, 1.0f };
+		draw_instanced(sector_vert_markers, GL_TRIANGLES);
 
-			const std::array<glm::vec3, 4> vertices
-			{
-				glm::vec3{avg_pos.x, sector.floor, avg_pos.y},
-				colour,
-				glm::vec3{avg_pos.x, sector.ceil, avg_pos.y},
-				colour
-			};
-			glBufferSubData(GL_ARRAY_BUFFER, 0, vertices.size() * sizeof(glm::vec3), vertices.data());
-
-			glDrawArrays(GL_LINES, 0, sector_height_bar.size);
-		}
+		draw_instanced(sector_height_bars, GL_LINES);
 
 		glfwSwapBuffers(window);
 
@@ -674,6 +788,8 @@ int main(int argc, char** argv)
 		}
 	}
 
+	finish_save(true);
+
 	glfwTerminate();
 
 	return 0;
@@ -691,6 +807,7 @@ void process_input()
 	* 
 	* Z locks and unlocks the camera
 	* Y writes the current sectors to a map file
+	* B writes the current sectors to a binary map file
 	* N removes the most recent sector from the list
 	* 
 	* If camera is locked:
@@ -732,6 +849,7 @@ void process_input()
 					if (avg_pos == glm::vec2{ cube_pos.x, cube_pos.z })
 					{
 						sector.floor -= 1.0f;
+						sector_instances_dirty = true;
 
 						break;
 					}
@@ -762,6 +880,7 @@ void process_input()
 					if (avg_pos == glm::vec2{ cube_pos.x, cube_pos.z })
 					{
 						sector.floor += 1.0f;
+						sector_instances_dirty = true;
 
 						break;
 					}
@@ -792,6 +911,7 @@ void process_input()
 					if (avg_pos == glm::vec2{ cube_pos.x, cube_pos.z })
 					{
 						sector.ceil -= 1.0f;
+						sector_instances_dirty = true;
 
 						break;
 					}
@@ -822,6 +942,7 @@ void process_input()
 					if (avg_pos == glm::vec2{ cube_pos.x, cube_pos.z })
 					{
 						sector.ceil += 1.0f;
+						sector_instances_dirty = true;
 
 						break;
 					}
@@ -946,10 +1067,36 @@ void process_input()
 
 	if (glfwGetKey(window, GLFW_KEY_Y) == GLFW_PRESS)
 	{
-		if (!camera_locked)
+		if (!is_y_pressed)
 		{
-			write_sectors_to_file();
+			if (!camera_locked)
+			{
+				save_map(MapFormat::TEXT);
+			}
 		}
+
+		is_y_pressed = true;
+	}
+	else
+	{
+		is_y_pressed = false;
+	}
+
+	if (glfwGetKey(window, GLFW_KEY_B) == GLFW_PRESS)
+	{
+		if (!is_b_pressed)
+		{
+			if (!camera_locked)
+			{
+				save_map(MapFormat::BINARY);
+			}
+		}
+
+		is_b_pressed = true;
+	}
+	else
+	{
+		is_b_pressed = false;
 	}
 
 	if (glfwGetKey(window, GLFW_KEY_P) == GLFW_PRESS)
@@ -979,6 +1126,7 @@ void process_input()
 					const glm::vec3 vert3d{ vert.x, 0.0f, vert.y };
 
 					cube_vert_poses.clear();
+					cube_vert_instances_dirty = true;
 
 					org_cube_vert_pos = vert3d;
 
@@ -997,6 +1145,8 @@ void process_input()
 					if (vert == sector.vertices[0])
 					{
 						sectors.push_back(sector);
+						sector_edges.add_sector(sectors, static_cast<uint32_t>(sectors.size() - 1));
+						sector_instances_dirty = true;
 
 						//turn into mesh to draw
 						{
@@ -1083,8 +1233,6 @@ void process_input()
 							sector_wireframe_meshes.push_back(std::move(sector_wireframe_mesh));
 						}
 
-						make_neighbors_for_sectors();
-
 						is_making_sector = false;
 					}
 					else
@@ -1092,6 +1240,7 @@ void process_input()
 						const glm::vec3 cube_vert_pos{ vert.x, 0.0f, vert.y };
 
 						cube_vert_poses.push_back(std::move(cube_vert_pos));
+						cube_vert_instances_dirty = true;
 
 						sector.vertices.push_back(vert);
 
@@ -1146,7 +1295,8 @@ void process_input()
 		{
 			if (!sectors.empty())
 			{
-				sectors.pop_back();
+				sector_edges.remove_back(sectors);
+				sector_instances_dirty = true;
 
 				destroy_renderable(sector_meshes.back());
 				sector_meshes.pop_back();
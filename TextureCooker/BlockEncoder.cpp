@@ -0,0 +1,382 @@
+#include "BlockEncoder.hpp"
+
+#include <array>
+#include <cmath>
+#include <cstring>
+#include <algorithm>
+
+//weights of the 16 interpolated colors of a 4 bit bc7 index, out of 64
+constexpr std::array<int32_t, 16> BC7_WEIGHTS{ 0, 4, 9, 13, 17, 21, 26, 30, 34, 38, 43, 47, 51, 55, 60, 64 };
+
+//writes bits into a zeroed block, lowest bit first
+struct BitWriter
+{
+	unsigned char* block;
+	uint32_t bit = 0;
+
+	void write(uint32_t value, uint32_t bit_count)
+	{
+		for (uint32_t i = 0; i < bit_count; i++, bit++)
+		{
+			if ((value >> i) & 1)
+			{
+				block[bit / 8] |= static_cast<unsigned char>(1 << (bit % 8));
+			}
+		}
+	}
+};
+
+//finds the two ends of the line through the block's colors, the first one is the brighter end
+static void find_endpoints(const unsigned char* pixels, std::array<float, 3>& high, std::array<float, 3>& low)
+{
+	std::array<float, 3> mean{};
+	for (size_t i = 0; i < 16; i++)
+	{
+		for (size_t c = 0; c < 3; c++)
+		{
+			mean[c] += pixels[i * 4 + c] / 16.0f;
+		}
+	}
+
+	std::array<float, 6> covariance{};
+	for (size_t i = 0; i < 16; i++)
+	{
+		const float r = pixels[i * 4 + 0] - mean[0];
+		const float g = pixels[i * 4 + 1] - mean[1];
+		const float b = pixels[i * 4 + 2] - mean[2];
+
+		covariance[0] += r * r;
+		covariance[1] += r * g;
+		covariance[2] += r * b;
+		covariance[3] += g * g;
+		covariance[4] += g * b;
+		covariance[5] += b * b;
+	}
+
+	//power iteration for the principal axis
+	std::array<float, 3> axis{ 1.0f, 1.0f, 1.0f };
+	for (size_t iteration = 0; iteration < 8; iteration++)
+	{
+		const std::array<float, 3> next
+		{
+			covariance[0] * axis[0] + covariance[1] * axis[1] + covariance[2] * axis[2],
+			covariance[1] * axis[0] + covariance[3] * axis[1] + covariance[4] * axis[2],
+			covariance[2] * axis[0] + covariance[4] * axis[1] + covariance[5] * axis[2]
+		};
+
+		const float length = std::sqrt(next[0] * next[0] + next[1] * next[1] + next[2] * next[2]);
+		if (length < 1e-6f)
+		{
+			break;
+		}
+
+		axis = { next[0] / length, next[1] / length, next[2] / length };
+	}
+
+	float min_t = 0.0f, max_t = 0.0f;
+	for (size_t i = 0; i < 16; i++)
+	{
+		float t = 0.0f;
+		for (size_t c = 0; c < 3; c++)
+		{
+			t += (pixels[i * 4 + c] - mean[c]) * axis[c];
+		}
+
+		min_t = std::min(min_t, t);
+		max_t = std::max(max_t, t);
+	}
+
+	for (size_t c = 0; c < 3; c++)
+	{
+		high[c] = std::clamp(mean[c] + axis[c] * max_t, 0.0f, 255.0f);
+		low[c] = std::clamp(mean[c] + axis[c] * min_t, 0.0f, 255.0f);
+	}
+
+	if (high[0] + high[1] + high[2] < low[0] + low[1] + low[2])
+	{
+		std::swap(high, low);
+	}
+}
+
+static int32_t color_distance(const int32_t* a, const unsigned char* b, size_t channels)
+{
+	int32_t distance = 0;
+	for (size_t c = 0; c < channels; c++)
+	{
+		const int32_t difference = a[c] - b[c];
+		distance += difference * difference;
+	}
+
+	return distance;
+}
+
+static uint16_t to_565(const std::array<float, 3>& color)
+{
+	const uint32_t r = static_cast<uint32_t>(std::lround(color[0] * 31.0f / 255.0f));
+	const uint32_t g = static_cast<uint32_t>(std::lround(color[1] * 63.0f / 255.0f));
+	const uint32_t b = static_cast<uint32_t>(std::lround(color[2] * 31.0f / 255.0f));
+
+	return static_cast<uint16_t>((r << 11) | (g << 5) | b);
+}
+
+static std::array<int32_t, 4> from_565(uint16_t color)
+{
+	const int32_t r = (color >> 11) & 31;
+	const int32_t g = (color >> 5) & 63;
+	const int32_t b = color & 31;
+
+	return { (r << 3) | (r >> 2), (g << 2) | (g >> 4), (b << 3) | (b >> 2), 255 };
+}
+
+void encode_bc1_block(const unsigned char* pixels, unsigned char* block)
+{
+	std::array<float, 3> high, low;
+	find_endpoints(pixels, high, low);
+
+	uint16_t color0 = to_565(high);
+	uint16_t color1 = to_565(low);
+
+	//color0 > color1 picks the four color mode, the other order would mean three colors and transparent black
+	if (color0 < color1)
+	{
+		std::swap(color0, color1);
+	}
+
+	uint32_t indices = 0;
+	if (color0 != color1)
+	{
+		const auto c0 = from_565(color0);
+		const auto c1 = from_565(color1);
+
+		std::array<std::array<int32_t, 4>, 4> palette{ c0, c1 };
+		for (size_t c = 0; c < 3; c++)
+		{
+			palette[2][c] = (2 * c0[c] + c1[c]) / 3;
+			palette[3][c] = (c0[c] + 2 * c1[c]) / 3;
+		}
+
+		for (uint32_t i = 0; i < 16; i++)
+		{
+			uint32_t best = 0;
+			int32_t best_distance = INT32_MAX;
+			for (uint32_t p = 0; p < 4; p++)
+			{
+				const int32_t distance = color_distance(palette[p].data(), pixels + i * 4, 3);
+				if (distance < best_distance)
+				{
+					best = p;
+					best_distance = distance;
+				}
+			}
+
+			indices |= best << (i * 2);
+		}
+	}
+
+	block[0] = static_cast<unsigned char>(color0);
+	block[1] = static_cast<unsigned char>(color0 >> 8);
+	block[2] = static_cast<unsigned char>(color1);
+	block[3] = static_cast<unsigned char>(color1 >> 8);
+
+	for (uint32_t i = 0; i < 4; i++)
+	{
+		block[4 + i] = static_cast<unsigned char>(indices >> (i * 8));
+	}
+}
+
+//splits an 8 bit endpoint into 7 bits per channel plus a shared lowest bit, whichever lowest bit fits best
+static void quantize_bc7_endpoint(const std::array<float, 4>& color, std::array<int32_t, 4>& quantized, int32_t& p_bit)
+{
+	float best_error = -1.0f;
+	for (int32_t p = 0; p < 2; p++)
+	{
+		std::array<int32_t, 4> candidate;
+		float error = 0.0f;
+		for (size_t c = 0; c < 4; c++)
+		{
+			candidate[c] = std::clamp(static_cast<int32_t>(std::lround((color[c] - p) / 2.0f)), 0, 127);
+
+			const float difference = static_cast<float>(candidate[c] * 2 + p) - color[c];
+			error += difference * difference;
+		}
+
+		if (best_error < 0.0f || error < best_error)
+		{
+			best_error = error;
+			quantized = candidate;
+			p_bit = p;
+		}
+	}
+}
+
+void encode_bc7_block(const unsigned char* pixels, unsigned char* block)
+{
+	std::array<float, 3> high, low;
+	find_endpoints(pixels, high, low);
+
+	float min_alpha = 255.0f, max_alpha = 0.0f;
+	for (size_t i = 0; i < 16; i++)
+	{
+		min_alpha = std::min<float>(min_alpha, pixels[i * 4 + 3]);
+		max_alpha = std::max<float>(max_alpha, pixels[i * 4 + 3]);
+	}
+
+	std::array<std::array<int32_t, 4>, 2> endpoints;
+	std::array<int32_t, 2> p_bits;
+	quantize_bc7_endpoint({ high[0], high[1], high[2], max_alpha }, endpoints[0], p_bits[0]);
+	quantize_bc7_endpoint({ low[0], low[1], low[2], min_alpha }, endpoints[1], p_bits[1]);
+
+	std::array<std::array<int32_t, 4>, 16> palette;
+	for (size_t w = 0; w < 16; w++)
+	{
+		for (size_t c = 0; c < 4; c++)
+		{
+			const int32_t e0 = endpoints[0][c] * 2 + p_bits[0];
+			const int32_t e1 = endpoints[1][c] * 2 + p_bits[1];
+
+			palette[w][c] = ((64 - BC7_WEIGHTS[w]) * e0 + BC7_WEIGHTS[w] * e1 + 32) >> 6;
+		}
+	}
+
+	std::array<uint32_t, 16> indices;
+	for (size_t i = 0; i < 16; i++)
+	{
+		int32_t best_distance = INT32_MAX;
+		for (uint32_t w = 0; w < 16; w++)
+		{
+			const int32_t distance = color_distance(palette[w].data(), pixels + i * 4, 4);
+			if (distance < best_distance)
+			{
+				indices[i] = w;
+				best_distance = distance;
+			}
+		}
+	}
+
+	//the first index is stored without its top bit, so it has to be below 8
+	if (indices[0] >= 8)
+	{
+		std::swap(endpoints[0], endpoints[1]);
+		std::swap(p_bits[0], p_bits[1]);
+
+		for (auto& index : indices)
+		{
+			index = 15 - index;
+		}
+	}
+
+	memset(block, 0, 16);
+
+	BitWriter writer{ block };
+
+	//mode 6 is six zero bits then a one
+	writer.write(1 << 6, 7);
+
+	for (size_t c = 0; c < 4; c++)
+	{
+		writer.write(static_cast<uint32_t>(endpoints[0][c]), 7);
+		writer.write(static_cast<uint32_t>(endpoints[1][c]), 7);
+	}
+
+	writer.write(static_cast<uint32_t>(p_bits[0]), 1);
+	writer.write(static_cast<uint32_t>(p_bits[1]), 1);
+
+	writer.write(indices[0], 3);
+	for (size_t i = 1; i < 16; i++)
+	{
+		writer.write(indices[i], 4);
+	}
+}
+
+void encode_image(TextureCacheFormat format, const unsigned char* pixels, uint32_t width, uint32_t height, unsigned char* blocks)
+{
+	const size_t block_size = texture_block_size(format);
+
+	std::array<unsigned char, 64> block_pixels;
+	for (uint32_t block_y = 0; block_y < height; block_y += 4)
+	{
+		for (uint32_t block_x = 0; block_x < width; block_x += 4)
+		{
+			for (uint32_t y = 0; y < 4; y++)
+			{
+				for (uint32_t x = 0; x < 4; x++)
+				{
+					const uint32_t source_x = std::min(block_x + x, width - 1);
+					const uint32_t source_y = std::min(block_y + y, height - 1);
+
+					memcpy(&block_pixels[(y * 4 + x) * 4], pixels + (static_cast<size_t>(source_y) * width + source_x) * 4, 4);
+				}
+			}
+
+			if (format == TextureCacheFormat::BC1)
+			{
+				encode_bc1_block(block_pixels.data(), blocks);
+			}
+			else
+			{
+				encode_bc7_block(block_pixels.data(), blocks);
+			}
+
+			blocks += block_size;
+		}
+	}
+}
+
+static float srgb_to_linear(float value)
+{
+	return value <= 0.04045f ? value / 12.92f : std::pow((value + 0.055f) / 1.055f, 2.4f);
+}
+
+static float linear_to_srgb(float value)
+{
+	return value <= 0.0031308f ? value * 12.92f : 1.055f * std::pow(value, 1.0f / 2.4f) - 0.055f;
+}
+
+std::vector<unsigned char> downsample_image(const std::vector<unsigned char>& pixels, uint32_t width, uint32_t height)
+{
+	static const auto linear_table = []()
+	{
+		std::array<float, 256> table;
+		for (size_t i = 0; i < table.size(); i++)
+		{
+			table[i] = srgb_to_linear(static_cast<float>(i) / 255.0f);
+		}
+
+		return table;
+	}();
+
+	const uint32_t half_width = std::max(1u, width / 2);
+	const uint32_t half_height = std::max(1u, height / 2);
+
+	std::vector<unsigned char> half(static_cast<size_t>(half_width) * half_height * 4);
+	for (uint32_t y = 0; y < half_height; y++)
+	{
+		for (uint32_t x = 0; x < half_width; x++)
+		{
+			std::array<float, 4> sum{};
+			for (uint32_t sample = 0; sample < 4; sample++)
+			{
+				const uint32_t source_x = std::min(x * 2 + (sample & 1), width - 1);
+				const uint32_t source_y = std::min(y * 2 + (sample >> 1), height - 1);
+				const unsigned char* source = &pixels[(static_cast<size_t>(source_y) * width + source_x) * 4];
+
+				for (size_t c = 0; c < 3; c++)
+				{
+					sum[c] += linear_table[source[c]];
+				}
+
+				sum[3] += source[3] / 255.0f;
+			}
+
+			unsigned char* destination = &half[(static_cast<size_t>(y) * half_width + x) * 4];
+			for (size_t c = 0; c < 3; c++)
+			{
+				destination[c] = static_cast<unsigned char>(std::lround(linear_to_srgb(sum[c] / 4.0f) * 255.0f));
+			}
+
+			destination[3] = static_cast<unsigned char>(std::lround(sum[3] / 4.0f * 255.0f));
+		}
+	}
+
+	return half;
+}
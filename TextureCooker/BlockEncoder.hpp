@@ -0,0 +1,22 @@
+#ifndef BLOCK_ENCODER_TEXTURE_COOKER_HPP
+#define BLOCK_ENCODER_TEXTURE_COOKER_HPP
+
+#include <cstdint>
+#include <vector>
+
+#include "TextureCache.hpp"
+
+//block encoders take the 16 rgba pixels of a 4x4 block in row order
+
+void encode_bc1_block(const unsigned char* pixels, unsigned char* block);
+
+//only uses mode 6 (one subset, 4 bit indices), which is good enough for opaque textures
+void encode_bc7_block(const unsigned char* pixels, unsigned char* block);
+
+//encodes a whole rgba image, blocks hanging over the edge repeat the last row and column
+void encode_image(TextureCacheFormat format, const unsigned char* pixels, uint32_t width, uint32_t height, unsigned char* blocks);
+
+//halves an srgb rgba image, averaging in linear space
+std::vector<unsigned char> downsample_image(const std::vector<unsigned char>& pixels, uint32_t width, uint32_t height);
+
+#endif
@@ -0,0 +1,121 @@
+#include <exception>
+#include <iostream>
+#include <string>
+#include <stdexcept>
+#include <filesystem>
+
+#include "stb_image.h"
+
+#include "MapFile.hpp"
+#include "TextureCache.hpp"
+#include "BlockEncoder.hpp"
+
+//encodes every texture a map uses into a block compressed cache with full mip chains,
+//the Engine loads map.texc next to map.sec/map.secb instead of decoding the images
+//usage: TextureCooker [map file] [output] [bc1|bc7]
+int main(int argc, char** argv)
+{
+	const std::string map_filename = argc > 1 ? argv[1] : "map.sec";
+	const std::string output_filename = argc > 2 ? argv[2] : std::filesystem::path{ map_filename }.replace_extension(".texc").string();
+	const std::string format_name = argc > 3 ? argv[3] : "bc1";
+
+	try
+	{
+		TextureCache cache;
+
+		if (format_name == "bc1")
+		{
+			cache.format = TextureCacheFormat::BC1;
+		}
+		else if (format_name == "bc7")
+		{
+			cache.format = TextureCacheFormat::BC7;
+		}
+		else
+		{
+			throw std::runtime_error("Unknown block format " + format_name + ", use bc1 or bc7");
+		}
+
+		if (std::filesystem::path{ map_filename }.extension() == ".secb")
+		{
+			const MappedMap mapped_map{ map_filename.c_str() };
+
+			for (uint32_t i = 0; i < mapped_map.view().texture_count; i++)
+			{
+				cache.names.emplace_back(mapped_map.view().texture(i));
+			}
+		}
+		else
+		{
+			const MapData map_data = read_text_map(map_filename.c_str());
+
+			for (uint32_t i = 0; i < map_data.view().texture_count; i++)
+			{
+				cache.names.emplace_back(map_data.view().texture(i));
+			}
+		}
+
+		if (cache.names.empty())
+		{
+			throw std::runtime_error("Map doesn't use any textures");
+		}
+
+		cache.layer_count = static_cast<uint32_t>(cache.names.size());
+
+		for (uint32_t layer = 0; layer < cache.layer_count; layer++)
+		{
+			const std::string& name = cache.names[layer];
+
+			int width, height, nr_channels;
+			unsigned char* texture = stbi_load(name.c_str(), &width, &height, &nr_channels, 4);
+			if (nullptr == texture)
+			{
+				throw std::runtime_error("Failed to load texture from file " + name);
+			}
+
+			std::vector<unsigned char> pixels{ texture, texture + static_cast<size_t>(width) * height * 4 };
+			stbi_image_free(texture);
+
+			//every layer of the array has the size of the first one
+			if (layer == 0)
+			{
+				cache.width = static_cast<uint32_t>(width);
+				cache.height = static_cast<uint32_t>(height);
+				cache.level_count = full_level_count(cache.width, cache.height);
+
+				cache.allocate();
+			}
+			else if (width != static_cast<int>(cache.width) || height != static_cast<int>(cache.height))
+			{
+				throw std::runtime_error("texture " + name + " is not of size (" + std::to_string(cache.width) + " x " + std::to_string(cache.height) + ")");
+			}
+
+			for (uint32_t level = 0; level < cache.level_count; level++)
+			{
+				const uint32_t level_width = texture_level_extent(cache.width, level);
+				const uint32_t level_height = texture_level_extent(cache.height, level);
+
+				if (level > 0)
+				{
+					pixels = downsample_image(pixels, texture_level_extent(cache.width, level - 1), texture_level_extent(cache.height, level - 1));
+				}
+
+				encode_image(cache.format, pixels.data(), level_width, level_height, cache.layer_data(level, layer));
+			}
+
+			std::cout << "Encoded " << name << '\n';
+		}
+
+		write_texture_cache(output_filename.c_str(), cache);
+
+		std::cout << "Wrote " << cache.layer_count << " layers with " << cache.level_count << " levels (" << cache.data.size() << " bytes) to " << output_filename << '\n';
+	}
+	catch (const std::exception& exp)
+	{
+		std::cerr << "Exception: " << exp.what() << '\n';
+
+		return 1;
+	}
+
+	return 0;
+}